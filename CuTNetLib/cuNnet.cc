@@ -79,7 +79,7 @@ namespace TNet {
   CuNetwork::
   ReadNetwork(const char* pSrc)
   {
-    std::ifstream in(pSrc);
+    std::ifstream in(pSrc, std::ios::in | std::ios::binary);
     if(!in.good()) {
       KALDI_ERR << "Cannot read model: " << pSrc;
     }
@@ -91,12 +91,15 @@ namespace TNet {
  
   void
   CuNetwork::
-  WriteNetwork(const char* pDst)
+  WriteNetwork(const char* pDst, bool binary)
   {
-    std::ofstream out(pDst);
+    std::ofstream out(pDst, std::ios::out | std::ios::binary);
     if(!out.good()) {
       KALDI_ERR << "Cannot write model: " << pDst;
     }
+    if(binary) {
+      WriteBinaryModelHeader(out);
+    }
     WriteNetwork(out);
     out.close();
   }
@@ -107,6 +110,8 @@ namespace TNet {
   CuNetwork::
   ReadNetwork(std::istream& rIn)
   {
+    //skip the header of binary models
+    ReadBinaryModelHeader(rIn);
     //get the network elements from a factory
     CuComponent *pComp;
     while(NULL != (pComp = ComponentFactory(rIn))) { 
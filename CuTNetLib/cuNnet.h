@@ -55,7 +55,7 @@ namespace TNet {
       void Backpropagate(const CuMatrix<BaseFloat>& globerr); 
 
       void ReadNetwork(const char* pSrc);     ///< read the network from file
-      void WriteNetwork(const char* pDst);    ///< write network to file
+      void WriteNetwork(const char* pDst, bool binary = false); ///< write network to file
 
       void ReadNetwork(std::istream& rIn);    ///< read the network from stream
       void WriteNetwork(std::ostream& rOut);  ///< write network to stream
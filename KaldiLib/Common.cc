@@ -3,6 +3,7 @@
 #include <cmath>
 #include <cfloat>
 #include <cstdio>
+#include <algorithm>
 
 #include "Common.h"
 #include "Error.h"
@@ -20,6 +21,8 @@ namespace TNet {
   
   // Allocating stream variable used by stream modifier MatrixVectorIostreamControl
   const int MATRIX_IOS_FORMAT_IWORD = std::ios_base::xalloc();
+  // Allocating stream variable holding the data of MemoryIstream
+  const int MATRIX_IOS_MAP_PWORD = std::ios_base::xalloc();
 
   //***************************************************************************
   //***************************************************************************
@@ -191,7 +194,7 @@ namespace TNet {
   bool 
   CloseEnough(const double f1, const double f2, const double nRounds)
   {
-    bool ret_val = (_ABS((f1 - f2) / (f2 == 0.0 ? 1.0 : f2))
+    bool ret_val = (fabs((f1 - f2) / (f2 == 0.0 ? 1.0 : f2))
         < (nRounds * DBL_EPSILON));
 
     return ret_val;
@@ -207,7 +210,7 @@ namespace TNet {
     char *out, *outend;
     const char *chrptr = command;
     int ndollars = 0;
-    int fnlen = strlen(filename);
+    int fnlen = static_cast<int>(strlen(filename));
 
     while (*chrptr++) ndollars += (*chrptr ==  *pFilter);
 
@@ -260,6 +263,172 @@ namespace TNet {
   }
 
 
+  //***************************************************************************
+  //***************************************************************************
+  void
+  WriteBinaryData(std::ostream& rOut, const void* pData, size_t elemSize, size_t n)
+  {
+    if(!IsBigEndian()) {
+      rOut.write(static_cast<const char*>(pData), elemSize*n);
+    } else {
+      const char* p_src = static_cast<const char*>(pData);
+      char buf[8];
+      for(size_t i=0; i<n; i++, p_src+=elemSize) {
+        for(size_t b=0; b<elemSize; b++) buf[b] = p_src[elemSize-1-b];
+        rOut.write(buf, elemSize);
+      }
+    }
+    if(rOut.fail()) {
+      throw std::runtime_error("Failed to write binary data to stream");
+    }
+  }
+
+
+  //***************************************************************************
+  //***************************************************************************
+  void
+  ReadBinaryData(std::istream& rIn, void* pData, size_t elemSize, size_t n)
+  {
+    rIn.read(static_cast<char*>(pData), elemSize*n);
+    if(rIn.fail()) {
+      throw std::runtime_error("Failed to read binary data from stream");
+    }
+    if(IsBigEndian()) {
+      char* p = static_cast<char*>(pData);
+      for(size_t i=0; i<n; i++, p+=elemSize) {
+        for(size_t b=0; b<elemSize/2; b++) std::swap(p[b], p[elemSize-1-b]);
+      }
+    }
+  }
+
+
+  //***************************************************************************
+  //***************************************************************************
+  void
+  WriteBinaryHeader(std::ostream& rOut, char tag, char type, size_t rows, size_t cols)
+  {
+    if(type == '\0') {
+      throw std::runtime_error("Binary output not supported for this element type");
+    }
+    // align the data for mapping
+    std::streamoff pos = rOut.tellp();
+    if(pos >= 0) {
+      size_t header = (tag == 'V' ? 6 : 10);
+      size_t pad = (64 - (pos + header) % 64) % 64;
+      for(size_t i=0; i<pad; i++) rOut.put(' ');
+    }
+    rOut.put(tag);
+    rOut.put(type);
+    int dims[2] = { (int)rows, (int)cols };
+    WriteBinaryData(rOut, dims, sizeof(int), (tag == 'V' ? 1 : 2));
+  }
+
+
+  //***************************************************************************
+  //***************************************************************************
+  void
+  ReadBinaryHeader(std::istream& rIn, char& rType, size_t& rRows, size_t* pCols)
+  {
+    rType = static_cast<char>(rIn.get());
+    int dims[2] = { -1, -1 };
+    ReadBinaryData(rIn, dims, sizeof(int), (NULL == pCols ? 1 : 2));
+    if(dims[0] < 0 || (NULL != pCols && dims[1] < 0)) {
+      throw std::runtime_error("Failed to read binary record from stream: bad size");
+    }
+    rRows = dims[0];
+    if(NULL != pCols) *pCols = dims[1];
+  }
+
+
+  //***************************************************************************
+  //***************************************************************************
+  MemoryIstream::MemoryBuf::
+  MemoryBuf(const char* pData, size_t size)
+  {
+    char* p_data = const_cast<char*>(pData); // the get area is never written
+    setg(p_data, p_data, p_data + size);
+  }
+
+
+  std::streambuf::pos_type
+  MemoryIstream::MemoryBuf::
+  seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+  {
+    char* p_pos;
+    switch(dir) {
+      case std::ios_base::beg: p_pos = eback() + off; break;
+      case std::ios_base::cur: p_pos = gptr() + off; break;
+      default:                 p_pos = egptr() + off; break;
+    }
+    if(!(which & std::ios_base::in) || p_pos < eback() || p_pos > egptr()) {
+      return pos_type(off_type(-1));
+    }
+    setg(eback(), p_pos, egptr());
+    return pos_type(p_pos - eback());
+  }
+
+
+  std::streambuf::pos_type
+  MemoryIstream::MemoryBuf::
+  seekpos(pos_type pos, std::ios_base::openmode which)
+  {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+
+
+  MemoryIstream::
+  MemoryIstream(const char* pData, size_t size)
+   : std::istream(&mBuf), mBuf(pData, size)
+  {
+    pword(MATRIX_IOS_MAP_PWORD) = const_cast<char*>(pData);
+  }
+
+
+  //***************************************************************************
+  //***************************************************************************
+  const char*
+  MappedPosition(std::istream& rIn, size_t& rAvail)
+  {
+    const char* p_data = static_cast<const char*>(rIn.pword(MATRIX_IOS_MAP_PWORD));
+    if(NULL == p_data) return NULL;
+    std::streamoff pos = rIn.tellg();
+    if(pos < 0) return NULL;
+    rAvail = rIn.rdbuf()->in_avail();
+    return p_data + pos;
+  }
+
+
+  //***************************************************************************
+  //***************************************************************************
+  void
+  WriteBinaryModelHeader(std::ostream& rOut)
+  {
+    rOut.put('\0');
+    rOut.put('B');
+    rOut.put((char)BINARY_MODEL_VERSION);
+    rOut << MatrixVectorIostreamControl(BINARY_OUTPUT, true);
+  }
+
+
+  //***************************************************************************
+  //***************************************************************************
+  bool
+  ReadBinaryModelHeader(std::istream& rIn)
+  {
+    if(rIn.peek() != '\0') return false;
+    rIn.get();
+    if(rIn.get() != 'B') {
+      throw std::runtime_error("Bad binary model header");
+    }
+    int version = rIn.get();
+    if(version < 1 || version > BINARY_MODEL_VERSION) {
+      throw std::runtime_error("Unsupported binary model version "+to_string(version)
+                               +", this build reads up to "+to_string(BINARY_MODEL_VERSION));
+    }
+    return true;
+  }
+
+
 } // namespace TNet
 
 //#ifdef CYGWIN
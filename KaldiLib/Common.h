@@ -6,6 +6,7 @@
 #include <string>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 
 /* Alignment of critical dynamic data structure
  *
@@ -158,7 +159,7 @@ namespace TNet
 
   enum MatrixVectorIostreamControlBits {
     ACCUMULATE_INPUT = 1,
-//  BINARY_OUTPUT    = 2
+    BINARY_OUTPUT    = 2
   };
   
   class MatrixVectorIostreamControl
@@ -168,7 +169,7 @@ namespace TNet
       : mBitsToBeSet(bitsToBeSet), mValueToBeSet(valueToBeSet) {}
       
       static long Flags(std::ios_base &rIos, enum MatrixVectorIostreamControlBits bits)
-      { return rIos.iword(MATRIX_IOS_FORMAT_IWORD); }
+      { return rIos.iword(MATRIX_IOS_FORMAT_IWORD) & bits; }
       
       long mBitsToBeSet;
       bool mValueToBeSet;
@@ -193,6 +194,105 @@ namespace TNet
         return rIs;
       }
   };
+
+
+  /**
+   * Binary matrix/vector records, written when BINARY_OUTPUT is set
+   * and detected by the readers by the leading character:
+   *
+   *   'M' <type> <rows> <cols> <data>   matrix, row-major
+   *   'T' <type> <rows> <cols> <data>   matrix, column-major (transposed)
+   *   'V' <type> <dim> <data>           vector
+   *
+   * <type> is 'F' (float), 'D' (double) or 'I' (int), the dims are 32-bit,
+   * all the numbers are little-endian, the rows are not padded.
+   * Floats and doubles are converted on input.
+   */
+  template<typename _ElemT> inline char BinaryTypeCode() { return '\0'; }
+  template<> inline char BinaryTypeCode<float>()  { return 'F'; }
+  template<> inline char BinaryTypeCode<double>() { return 'D'; }
+  template<> inline char BinaryTypeCode<int>()    { return 'I'; }
+
+  /// Write n elements of size elemSize, little-endian
+  void WriteBinaryData(std::ostream& rOut, const void* pData, size_t elemSize, size_t n);
+  /// Read n elements of size elemSize, little-endian
+  void ReadBinaryData(std::istream& rIn, void* pData, size_t elemSize, size_t n);
+
+  /// Write the record tag, element type and the dims (cols==0 for vectors),
+  /// the record is preceded by spaces so that its data start 
+  /// at a multiple of 64 bytes of a seekable stream (mappable models)
+  void WriteBinaryHeader(std::ostream& rOut, char tag, char type, size_t rows, size_t cols);
+  /// Read the element type and the dims (the tag was already consumed)
+  void ReadBinaryHeader(std::istream& rIn, char& rType, size_t& rRows, size_t* pCols);
+
+  /// Read n elements stored as type, convert to _ElemT, add to pData if accumulate
+  template<typename _SrcT, typename _ElemT>
+  void ReadBinaryConvert(std::istream& rIn, _ElemT* pData, size_t n, bool accumulate)
+  {
+    std::vector<_SrcT> buf(n);
+    if(n > 0) ReadBinaryData(rIn, &buf[0], sizeof(_SrcT), n);
+    for(size_t i=0; i<n; i++) {
+      if(accumulate) pData[i] += static_cast<_ElemT>(buf[i]);
+      else pData[i] = static_cast<_ElemT>(buf[i]);
+    }
+  }
+
+  /// Read n elements of a binary record with element type 'type'
+  template<typename _ElemT>
+  void ReadBinaryElems(std::istream& rIn, char type, _ElemT* pData, size_t n, bool accumulate)
+  {
+    if(type == BinaryTypeCode<_ElemT>() && !accumulate) {
+      ReadBinaryData(rIn, pData, sizeof(_ElemT), n);
+      return;
+    }
+    switch(type) {
+      case 'F': ReadBinaryConvert<float>(rIn, pData, n, accumulate); break;
+      case 'D': ReadBinaryConvert<double>(rIn, pData, n, accumulate); break;
+      case 'I': ReadBinaryConvert<int>(rIn, pData, n, accumulate); break;
+      default: 
+        throw std::runtime_error(std::string("Unknown element type in binary record: ")+type);
+    }
+  }
+
+
+  extern const int MATRIX_IOS_MAP_PWORD;
+
+  /**
+   * Input stream reading a memory block (e.g. a mapped model file)
+   * without copying it, the binary records can be used in place
+   * (see MappedPosition, MapTransposed, MapVector)
+   */
+  class MemoryIstream : public std::istream
+  {
+    public:
+      MemoryIstream(const char* pData, size_t size);
+
+    private:
+      class MemoryBuf : public std::streambuf
+      {
+        public:
+          MemoryBuf(const char* pData, size_t size);
+        protected:
+          pos_type seekoff(off_type off, std::ios_base::seekdir dir, 
+                           std::ios_base::openmode which);
+          pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+      };
+      MemoryBuf mBuf;
+  };
+
+  /// Address of the current position of a MemoryIstream and the number
+  /// of bytes left, NULL for the other streams
+  const char* MappedPosition(std::istream& rIn, size_t& rAvail);
+
+
+  /// Version of the binary model files,
+  /// incremented on incompatible changes of the format
+  const int BINARY_MODEL_VERSION = 1;
+
+  /// Write the binary model header ("\0B" + version) and set BINARY_OUTPUT
+  void WriteBinaryModelHeader(std::ostream& rOut);
+  /// Consume the binary model header if present, returns true for binary models
+  bool ReadBinaryModelHeader(std::istream& rIn);
   
   
   
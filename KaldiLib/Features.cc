@@ -6,6 +6,11 @@
 #include <map>
 #include <list>
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "Features.h"
 #include "Tokenizer.h"
@@ -16,6 +21,79 @@
 
 namespace TNet
 {
+  /// Upper bound on the size of one block read by ReadHTKFeatures
+  static const size_t HTK_READ_BLOCK_SIZE = 4*1024*1024;
+
+
+  /// Converts IEEE half precision number to float
+  static inline float 
+  HalfToFloat(UINT_16 h)
+  {
+    UINT_32 sign = (UINT_32)(h & 0x8000) << 16;
+    UINT_32 exp  = (h >> 10) & 0x1f;
+    UINT_32 mant = h & 0x3ff;
+    UINT_32 bits;
+
+    if (exp == 0x1f) {
+      // inf, nan
+      bits = sign | 0x7f800000 | (mant << 13);
+    } else if (exp != 0) {
+      bits = sign | ((exp + 112) << 23) | (mant << 13);
+    } else if (mant == 0) {
+      bits = sign;
+    } else {
+      // subnormal half, normalize it
+      exp = 113;
+      while (!(mant & 0x400)) { mant <<= 1; exp--; }
+      bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+
+    float f;
+    memcpy(&f, &bits, sizeof(float));
+    return f;
+  }
+
+
+  /// Converts float to IEEE half precision number (round to nearest even)
+  static inline UINT_16 
+  FloatToHalf(float f)
+  {
+    UINT_32 bits;
+    memcpy(&bits, &f, sizeof(float));
+
+    UINT_32 sign = (bits >> 16) & 0x8000;
+    int     exp  = (int)((bits >> 23) & 0xff) - 112;
+    UINT_32 mant = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) {
+      // inf, nan
+      return static_cast<UINT_16>(sign | 0x7c00 | (mant ? 0x200 : 0));
+    }
+    if (exp >= 0x1f) {
+      // overflow
+      return static_cast<UINT_16>(sign | 0x7c00);
+    }
+    if (exp <= 0) {
+      // subnormal half or zero
+      if (exp < -10) return static_cast<UINT_16>(sign);
+      mant |= 0x800000;
+      UINT_32 shift = 14 - exp;
+      UINT_32 h     = mant >> shift;
+      UINT_32 rest  = mant & ((1u << shift) - 1);
+      UINT_32 half  = 1u << (shift - 1);
+      if (rest > half || (rest == half && (h & 1))) h++;
+      return static_cast<UINT_16>(sign | h);
+    }
+
+    UINT_32 h = sign | (exp << 10) | (mant >> 13);
+    UINT_32 rest = mant & 0x1fff;
+    // carry may propagate to the exponent, which gives correct rounding
+    if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) h++;
+    return static_cast<UINT_16>(h);
+  }
+
+  const char FeatureRepository::ARCHIVE_MAGIC[4] = { 'T', 'N', 'F', 'A' };
+
   const char 
   FeatureRepository::
   mpParmKindNames[13][16] =
@@ -200,6 +278,7 @@ namespace TNet
     rOut.mpCmnMask        = mpCmnMask;
     rOut.mpCvnPath        = mpCvnPath;
     rOut.mpCvnMask        = mpCvnMask;
+    rOut.mMapFeatures     = mMapFeatures;
 
     rOut.mInputQueue.clear();
 
@@ -231,6 +310,11 @@ namespace TNet
     rOut.mpCvg          = NULL;
     rOut.mpA            = NULL;
     rOut.mpB            = NULL;
+    rOut.mpReadBuf      = NULL;
+    rOut.mReadBufSize   = 0;
+    rOut.mpMapData      = NULL;
+    rOut.mMapSize       = 0;
+    rOut.mpView         = NULL;
 
   }
 
@@ -333,6 +417,23 @@ namespace TNet
   } // AddFile(const std::string & rFileName)
 
   
+  //***************************************************************************
+  //***************************************************************************
+  void
+  FeatureRepository::
+  SelectRecords(const std::vector<size_t>& rPositions)
+  {
+    std::vector<FileListElem> records(mInputQueue.begin(), mInputQueue.end());
+
+    mInputQueue.clear();
+    for (size_t i = 0; i < rPositions.size(); i++) {
+      assert(rPositions[i] < records.size());
+      mInputQueue.push_back(records[rPositions[i]]);
+    }
+    mInputQueueIterator = mInputQueue.end();
+  } // SelectRecords(const std::vector<size_t>& rPositions)
+
+
   //***************************************************************************
   //***************************************************************************
   void
@@ -391,9 +492,38 @@ namespace TNet
   FeatureRepository::
   ReadFullMatrix(Matrix<BaseFloat>& rMatrix)
   {
-    // clear the matrix
+    return ReadCurrentFile(rMatrix, false);
+  } // ReadFullMatrix(Matrix<BaseFloat>& rMatrix)
+
+
+  //***************************************************************************
+  //***************************************************************************
+  const Matrix<BaseFloat>&
+  FeatureRepository::
+  ReadFullMatrixView(Matrix<BaseFloat>& rMatrix)
+  {
+    ReadCurrentFile(rMatrix, mMapFeatures);
+
+    if (NULL != mpView)
+      return *mpView;
+    else
+      return rMatrix;
+  } // ReadFullMatrixView(Matrix<BaseFloat>& rMatrix)
+
+
+  //***************************************************************************
+  //***************************************************************************
+  // private:
+  bool
+  FeatureRepository::
+  ReadCurrentFile(Matrix<BaseFloat>& rMatrix, bool allowView)
+  {
+    // clear the matrix and the view over the previous file
     rMatrix.Destroy();
 
+    delete mpView;
+    mpView = NULL;
+
     // extract index file name
     if (!mCurrentIndexFileDir.empty())
     {
@@ -416,8 +546,8 @@ namespace TNet
     }
      
     // read the matrix and return the result
-    return ReadHTKFeatures(*mInputQueueIterator, rMatrix);
-  } // ReadFullMatrix(Matrix<BaseFloat>& rMatrix)
+    return ReadHTKFeatures(*mInputQueueIterator, rMatrix, allowView);
+  } // ReadCurrentFile(Matrix<BaseFloat>& rMatrix, bool allowView)
 
 
 
@@ -541,13 +671,285 @@ namespace TNet
   }  // int ReadHTKFeature
   
 
+  //***************************************************************************
+  //***************************************************************************
+  // private:
+  int 
+  FeatureRepository::
+  ReadHTKBlock(size_t nBytes)
+  {
+    if (nBytes > mReadBufSize) 
+    {
+      mpReadBuf = (char*) realloc(mpReadBuf, nBytes);
+      if (mpReadBuf == NULL) {
+        throw std::runtime_error("Insufficient memory");
+      }
+      mReadBufSize = nBytes;
+    }
+
+    if (fread(mpReadBuf, 1, nBytes, mStream.fp()) != nBytes)
+      return -1;
+
+    return 0;
+  }  // int ReadHTKBlock
+
+
+  //***************************************************************************
+  //***************************************************************************
+  // private:
+  void
+  FeatureRepository::
+  UnpackHTKFeature(
+      const char*&  rpSrc,
+      BaseFloat*    pOut, 
+      size_t    feaLen, 
+      bool      decompress, 
+      BaseFloat*    pScale, 
+      BaseFloat*    pBias)
+  {
+    size_t i;
+
+    if (decompress) 
+    {
+      INT_16 s;
+
+      for (i = 0; i < feaLen; i++) 
+      {
+        memcpy(&s, rpSrc, sizeof(INT_16));
+        rpSrc += sizeof(INT_16);
+
+        if (mSwapData) swap2(s);
+        pOut[i] = ((BaseFloat)s + pBias[i]) / pScale[i];
+      }
+      return;
+    }
+
+    if (mHalfData) 
+    {
+      UINT_16 h;
+
+      for (i = 0; i < feaLen; i++) 
+      {
+        memcpy(&h, rpSrc, sizeof(UINT_16));
+        rpSrc += sizeof(UINT_16);
+
+        if (mSwapData) swap2(h);
+        pOut[i] = HalfToFloat(h);
+      }
+      return;
+    }
+
+#if !DOUBLEPRECISION
+    memcpy(pOut, rpSrc, feaLen * sizeof(FLOAT_32));
+    rpSrc += feaLen * sizeof(FLOAT_32);
+
+    if (mSwapData) 
+      for (i = 0; i < feaLen; i++) 
+        swap4(pOut[i]);
+#else
+    float f;
+
+    for (i = 0; i < feaLen; i++) 
+    {
+      memcpy(&f, rpSrc, sizeof(FLOAT_32));
+      rpSrc += sizeof(FLOAT_32);
+
+      if (mSwapData) 
+        swap4(f);
+
+      pOut[i] = f;
+    }
+#endif
+  }  // void UnpackHTKFeature
+
+
+  //***************************************************************************
+  //***************************************************************************
+  // private:
+  int 
+  FeatureRepository::
+  ReadArchiveIndex()
+  {
+    FILE*         fp = mStream.fp();
+    ArchiveHeader header;
+    size_t        i;
+
+    mArchiveIndex.clear();
+    mArchiveKeys.clear();
+
+    if (!fread(header.mMagic,        sizeof(char),   4, fp)) return -1;
+    if (!fread(&header.mByteOrder,   sizeof(INT_32), 1, fp)) return -1;
+    if (!fread(&header.mVersion,     sizeof(INT_32), 1, fp)) return -1;
+    if (!fread(&header.mFlags,       sizeof(INT_32), 1, fp)) return -1;
+    if (!fread(&header.mIndexOffset, sizeof(INT_64), 1, fp)) return -1;
+    if (!fread(&header.mNEntries,    sizeof(INT_32), 1, fp)) return -1;
+    if (!fread(&header.mReserved,    sizeof(INT_32), 1, fp)) return -1;
+
+    if (memcmp(header.mMagic, ARCHIVE_MAGIC, 4)) 
+      return -1;
+
+    // the archive is stored in the byte order of the writer
+    mArchiveSwap = (header.mByteOrder != ARCHIVE_BYTE_ORDER);
+
+    if (mArchiveSwap) 
+    {
+      swap4(header.mByteOrder);
+      swap4(header.mVersion);
+      swap4(header.mFlags);
+      swap8(header.mIndexOffset);
+      swap4(header.mNEntries);
+    }
+
+    if (header.mByteOrder != ARCHIVE_BYTE_ORDER 
+    ||  header.mVersion   != ARCHIVE_VERSION
+    ||  header.mNEntries  <  0)
+      return -1;
+
+    mArchiveHalf = (header.mFlags & ARCHIVE_HALF) != 0;
+
+    if (fseeko(fp, header.mIndexOffset, SEEK_SET)) 
+      return -1;
+
+    mArchiveIndex.resize(header.mNEntries);
+
+    for (i = 0; i < mArchiveIndex.size(); i++) 
+    {
+      ArchiveEntry& r_entry = mArchiveIndex[i];
+      INT_32        key_len;
+
+      if (!fread(&r_entry.mOffset,       sizeof(INT_64), 1, fp)) return -1;
+      if (!fread(&r_entry.mNSamples,     sizeof(INT_32), 1, fp)) return -1;
+      if (!fread(&r_entry.mSamplePeriod, sizeof(INT_32), 1, fp)) return -1;
+      if (!fread(&r_entry.mSampleSize,   sizeof(INT_16), 1, fp)) return -1;
+      if (!fread(&r_entry.mSampleKind,   sizeof(INT_16), 1, fp)) return -1;
+      if (!fread(&key_len,               sizeof(INT_32), 1, fp)) return -1;
+
+      if (mArchiveSwap) 
+      {
+        swap8(r_entry.mOffset);
+        swap4(r_entry.mNSamples);
+        swap4(r_entry.mSamplePeriod);
+        swap2(r_entry.mSampleSize);
+        swap2(r_entry.mSampleKind);
+        swap4(key_len);
+      }
+
+      if (key_len < 0) 
+        return -1;
+
+      r_entry.mKey.resize(key_len);
+      if (key_len > 0 && fread(&r_entry.mKey[0], sizeof(char), key_len, fp) 
+          != (size_t) key_len) 
+        return -1;
+
+      mArchiveKeys[r_entry.mKey] = i;
+    }
+
+    return 0;
+  }  // int ReadArchiveIndex
+
+
+  //***************************************************************************
+  //***************************************************************************
+  // private:
+  const FeatureRepository::ArchiveEntry&
+  FeatureRepository::
+  FindArchiveEntry(const std::string& rKey, const std::string& rFileName)
+  {
+    // entry name ( archive#:name )
+    if (!rKey.empty() && rKey[0] == ':') 
+    {
+      std::map<std::string, size_t>::const_iterator it = mArchiveKeys.find(rKey.substr(1));
+      if (it != mArchiveKeys.end()) 
+        return mArchiveIndex[it->second];
+    }
+    // entry number ( archive#N )
+    else if (!rKey.empty() && rKey.find_first_not_of("0123456789") == std::string::npos) 
+    {
+      size_t n = strtoul(rKey.c_str(), NULL, 10);
+      if (n < mArchiveIndex.size()) 
+        return mArchiveIndex[n];
+    }
+
+    throw std::runtime_error(std::string("Missing entry '") + rKey 
+        + "' in feature archive: '" + rFileName + "'");
+  }  // const ArchiveEntry& FindArchiveEntry
+
+
+  //***************************************************************************
+  //***************************************************************************
+  // private:
+  bool
+  FeatureRepository::
+  IsFeatureArchive(const std::string& rFileName)
+  {
+    FILE* fp = fopen(rFileName.c_str(), "rb");
+    char  magic[4];
+    bool  ret = false;
+
+    if (NULL != fp) 
+    {
+      ret = (fread(magic, sizeof(char), 4, fp) == 4 && !memcmp(magic, ARCHIVE_MAGIC, 4));
+      fclose(fp);
+    }
+    return ret;
+  }  // bool IsFeatureArchive
+
+
+  //***************************************************************************
+  //***************************************************************************
+  // private:
+  void
+  FeatureRepository::
+  MapFeatureFile(const std::string& rFileName)
+  {
+    struct stat st;
+    int         fd = fileno(mStream.fp());
+
+    // pipes and empty files are read the usual way
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size == 0)
+      return;
+
+    void* p_data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (p_data == MAP_FAILED) {
+      KALDI_WARN << "Cannot map feature file, reading it instead: " 
+                 << rFileName;
+      return;
+    }
+
+    mpMapData = static_cast<char*>(p_data);
+    mMapSize  = st.st_size;
+  }  // void MapFeatureFile
+
+
+  //***************************************************************************
+  //***************************************************************************
+  // private:
+  void
+  FeatureRepository::
+  UnmapFeatureFile()
+  {
+    delete mpView;
+    mpView = NULL;
+
+    if (NULL != mpMapData) {
+      munmap(mpMapData, mMapSize);
+    }
+
+    mpMapData = NULL;
+    mMapSize  = 0;
+  }  // void UnmapFeatureFile
+
+
   
   //***************************************************************************
   //***************************************************************************
   bool 
   FeatureRepository::
   ReadHTKFeatures(const FileListElem&    rFileNameRecord, 
-                        Matrix<BaseFloat>&        rFeatureMatrix)
+                        Matrix<BaseFloat>&        rFeatureMatrix,
+                        bool                      allowView)
   {
     std::string           file_name(rFileNameRecord.Physical());
     std::string           cmn_file_name;
@@ -575,26 +977,41 @@ namespace TNet
     int                   src_N;
     int                   comp;
     int                   coef_size;
-    char*                 chptr;
+    const char*           chptr;
+    std::string           archive_key;
+    std::string::size_type pos;
+    size_t                data_start;
   
 
   TIMER_START(mTim);
    
     // read frame range definition if any ( physical_file.fea[s,e] )
-    if ((chptr = strrchr((char*)file_name.c_str(), '[')) == NULL ||
+    if ((chptr = strrchr(file_name.c_str(), '[')) == NULL ||
         ((i=0), sscanf(chptr, "[%d,%d]%n", &from_frame, &to_frame, &i), 
          chptr[i] != '\0')) 
     {
       chptr = NULL;
     }
     
-    if (chptr != NULL)                                
-      *chptr = '\0';
+    bool range = (chptr != NULL);
+    if (range)
+      file_name.erase(chptr - file_name.c_str());
+
+    // read archive entry if any ( archive#entry[s,e] ), the part before '#'
+    // must be an archive, otherwise '#' is a part of the HTK file name
+    if ((pos = file_name.rfind('#')) != std::string::npos
+    &&  ((mLastArchive && mLastFileName.compare(0, std::string::npos, file_name, 0, pos) == 0)
+      || IsFeatureArchive(file_name.substr(0, pos)))) 
+    {
+      archive_key = file_name.substr(pos + 1);
+      file_name.erase(pos);
+    }
   
 
     if ((file_name != "-" )
     &&  (!mLastFileName.empty()) 
-    &&  (mLastFileName == file_name)) 
+    &&  (mLastFileName == file_name)
+    &&  (mLastArchive == !archive_key.empty())) 
     {
       mHeader = mLastHeader;
     } 
@@ -602,6 +1019,7 @@ namespace TNet
     {
       if (!mLastFileName.empty()) 
       {
+        UnmapFeatureFile();
         mStream.close();
         mLastFileName = "";
       }
@@ -615,13 +1033,24 @@ namespace TNet
             + file_name.c_str() + "'");
       }
       
+      if (mMapFeatures) {
+        MapFeatureFile(file_name);
+      }
+      
       
-      if (ReadHTKHeader())  {
+      if (!archive_key.empty()) 
+      {
+        if (ReadArchiveIndex()) {
+          throw std::runtime_error(std::string("Invalid feature archive: '") 
+              + file_name.c_str() + "'");
+        }
+      }
+      else if (ReadHTKHeader())  {
         throw std::runtime_error(std::string("Invalid HTK header in feature file: '") 
             + file_name.c_str() + "'");
       }
       
-      if (mHeader.mSampleKind & PARAMKIND_C) 
+      if (archive_key.empty() && (mHeader.mSampleKind & PARAMKIND_C)) 
       {
         // File is in compressed form, scale and pBias vectors
         // are appended after HTK header.
@@ -648,13 +1077,30 @@ namespace TNet
       // remember current settings
       mLastFileName = file_name;
       mLastHeader   = mHeader;
+      mLastArchive  = !archive_key.empty();
     }
+
+    // the frames of an archive entry are stored like in an HTK file 
+    // without header, starting at the offset stored in the index
+    data_start = sizeof(HtkHeader);
+    mSwapData  = mSwapFeatures;
+    mHalfData  = false;
     
-    if (chptr != NULL) {
-      *chptr = '[';
+    if (!archive_key.empty()) 
+    {
+      const ArchiveEntry& r_entry = FindArchiveEntry(archive_key, file_name);
+
+      mHeader.mNSamples     = r_entry.mNSamples;
+      mHeader.mSamplePeriod = r_entry.mSamplePeriod;
+      mHeader.mSampleSize   = r_entry.mSampleSize;
+      mHeader.mSampleKind   = r_entry.mSampleKind;
+      
+      data_start = r_entry.mOffset;
+      mSwapData  = mArchiveSwap;
+      mHalfData  = mArchiveHalf;
     }
   
-    if (chptr == NULL) { 
+    if (!range) { 
       // Range [s,e] was not specified
       from_frame = 0;
       to_frame   = mHeader.mNSamples-1;
@@ -684,7 +1130,7 @@ namespace TNet
     trg_0 = (PARAMKIND_0 & mTargetKind) != 0;
     trg_N =((PARAMKIND_N & mTargetKind) != 0) * (trg_E + trg_0);
   
-    coef_size     = comp ? sizeof(INT_16) : sizeof(FLOAT_32);
+    coef_size     = comp || mHalfData ? sizeof(INT_16) : sizeof(FLOAT_32);
     coefs         = (mHeader.mSampleSize/coef_size + src_N) / 
                     (src_deriv_order+1) - src_E - src_0;
     src_vec_size  = (coefs + src_E + src_0) * (src_deriv_order+1) - src_N;
@@ -738,6 +1184,54 @@ namespace TNet
    TIMER_END(mTim,mTimeOpen);
 
 
+    // the frames of the range are stored contiguously in the file, 
+    // so we seek once and read them in large blocks to the staging 
+    // buffer (or take them from the mapped file), where they are unpacked
+    size_t frame_bytes  = src_vec_size * coef_size;
+    size_t data_offset  = data_start 
+                          + (comp ? src_vec_size * 2 * sizeof(FLOAT_32) : 0)
+                          + from_frame * frame_bytes;
+    int    block_frames = std::max<int>(1, static_cast<int>(HTK_READ_BLOCK_SIZE / frame_bytes));
+    const char* p_src   = NULL;
+
+    if (NULL != mpMapData) 
+    {
+      e = (data_offset + (to_frame - from_frame + 1) * frame_bytes > mMapSize);
+      block_frames = to_frame - from_frame + 1;
+
+      // the frames need no conversion, point the view to the mapped data
+      if (allowView && !e && !comp && !mSwapData && !mHalfData
+      &&  sizeof(BaseFloat) == sizeof(FLOAT_32)
+      &&  ext_left == 0 && ext_right == 0
+      &&  src_deriv_order == mDerivOrder 
+      &&  src_E == trg_E && src_0 == trg_0 && src_N == trg_N
+      &&  !((mpCmnPath == NULL)
+        && !(PARAMKIND_Z & mHeader.mSampleKind) 
+        &&  (PARAMKIND_Z & mTargetKind))
+      &&  mpCmnPath == NULL && mpCvnPath == NULL && mpCvgFile == NULL)
+      {
+        mpView = new SubMatrix<BaseFloat>(
+            reinterpret_cast<BaseFloat*>(mpMapData + data_offset),
+            tot_frames, trg_vec_size, src_vec_size);
+
+        mHeader.mNSamples    = tot_frames;
+        mHeader.mSampleSize  = static_cast<INT_16>(trg_vec_size * sizeof(FLOAT_32));
+        mHeader.mSampleKind  = static_cast<INT_16>(
+                                 (mTargetKind & ~(PARAMKIND_D | PARAMKIND_A | PARAMKIND_T))
+                               | (mDerivOrder==3 ? PARAMKIND_D | PARAMKIND_A | PARAMKIND_T :
+                                  mDerivOrder==2 ? PARAMKIND_D | PARAMKIND_A :
+                                  mDerivOrder==1 ? PARAMKIND_D : 0));
+        return true;
+      }
+    }
+    else
+    {
+    TIMER_START(mTim);      
+      // seek to the first frame of the range
+      e = fseek(mStream.fp(), data_offset, SEEK_SET);
+    TIMER_END(mTim,mTimeSeek);
+    }
+
     // initialize matrix 
     rFeatureMatrix.Init(tot_frames, trg_vec_size, false);
     
@@ -748,51 +1242,53 @@ namespace TNet
       BaseFloat* B      = mpB;
       BaseFloat* mxPtr  = rFeatureMatrix.pRowData(i+ext_left);
 
-    TIMER_START(mTim);      
-      // seek to the desired position
-      fseek(mStream.fp(), 
-          sizeof(HtkHeader) + (comp ? src_vec_size * 2 * sizeof(FLOAT_32) : 0)
-          + (from_frame + i) * src_vec_size * coef_size, 
-          SEEK_SET);
-    TIMER_END(mTim,mTimeSeek);
- 
-    TIMER_START(mTim);
-      // read 
-      e = ReadHTKFeature(mxPtr, coefs, comp, A, B);
-    TIMER_END(mTim,mTimeRead);
+      // refill the staging buffer
+      if (i % block_frames == 0) 
+      {
+        int n_frames = std::min(block_frames, to_frame - from_frame + 1 - i);
+        
+      TIMER_START(mTim);      
+        if (e || (NULL == mpMapData && ReadHTKBlock(n_frames * frame_bytes))) 
+        {
+          std::ostringstream s;
+          s << i << "/" << to_frame - from_frame + 1;
+          throw std::runtime_error(std::string("Cannot read feature file: '")
+                + file_name + "' frame " + s.str());
+        }
+      TIMER_END(mTim,mTimeRead);
+        
+        p_src = (NULL != mpMapData) ? mpMapData + data_offset : mpReadBuf;
+      }
+
+      // frame in the staging buffer
+      const char* p_frame = p_src;
+      
+      UnpackHTKFeature(p_src, mxPtr, coefs, comp, A, B);
       
       mxPtr += coefs; 
       A     += coefs; 
       B     += coefs;
         
-      if (src_0 && !src_N) e |= ReadHTKFeature(mxPtr, 1, comp, A++, B++);
+      if (src_0 && !src_N) UnpackHTKFeature(p_src, mxPtr, 1, comp, A++, B++);
       if (trg_0 && !trg_N) mxPtr++;
-      if (src_E && !src_N) e |= ReadHTKFeature(mxPtr, 1, comp, A++, B++);
+      if (src_E && !src_N) UnpackHTKFeature(p_src, mxPtr, 1, comp, A++, B++);
       if (trg_E && !trg_N) mxPtr++;
   
       for (j = 0; j < lo_src_tgz_deriv_order; j++) 
       {
-        e |= ReadHTKFeature(mxPtr, coefs, comp, A, B);
+        UnpackHTKFeature(p_src, mxPtr, coefs, comp, A, B);
         mxPtr += coefs; 
         A     += coefs; 
         B     += coefs;
         
-        if (src_0) e |= ReadHTKFeature(mxPtr, 1, comp, A++, B++);
+        if (src_0) UnpackHTKFeature(p_src, mxPtr, 1, comp, A++, B++);
         if (trg_0) mxPtr++;
-        if (src_E) e |= ReadHTKFeature(mxPtr, 1, comp, A++, B++);
+        if (src_E) UnpackHTKFeature(p_src, mxPtr, 1, comp, A++, B++);
         if (trg_E) mxPtr++;
       }
 
-      if (e) {
-        KALDI_COUT << mHeader.mNSamples << "\n";
-        KALDI_COUT << 2 * sizeof(FLOAT_32) / sizeof(INT_16) << "\n";
-        KALDI_COUT << "from" << from_frame << "to" << to_frame << "i" << i << "\n";
-
-        std::ostringstream s;
-        s << i << "/" << to_frame - from_frame + 1, s.str();
-        throw std::runtime_error(std::string("Cannot read feature file: '")
-              + file_name + "' frame " + s.str());
-      }
+      // skip the derivatives we don't need
+      p_src = p_frame + frame_bytes;
     }
   
     // From now, coefs includes also trg_0 + trg_E !
@@ -918,9 +1414,10 @@ namespace TNet
       }
     }
   
-    mHeader.mSampleKind |= mDerivOrder==3 ? PARAMKIND_D | PARAMKIND_A | PARAMKIND_T :
-                           mDerivOrder==2 ? PARAMKIND_D | PARAMKIND_A :
-                           mDerivOrder==1 ? PARAMKIND_D : 0;
+    mHeader.mSampleKind = static_cast<INT_16>(mHeader.mSampleKind |
+                           (mDerivOrder==3 ? PARAMKIND_D | PARAMKIND_A | PARAMKIND_T :
+                            mDerivOrder==2 ? PARAMKIND_D | PARAMKIND_A :
+                            mDerivOrder==1 ? PARAMKIND_D : 0));
   
     //.........................................................................
     if (mpCvnPath != NULL
@@ -1064,7 +1561,7 @@ namespace TNet
         
       for (i = 0; i < feaLen; i++) 
       {
-	s = pOut[i] * pScale[i] - pBias[i];
+	s = static_cast<INT_16>(pOut[i] * pScale[i] - pBias[i]);
         if (swap) 
 	  swap2(s);
 	cc += fwrite(&s, sizeof(INT_16), 1, pOutFp);
@@ -1358,5 +1855,162 @@ namespace TNet
 
   //***************************************************************************
   //***************************************************************************
+  FeatureArchiveWriter::
+  ~FeatureArchiveWriter()
+  {
+    if (NULL != mpFp) {
+      try {
+        Close();
+      } catch (std::exception& rExc) {
+        KALDI_WARN << "Feature archive not closed properly: " << rExc.what();
+      }
+    }
+  }
+
+
+  //***************************************************************************
+  //***************************************************************************
+  void
+  FeatureArchiveWriter::
+  Open(const std::string& rFileName, bool half)
+  {
+    if (NULL != mpFp) {
+      Close();
+    }
+
+    mpFp = fopen(rFileName.c_str(), "wb");
+    if (NULL == mpFp) {
+      KALDI_ERR << "Cannot create feature archive : " << rFileName;
+    }
+
+    mFileName = rFileName;
+    mHalf     = half;
+    mIndex.clear();
+
+    // reserve space for the header, it is written by Close()
+    char header[sizeof(FeatureRepository::ArchiveHeader)];
+    memset(header, 0, sizeof(header));
+    if (fwrite(header, sizeof(header), 1, mpFp) != 1) {
+      KALDI_ERR << "Cannot write feature archive : " << mFileName;
+    }
+  }
+
+
+  //***************************************************************************
+  //***************************************************************************
+  size_t
+  FeatureArchiveWriter::
+  Write(const std::string& rKey, const Matrix<BaseFloat>& rMatrix, 
+        int sampleKind, int samplePeriod)
+  {
+    FeatureRepository::ArchiveEntry entry;
+    size_t                          coef_size = mHalf ? sizeof(UINT_16) : sizeof(FLOAT_32);
+    
+    assert(NULL != mpFp);
+
+    // align the payload
+    INT_64 offset = ftello(mpFp);
+    INT_64 aligned = (offset + FeatureRepository::ARCHIVE_ALIGN - 1) 
+                     / FeatureRepository::ARCHIVE_ALIGN * FeatureRepository::ARCHIVE_ALIGN;
+    for ( ; offset < aligned; offset++) {
+      fputc(0, mpFp);
+    }
+
+    entry.mOffset       = aligned;
+    entry.mNSamples     = static_cast<INT_32>(rMatrix.Rows());
+    entry.mSamplePeriod = samplePeriod;
+    entry.mSampleSize   = static_cast<INT_16>(rMatrix.Cols() * coef_size);
+    entry.mSampleKind   = static_cast<INT_16>(sampleKind & ~PARAMKIND_C);
+    entry.mKey          = rKey;
+
+    std::vector<FLOAT_32> f_row(rMatrix.Cols());
+    std::vector<UINT_16>  h_row(rMatrix.Cols());
+    bool                  ok = true;
+
+    for (size_t r = 0; r < rMatrix.Rows(); r++) 
+    {
+      const BaseFloat* p_row = rMatrix.pRowData(r);
+      
+      if (mHalf) {
+        for (size_t c = 0; c < rMatrix.Cols(); c++) {
+          h_row[c] = FloatToHalf(p_row[c]);
+        }
+        if (!h_row.empty()) {
+          ok &= fwrite(&h_row[0], sizeof(UINT_16), h_row.size(), mpFp) == h_row.size();
+        }
+      } else {
+        for (size_t c = 0; c < rMatrix.Cols(); c++) {
+          f_row[c] = p_row[c];
+        }
+        if (!f_row.empty()) {
+          ok &= fwrite(&f_row[0], sizeof(FLOAT_32), f_row.size(), mpFp) == f_row.size();
+        }
+      }
+    }
+
+    if (!ok) {
+      KALDI_ERR << "Cannot write feature archive : " << mFileName;
+    }
+
+    mIndex.push_back(entry);
+    return mIndex.size() - 1;
+  }
+
+
+  //***************************************************************************
+  //***************************************************************************
+  void
+  FeatureArchiveWriter::
+  Close()
+  {
+    FeatureRepository::ArchiveHeader header;
+    bool                             ok = true;
+
+    assert(NULL != mpFp);
+
+    memcpy(header.mMagic, FeatureRepository::ARCHIVE_MAGIC, 4);
+    header.mByteOrder   = FeatureRepository::ARCHIVE_BYTE_ORDER;
+    header.mVersion     = FeatureRepository::ARCHIVE_VERSION;
+    header.mFlags       = mHalf ? FeatureRepository::ARCHIVE_HALF : 0;
+    header.mIndexOffset = ftello(mpFp);
+    header.mNEntries    = static_cast<INT_32>(mIndex.size());
+    header.mReserved    = 0;
+
+    // write the index
+    for (size_t i = 0; i < mIndex.size(); i++) 
+    {
+      const FeatureRepository::ArchiveEntry& r_entry = mIndex[i];
+      INT_32 key_len = static_cast<INT_32>(r_entry.mKey.size());
+
+      ok &= fwrite(&r_entry.mOffset,       sizeof(INT_64), 1, mpFp) == 1;
+      ok &= fwrite(&r_entry.mNSamples,     sizeof(INT_32), 1, mpFp) == 1;
+      ok &= fwrite(&r_entry.mSamplePeriod, sizeof(INT_32), 1, mpFp) == 1;
+      ok &= fwrite(&r_entry.mSampleSize,   sizeof(INT_16), 1, mpFp) == 1;
+      ok &= fwrite(&r_entry.mSampleKind,   sizeof(INT_16), 1, mpFp) == 1;
+      ok &= fwrite(&key_len,               sizeof(INT_32), 1, mpFp) == 1;
+      ok &= fwrite(r_entry.mKey.data(), sizeof(char), key_len, mpFp) == (size_t) key_len;
+    }
+
+    // write the header
+    ok &= fseeko(mpFp, 0, SEEK_SET) == 0;
+    ok &= fwrite(header.mMagic,        sizeof(char),   4, mpFp) == 4;
+    ok &= fwrite(&header.mByteOrder,   sizeof(INT_32), 1, mpFp) == 1;
+    ok &= fwrite(&header.mVersion,     sizeof(INT_32), 1, mpFp) == 1;
+    ok &= fwrite(&header.mFlags,       sizeof(INT_32), 1, mpFp) == 1;
+    ok &= fwrite(&header.mIndexOffset, sizeof(INT_64), 1, mpFp) == 1;
+    ok &= fwrite(&header.mNEntries,    sizeof(INT_32), 1, mpFp) == 1;
+    ok &= fwrite(&header.mReserved,    sizeof(INT_32), 1, mpFp) == 1;
+
+    ok &= fclose(mpFp) == 0;
+    mpFp = NULL;
+    mIndex.clear();
+
+    if (!ok) {
+      KALDI_ERR << "Cannot write feature archive : " << mFileName;
+    }
+  }
+
+  //***************************************************************************
+  //***************************************************************************
 
 } // namespace TNet
@@ -18,8 +18,10 @@
 // Standard includes
 //
 #include <list>
+#include <map>
 #include <queue>
 #include <string>
+#include <vector>
 
 
 //*****************************************************************************
@@ -134,6 +136,51 @@ namespace TNet
     };
 
 
+    /**
+     * @brief Header of the packed feature archive
+     *
+     * The archive consists of this header, the feature payloads of the 
+     * entries (each aligned to ARCHIVE_ALIGN bytes, frames stored as 
+     * consecutive rows of FLOAT_32 or half precision values) and the index
+     * of the entries at mIndexOffset. Everything is stored in the byte 
+     * order of the writer, which is detected by mByteOrder. Entries are 
+     * addressed from the script files by their number as archive#N[s,e] 
+     * or by their name as archive#:name[s,e]. The part before '#' is taken
+     * as an archive only if it starts with ARCHIVE_MAGIC, otherwise '#' 
+     * belongs to the name of an HTK file.
+     */
+    struct ArchiveHeader
+    {
+      char    mMagic[4];
+      INT_32  mByteOrder;
+      INT_32  mVersion;
+      INT_32  mFlags;
+      INT_64  mIndexOffset;
+      INT_32  mNEntries;
+      INT_32  mReserved;
+    };
+
+
+    /**
+     * @brief Index record of one feature archive entry
+     */
+    struct ArchiveEntry
+    {
+      INT_64      mOffset;
+      INT_32      mNSamples;
+      INT_32      mSamplePeriod;
+      INT_16      mSampleSize;
+      INT_16      mSampleKind;
+      std::string mKey;
+    };
+
+    static const char   ARCHIVE_MAGIC[4];
+    static const INT_32 ARCHIVE_BYTE_ORDER = 0x01020304;
+    static const INT_32 ARCHIVE_VERSION    = 1;
+    static const INT_32 ARCHIVE_HALF       = 1;
+    static const size_t ARCHIVE_ALIGN      = 64;
+
+
     /** 
      * @brief Normalization file type
      */
@@ -186,6 +233,8 @@ namespace TNet
     const char*                 mpCvnMask;
 
     int                         mTrace;
+    /// map the feature files to memory instead of reading them
+    bool                        mMapFeatures;
     
     
     // Constructors and destructors
@@ -194,10 +243,14 @@ namespace TNet
      */
     FeatureRepository() : mDerivWinLengths(NULL), mpCvgFile(NULL), 
        mpCmnPath(NULL), mpCmnMask(NULL), mpCvnPath(NULL), mpCvnMask(NULL),
-       mTrace(0),
+       mTrace(0), mMapFeatures(false),
        mpLastFileName(NULL), mLastFileName(""), mpLastCmnFile (NULL), 
        mpLastCvnFile (NULL), mpLastCvgFile (NULL), mpCmn(NULL), 
        mpCvn(NULL), mpCvg(NULL), mpA(NULL), mpB(NULL),
+       mpReadBuf(NULL), mReadBufSize(0),
+       mpMapData(NULL), mMapSize(0), mpView(NULL),
+       mSwapData(false), mHalfData(false), 
+       mLastArchive(false), mArchiveSwap(false), mArchiveHalf(false),
        mTimeOpen(0), mTimeSeek(0), mTimeRead(0), mTimeNormalize(0) 
     { 
       mInputQueueIterator        = mInputQueue.end();
@@ -209,10 +262,14 @@ namespace TNet
     FeatureRepository(const FeatureRepository& ori)
      : mDerivWinLengths(NULL), mpCvgFile(NULL), 
        mpCmnPath(NULL), mpCmnMask(NULL), mpCvnPath(NULL), mpCvnMask(NULL),
-       mTrace(0),
+       mTrace(0), mMapFeatures(false),
        mpLastFileName(NULL), mLastFileName(""), mpLastCmnFile (NULL), 
        mpLastCvnFile (NULL), mpLastCvgFile (NULL), mpCmn(NULL), 
        mpCvn(NULL), mpCvg(NULL), mpA(NULL), mpB(NULL),
+       mpReadBuf(NULL), mReadBufSize(0),
+       mpMapData(NULL), mMapSize(0), mpView(NULL),
+       mSwapData(false), mHalfData(false), 
+       mLastArchive(false), mArchiveSwap(false), mArchiveHalf(false),
        mTimeOpen(0), mTimeSeek(0), mTimeRead(0), mTimeNormalize(0) 
     {
       //copy all the data from the input queue
@@ -232,6 +289,8 @@ namespace TNet
         ori.mpCvnMask,
         ori.mpCvgFile);
      
+      mMapFeatures = ori.mMapFeatures;
+
       //set on the end 
       mInputQueueIterator        = mInputQueue.end(); 
       //copy default header values
@@ -251,6 +310,12 @@ namespace TNet
       if (NULL != mpB) {
         free(mpB);
       }
+
+      if (NULL != mpReadBuf) {
+        free(mpReadBuf);
+      }
+
+      UnmapFeatureFile();
       //remove all entries
       mInputQueue.clear();
 
@@ -365,6 +430,10 @@ namespace TNet
     
     void Trace(int trace)
     { mTrace = trace; } 
+
+    /// Enables mapping of the feature files to memory (see ReadFullMatrixView)
+    void MapFeatures(bool map)
+    { mMapFeatures = map; } 
         
     /** 
      * @brief Returns a refference to the current file header
@@ -417,6 +486,15 @@ namespace TNet
     AddFile(const std::string & rFileName);
     
 
+    /**
+     * @brief Keeps only the records at the given positions of the list,
+     * in the given order
+     * @param rPositions positions of the records to keep (may repeat)
+     */
+    void
+    SelectRecords(const std::vector<size_t>& rPositions);
+    
+
     /**
      * @brief Adds a list of feature files to the repository
      * @param rFileName feature list file to read from
@@ -443,6 +521,21 @@ namespace TNet
      */
     bool
     ReadFullMatrix(Matrix<BaseFloat>& rMatrix); 
+
+    /**
+     * @brief Reads full feature matrix, avoiding the copy if possible
+     * @param rMatrix matrix to be filled with read data if the copy is needed
+     * @return reference to the read features
+     *
+     * If @c mMapFeatures is set and the current file stores uncompressed 
+     * frames in native byte order which need no conversion, normalization 
+     * or context extension, the returned matrix is a read-only view over 
+     * the mapped feature file. Otherwise the features are read to @c rMatrix
+     * and @c rMatrix is returned. The view is valid until the next read 
+     * from the repository.
+     */
+    const Matrix<BaseFloat>&
+    ReadFullMatrixView(Matrix<BaseFloat>& rMatrix); 
     
     bool
     WriteFeatureMatrix(const Matrix<BaseFloat>& rMatrix, const std::string& filename, int targetKind, int samplePeriod);
@@ -541,6 +634,26 @@ namespace TNet
     BaseFloat*                      mpA;
     BaseFloat*                      mpB;
 
+    // staging buffer for the block-wise reading of the frames
+    char*                       mpReadBuf;
+    size_t                      mReadBufSize;
+
+    // the current feature file mapped to memory (mMapFeatures mode)
+    char*                       mpMapData;
+    size_t                      mMapSize;
+    SubMatrix<BaseFloat>*       mpView;
+
+    // byte order and precision of the currently read frames
+    bool                        mSwapData;
+    bool                        mHalfData;
+
+    // index of the current feature archive
+    bool                        mLastArchive;
+    bool                        mArchiveSwap;
+    bool                        mArchiveHalf;
+    std::vector<ArchiveEntry>   mArchiveIndex;
+    std::map<std::string, size_t> mArchiveKeys;
+
 
 
     Timer mTim;
@@ -561,12 +674,53 @@ namespace TNet
       BaseFloat*    pScale, 
       BaseFloat*    pBias);
 
+    // Reads nBytes from the current stream to the staging buffer
+    int 
+    ReadHTKBlock(size_t nBytes);
+
+    // Unpacks one feature (sub)vector from the staging buffer, 
+    // the source pointer is moved past the unpacked data
+    void
+    UnpackHTKFeature(const char*& rpSrc,
+      BaseFloat*    pOut, 
+      size_t    feaLen, 
+      bool      decompress, 
+      BaseFloat*    pScale, 
+      BaseFloat*    pBias);
+
     
     bool 
     ReadHTKFeatures(const std::string& rFileName, Matrix<BaseFloat>& rFeatureMatrix);
     
+    // Reads the current record, see ReadFullMatrix and ReadFullMatrixView
+    bool
+    ReadCurrentFile(Matrix<BaseFloat>& rMatrix, bool allowView);
+
+    // If allowView is set, mpView may be pointed at the mapped frames
+    // instead of filling rFeatureMatrix
     bool 
-    ReadHTKFeatures(const FileListElem& rFileNameRecord, Matrix<BaseFloat>& rFeatureMatrix);
+    ReadHTKFeatures(const FileListElem& rFileNameRecord, Matrix<BaseFloat>& rFeatureMatrix,
+        bool allowView = false);
+
+    // Reads the header and the index of the opened feature archive
+    int
+    ReadArchiveIndex();
+
+    // Finds the archive entry given by its number N or its name as :name
+    const ArchiveEntry&
+    FindArchiveEntry(const std::string& rKey, const std::string& rFileName);
+
+    // Checks the magic of the feature archive at the start of the file
+    static bool
+    IsFeatureArchive(const std::string& rFileName);
+
+    // Maps the currently opened feature file to memory (if it is a regular file)
+    void
+    MapFeatureFile(const std::string& rFileName);
+
+    // Releases the mapping of the feature file and the view over it
+    void
+    UnmapFeatureFile();
 
 
     int 
@@ -595,6 +749,60 @@ namespace TNet
 
   }; // class FeatureStream
 
+
+
+  /** *************************************************************************
+   * @brief Writes the packed feature archive (see FeatureRepository::ArchiveHeader)
+   */
+  class FeatureArchiveWriter
+  {
+  public:
+    FeatureArchiveWriter() : mpFp(NULL), mHalf(false) 
+    { }
+
+    /// closes the archive if Close() was not called, the errors of this
+    /// Close() are only reported (call Close() to get the exception)
+    ~FeatureArchiveWriter();
+
+    /**
+     * @brief Creates a new archive
+     * @param rFileName name of the archive file
+     * @param half store the features in half precision
+     */
+    void
+    Open(const std::string& rFileName, bool half = false);
+
+    /**
+     * @brief Appends the feature matrix to the archive
+     * @return number of the entry, used to address it as archive#N
+     *         (or archive#:key by its key)
+     */
+    size_t
+    Write(const std::string& rKey, const Matrix<BaseFloat>& rMatrix, 
+          int sampleKind, int samplePeriod);
+
+    /**
+     * @brief Writes the index and closes the archive
+     */
+    void
+    Close();
+
+    bool
+    IsOpen() const
+    { return NULL != mpFp; }
+
+    /// Returns the number of entries written so far
+    size_t
+    Entries() const
+    { return mIndex.size(); }
+
+  private:
+    FILE*                                         mpFp;
+    bool                                          mHalf;
+    std::string                                   mFileName;
+    std::vector<FeatureRepository::ArchiveEntry>  mIndex;
+  }; // class FeatureArchiveWriter
+
 } //namespace TNet
 
 #endif // TNet_Features_h
@@ -1,6 +1,8 @@
 #include "Labels.h"
 #include "Timer.h"
 
+#include <limits>
+
 
 namespace TNet {
 
@@ -47,7 +49,61 @@ namespace TNet {
   {
     //timer
     Timer tim; tim.Start();
+
+    //get the target ids
+    std::vector<size_t> tgt_id_vec;
+    if(!ReadTargetIds(tgt_id_vec, nFrames, sourceRate, pFeatureLogical)) {
+      return false;
+    }
+
+    //resize the output matrix
+    rDesired.Init(nFrames, mLabelMap.size(), true); //true: Zero()
+    //fill the matrix with ones
+    for(size_t r=0; r<rDesired.Rows(); r++) {
+      rDesired(r,tgt_id_vec[r]) = 1.0;
+    }
+
+    //timer
+    tim.End(); mGenDesiredMatrixTime += tim.Val();
     
+    return true;
+  }
+
+
+  bool 
+  LabelRepository::
+  GenTargetIds(BfMatrix& rTargets, size_t nFrames, size_t sourceRate, const char* pFeatureLogical)
+  {
+    //timer
+    Timer tim; tim.Start();
+
+    //get the target ids
+    std::vector<size_t> tgt_id_vec;
+    if(!ReadTargetIds(tgt_id_vec, nFrames, sourceRate, pFeatureLogical)) {
+      return false;
+    }
+
+    //one column with the class ids,
+    //BaseFloat holds them exactly up to 2^digits
+    if(mLabelMap.size() > (static_cast<size_t>(1) << std::numeric_limits<BaseFloat>::digits)) {
+      KALDI_ERR << "Too many classes for the sparse targets: " << mLabelMap.size();
+    }
+    rTargets.Init(nFrames, 1, false);
+    for(size_t r=0; r<rTargets.Rows(); r++) {
+      rTargets(r,0) = static_cast<BaseFloat>(tgt_id_vec[r]);
+    }
+
+    //timer
+    tim.End(); mGenDesiredMatrixTime += tim.Val();
+    
+    return true;
+  }
+
+
+  bool 
+  LabelRepository::
+  ReadTargetIds(std::vector<size_t>& rTgtIds, size_t nFrames, size_t sourceRate, const char* pFeatureLogical)
+  {
     //Get the MLF stream reference...
     IMlfStream& mLabelStream = *mpLabelStream;
     //Build the file name of the label
@@ -62,7 +118,8 @@ namespace TNet {
     }
 
     //prepare a vector with desired matrix indices
-    std::vector<size_t> tgt_id_vec;
+    std::vector<size_t>& tgt_id_vec = rTgtIds;
+    tgt_id_vec.clear();
     tgt_id_vec.reserve(nFrames);
 
     //aux variables
@@ -134,32 +191,23 @@ namespace TNet {
       if((tgt_id_vec.size() < nFrames) && (nFrames - tgt_id_vec.size() <= 10)) {
         //tolerate labels shorter by up tp 10 frames, fill with last tgt_id...
         size_t extra_frames = nFrames - tgt_id_vec.size();
-        sprintf(message,"Filling extra %d frames of : %s in %s", extra_frames, state.c_str(), mpLabelFile);
+        sprintf(message,"Filling extra %lu frames of : %s in %s", (unsigned long)extra_frames, state.c_str(), mpLabelFile);
         KALDI_WARN << message;
         tgt_id_vec.insert(tgt_id_vec.end(), nFrames-tgt_id_vec.size(), tgt_id_vec.back());
       } else if ((tgt_id_vec.size() > nFrames) && (tgt_id_vec.size() - nFrames <= 10))  {
         //tolerate labels longer by up to 10 frames 
         size_t extra_frames = tgt_id_vec.size()-nFrames;
-        sprintf(message,"Labels longer than features by %d frames at : %s , truncating...", extra_frames, mpLabelFile); 
+        sprintf(message,"Labels longer than features by %lu frames at : %s , truncating...", (unsigned long)extra_frames, mpLabelFile); 
         KALDI_WARN << message;
       } else {
         //better skip that file
-        sprintf(message,"Non-matching length of features %d and labels %d at : %s , skipping...", nFrames, tgt_id_vec.size(), mpLabelFile); 
+        sprintf(message,"Non-matching length of features %lu and labels %lu at : %s , skipping...", (unsigned long)nFrames, (unsigned long)tgt_id_vec.size(), mpLabelFile); 
         KALDI_WARN << message;
         return false;
       }
     }
+    tgt_id_vec.resize(nFrames);
 
-    //resize the output matrix
-    rDesired.Init(nFrames, mLabelMap.size(), true); //true: Zero()
-    //fill the matrix with ones
-    for(int r=0; r<rDesired.Rows(); r++) {
-      rDesired(r,tgt_id_vec[r]) = 1.0;
-    }
-
-    //timer
-    tim.End(); mGenDesiredMatrixTime += tim.Val();
-    
     return true;
   }
 
@@ -7,6 +7,7 @@
 #include "Features.h"
 
 #include <map>
+#include <vector>
 #include <iostream>
 
 namespace TNet {
@@ -52,7 +53,13 @@ namespace TNet {
       /// Get desired matrix from labels
       bool GenDesiredMatrix(BfMatrix& rDesired, size_t nFrames, size_t sourceRate, const char* pFeatureLogical);
 
+      /// Get sparse targets from labels (one column with the class ids)
+      bool GenTargetIds(BfMatrix& rTargets, size_t nFrames, size_t sourceRate, const char* pFeatureLogical);
+
     private:
+      /// Parse the MLF record to a vector of class ids (one per frame)
+      bool ReadTargetIds(std::vector<size_t>& rTgtIds, size_t nFrames, size_t sourceRate, const char* pFeatureLogical);
+
       /// Prepare the state-label to state-id map
       void ReadOutputLabelMap(const char* file);
       
@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <stdexcept>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 
 #ifdef HAVE_BLAS
 extern "C"{
@@ -559,6 +561,12 @@ namespace TNet
                 const size_t    co,
                 const size_t    c);
 
+      /// Constructor over externally owned memory (e.g. a mapped file)
+      SubMatrix(_ElemT*         pData,
+                const size_t    r,
+                const size_t    c,
+                const size_t    stride);
+
 
       /// The destructor
       ~SubMatrix<_ElemT>()
@@ -622,6 +630,82 @@ namespace TNet
     }
   }
 
+  /**
+   * Add the rows [origin, origin+rDst.Rows()) of all the matrices rSrc to rDst,
+   * the columns go by blocks so the block of rDst stays in the L1 cache
+   * while the sources are added (one pass over rDst instead of rSrc.size()),
+   * the elements are summed in the order of rSrc as by repeated Add()
+   */
+  template<typename _ElemT, typename _ElemU>
+  void AddRows(Matrix<_ElemT>& rDst, const std::vector<const Matrix<_ElemU>*>& rSrc, size_t origin) {
+    const size_t block = 4096 / sizeof(_ElemT);
+
+    for(size_t i=0; i<rDst.Rows(); i++) {
+      _ElemT* p_dst = rDst.pRowData(i);
+      for(size_t j0=0; j0<rDst.Cols(); j0+=block) {
+        size_t j1 = std::min(j0+block, rDst.Cols());
+        for(size_t s=0; s<rSrc.size(); s++) {
+          assert(rSrc[s]->Cols() == rDst.Cols());
+          assert(origin+rDst.Rows() <= rSrc[s]->Rows());
+          const _ElemU* p_src = rSrc[s]->pRowData(origin+i);
+          for(size_t j=j0; j<j1; j++) {
+            p_dst[j] += (_ElemT)p_src[j];
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Kahan summation of pSrc to pDst, pComp keeps the compensations,
+   * the fixed length lets the compiler vectorize the loop at -O2
+   * (in the precision of _ElemT, double for BaseFloat with -DDOUBLEPRECISION)
+   */
+  template<typename _ElemT, size_t _N>
+  inline void KahanAdd(_ElemT* __restrict__ pDst, _ElemT* __restrict__ pComp, 
+                       const _ElemT* __restrict__ pSrc, size_t n = _N) {
+    for(size_t j=0; j<(_N ? _N : n); j++) {
+      _ElemT y = pSrc[j] - pComp[j];
+      _ElemT t = pDst[j] + y;
+      pComp[j] = (t - pDst[j]) - y;
+      pDst[j] = t;
+    }
+  }
+
+  /**
+   * AddRows() with compensated (Kahan) summation for single-precision
+   * accumulators: the rounding error of each addition goes to the next one,
+   * so the sum over the sources is as accurate as a double one
+   * (with -DDOUBLEPRECISION the BaseFloat accumulator is already double)
+   */
+  template<typename _ElemT>
+  void AddRowsKahan(Matrix<_ElemT>& rDst, const std::vector<const Matrix<_ElemT>*>& rSrc, size_t origin) {
+    const size_t block = 4096 / sizeof(_ElemT);
+    _ElemT comp[block];
+
+    for(size_t i=0; i<rDst.Rows(); i++) {
+      _ElemT* p_dst = rDst.pRowData(i);
+      for(size_t j0=0; j0<rDst.Cols(); j0+=block) {
+        size_t n = std::min(block, rDst.Cols()-j0);
+        std::fill(comp, comp+n, (_ElemT)0);
+        for(size_t s=0; s<rSrc.size(); s++) {
+          assert(rSrc[s]->Cols() == rDst.Cols());
+          assert(origin+rDst.Rows() <= rSrc[s]->Rows());
+          const _ElemT* p_src = rSrc[s]->pRowData(origin+i) + j0;
+          if(n == block) {
+            KahanAdd<_ElemT, 4096/sizeof(_ElemT)>(p_dst+j0, comp, p_src);
+          } else {
+            KahanAdd<_ElemT, 0>(p_dst+j0, comp, p_src, n);
+          }
+        }
+        //the error of the last addition
+        for(size_t j=0; j<n; j++) {
+          p_dst[j0+j] -= comp[j];
+        }
+      }
+    }
+  }
+
   /**
    * Function for summing matrices of different types
    */
@@ -646,6 +730,73 @@ namespace TNet
     }
   }
 
+  /**
+   * Write the transpose of rM (the layout of the weight matrices in model files),
+   * binary streams get the data of rM as they are (column-major 'T' record)
+   */
+  template<typename _ElemT>
+  void WriteTransposed(std::ostream& rOut, const Matrix<_ElemT>& rM) {
+    if(MatrixVectorIostreamControl::Flags(rOut, BINARY_OUTPUT)) {
+      WriteBinaryHeader(rOut, 'T', BinaryTypeCode<_ElemT>(), rM.Cols(), rM.Rows());
+      for(size_t i=0; i<rM.Rows(); i++) {
+        WriteBinaryData(rOut, rM.pRowData(i), sizeof(_ElemT), rM.Cols());
+      }
+    } else {
+      rOut << Matrix<_ElemT>(rM, TRANS);
+    }
+  }
+
+  /**
+   * Read a matrix and store its transpose to rM,
+   * 'T' records are read directly into rM without a temporary copy
+   */
+  template<typename _ElemT>
+  void ReadTransposed(std::istream& rIn, Matrix<_ElemT>& rM) {
+    while(isascii(rIn.peek()) && isspace(rIn.peek())) rIn.get();
+    if(rIn.peek() == 'T' && !MatrixVectorIostreamControl::Flags(rIn, ACCUMULATE_INPUT)) {
+      rIn.get();
+      char type;
+      size_t nrows, ncols;
+      ReadBinaryHeader(rIn, type, nrows, &ncols);
+      if(rM.Rows()!=ncols || rM.Cols()!=nrows) rM.Init(ncols,nrows);
+      for(size_t i=0; i<rM.Rows(); i++) {
+        ReadBinaryElems(rIn, type, rM.pRowData(i), rM.Cols(), false);
+      }
+    } else {
+      Matrix<_ElemT> transpose;
+      rIn >> transpose;
+      rM.Init(transpose.Cols(), transpose.Rows()).Copy(transpose, TRANS);
+    }
+  }
+
+  /**
+   * Use a 'T' record of a MemoryIstream in place (see ReadTransposed),
+   * returns a read-only view of the mapped data, or NULL (nothing read)
+   * if the data are not a record of the same type aligned in memory
+   */
+  template<typename _ElemT>
+  const SubMatrix<_ElemT>* MapTransposed(std::istream& rIn) {
+    while(isascii(rIn.peek()) && isspace(rIn.peek())) rIn.get();
+    size_t avail = 0;
+    const char* p_rec = MappedPosition(rIn, avail);
+    const size_t header = 10;
+    if(NULL == p_rec || avail < header || IsBigEndian() ||
+       p_rec[0] != 'T' || p_rec[1] != BinaryTypeCode<_ElemT>()) {
+      return NULL;
+    }
+    int dims[2];
+    memcpy(dims, p_rec+2, sizeof(dims));
+    const char* p_data = p_rec + header;
+    if(dims[0] <= 0 || dims[1] <= 0 || ((size_t)p_data) % 16 != 0) return NULL;
+    size_t size = (size_t)dims[0] * dims[1] * sizeof(_ElemT);
+    if(avail < header + size) {
+      throw std::runtime_error("Failed to map matrix: truncated data");
+    }
+    rIn.seekg(header + size, std::ios::cur);
+    //the data are the rows of the transpose
+    return new SubMatrix<_ElemT>(reinterpret_cast<_ElemT*>(const_cast<char*>(p_data)), 
+                                 dims[1], dims[0], dims[0]);
+  }
 
 
 
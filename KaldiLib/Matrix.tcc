@@ -106,7 +106,7 @@ namespace TNet
         assert(mMCols == rM.Rows() && mMRows == rM.Cols());        
         for(size_t i = 0; i < mMRows; i++) 
           for(size_t j = 0; j < mMCols; j++)
-            (*this)(i,j) = rM(j,i);
+            (*this)(i,j) = static_cast<_ElemT>(rM(j,i));
         return *this;
       }
     }
@@ -538,6 +538,13 @@ namespace TNet
     std::ostream &
     operator << (std::ostream & rOut, const Matrix<_ElemT> & rM)
     {
+      if(MatrixVectorIostreamControl::Flags(rOut, BINARY_OUTPUT)) {
+        WriteBinaryHeader(rOut, 'M', BinaryTypeCode<_ElemT>(), rM.Rows(), rM.Cols());
+        for (size_t i = 0; i < rM.Rows(); i++) {
+          WriteBinaryData(rOut, rM.pRowData(i), sizeof(_ElemT), rM.Cols());
+        }
+        return rOut;
+      }
       rOut << "m " << rM.Rows() << ' ' << rM.Cols() << '\n';
       Save(rOut, rM);
       return rOut;
@@ -577,6 +584,42 @@ namespace TNet
     }
 
 
+  //****************************************************************************
+  //****************************************************************************
+  template<typename _ElemT>
+    void LoadBinary (std::istream & rIn, Matrix<_ElemT> & rM)
+    {
+      char tag = static_cast<char>(rIn.get()); // 'M' or 'T'
+      char type;
+      size_t nrows, ncols;
+      ReadBinaryHeader(rIn, type, nrows, &ncols);
+      bool accumulate = MatrixVectorIostreamControl::Flags(rIn, ACCUMULATE_INPUT);
+
+      if(rM.Rows()!=nrows || rM.Cols()!=ncols) {
+        if(accumulate) { 
+          throw std::runtime_error("Failed to accumulate matrix from stream: size mismatch"); 
+        }
+        rM.Init(nrows,ncols);
+      }
+
+      if(tag == 'M') {
+        for (size_t i = 0; i < nrows; i++) {
+          ReadBinaryElems(rIn, type, rM.pRowData(i), ncols, accumulate);
+        }
+      } else {
+        // column-major data, read row by row of the transpose
+        Vector<_ElemT> col(nrows);
+        for (size_t j = 0; j < ncols; j++) {
+          ReadBinaryElems(rIn, type, col.pData(), nrows, false);
+          for (size_t i = 0; i < nrows; i++) {
+            if(accumulate) rM(i,j) += col[i];
+            else rM(i,j) = col[i];
+          }
+        }
+      }
+    }
+
+
   //****************************************************************************
   //****************************************************************************
   template<typename _ElemT>
@@ -584,6 +627,10 @@ namespace TNet
     operator >> (std::istream & rIn, Matrix<_ElemT> & rM)
     {
       while(isascii(rIn.peek()) && isspace(rIn.peek())) rIn.get(); // eat up space.
+      if(rIn.peek() == 'M' || rIn.peek() == 'T') { // binary record
+        LoadBinary(rIn,rM);
+        return rIn;
+      }
       if(rIn.peek() == 'm'){ // "new" format: m <nrows> <ncols> \n 1.0 0.2 4.3 ...
         rIn.get();// eat up the 'm'.
         long long int nrows=-1; rIn>>nrows; 
@@ -624,6 +671,25 @@ namespace TNet
     }
 
 
+  //****************************************************************************
+  //****************************************************************************
+  // Constructor
+  template<typename _ElemT>
+    SubMatrix<_ElemT>::
+    SubMatrix(_ElemT*         pData,
+              const size_t    r,
+              const size_t    c,
+              const size_t    stride)
+    {
+      assert(NULL != pData);
+      assert(c <= stride);
+      Matrix<_ElemT>::mMRows = r;
+      Matrix<_ElemT>::mMCols = c;
+      Matrix<_ElemT>::mStride = stride;
+      Matrix<_ElemT>::mpData = pData;
+    }
+
+
 
 #ifdef HAVE_BLAS
 
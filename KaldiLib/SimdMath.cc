@@ -0,0 +1,339 @@
+
+#include "SimdMath.h"
+#include "Common.h"
+#include "MathAux.h"
+
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define TNET_SIMD_X86
+# include <immintrin.h>
+#endif
+
+
+namespace TNet {
+
+  //****************************************************************************
+  // Cephes-style polynomial exp : exp(x) = 2^n * exp(r), |r| <= ln(2)/2
+  //****************************************************************************
+  static const float EXP_HI = 88.0f;
+  static const float EXP_LO = -88.0f;
+  static const float EXP_LOG2E = 1.44269504088896341f;
+  static const float EXP_C1 = 0.693359375f;   //ln(2) split to two parts
+  static const float EXP_C2 = -2.12194440e-4f;
+  static const float EXP_P0 = 1.9875691500e-4f;
+  static const float EXP_P1 = 1.3981999507e-3f;
+  static const float EXP_P2 = 8.3334519073e-3f;
+  static const float EXP_P3 = 4.1665795894e-2f;
+  static const float EXP_P4 = 1.6666665459e-1f;
+  static const float EXP_P5 = 5.0000001201e-1f;
+
+  /// Operations of the kernels
+  typedef enum { OP_EXP, OP_SIGMOID, OP_TANH } SimdOp;
+
+  /// Scalar version of the polynomial exp (for the tails of SIMD loops)
+  static inline float ExpPoly(float x)
+  {
+    if(x > EXP_HI) x = EXP_HI;
+    if(x < EXP_LO) x = EXP_LO;
+    float fx = floorf(x*EXP_LOG2E + 0.5f);
+    x = x - fx*EXP_C1 - fx*EXP_C2;
+    float z = x*x;
+    float y = EXP_P0;
+    y = y*x + EXP_P1;
+    y = y*x + EXP_P2;
+    y = y*x + EXP_P3;
+    y = y*x + EXP_P4;
+    y = y*x + EXP_P5;
+    y = y*z + x + 1.0f;
+    union { int i; float f; } pow2n;
+    pow2n.i = (static_cast<int>(fx) + 127) << 23;
+    return y*pow2n.f;
+  }
+
+  static inline float OpPoly(float x, int op)
+  {
+    switch(op) {
+      case OP_EXP:     return ExpPoly(x);
+      case OP_SIGMOID: return 1.0f/(1.0f+ExpPoly(-x));
+      default:       { float e = ExpPoly(2.0f*x); return (e-1.0f)/(e+1.0f); }
+    }
+  }
+
+  /// Reference kernels by libm, the expressions of the original scalar code
+  /// (Vector::ApplyExp, Sigmoid/Tanh::PropagateFnc) with the same rounding
+  static void ApplyLibm(const float* pIn, float* pOut, size_t n, int op)
+  {
+    switch(op) {
+      case OP_EXP:
+        for(size_t i=0; i<n; i++) pOut[i] = static_cast<float>(_EXP(pIn[i]));
+        break;
+      case OP_SIGMOID:
+        for(size_t i=0; i<n; i++) pOut[i] = static_cast<float>(1.0f/(1.0f+exp(-pIn[i])));
+        break;
+      default:
+        for(size_t i=0; i<n; i++) {
+          float exp2x = static_cast<float>(exp(2.0*pIn[i]));
+          pOut[i] = (std::isinf(exp2x) ? 1.0f : static_cast<float>((exp2x-1.0)/(exp2x+1.0)));
+        }
+    }
+  }
+
+
+#ifdef TNET_SIMD_X86
+
+  //****************************************************************************
+  // SSE2
+  //****************************************************************************
+  __attribute__((target("sse2")))
+  static inline __m128 Exp4(__m128 x)
+  {
+    const __m128 one = _mm_set1_ps(1.0f);
+    x = _mm_min_ps(x, _mm_set1_ps(EXP_HI));
+    x = _mm_max_ps(x, _mm_set1_ps(EXP_LO));
+    __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(EXP_LOG2E)), _mm_set1_ps(0.5f));
+    //floor (no roundps in SSE2)
+    __m128 tmp = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    fx = _mm_sub_ps(tmp, _mm_and_ps(_mm_cmpgt_ps(tmp, fx), one));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C1)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C2)));
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 y = _mm_set1_ps(EXP_P0);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+    y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), one);
+    __m128i n = _mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127));
+    return _mm_mul_ps(y, _mm_castsi128_ps(_mm_slli_epi32(n, 23)));
+  }
+
+  __attribute__((target("sse2")))
+  static void ApplySse2(const float* pIn, float* pOut, size_t n, int op)
+  {
+    const __m128 one = _mm_set1_ps(1.0f);
+    size_t i = 0;
+    for( ; i+4 <= n; i += 4) {
+      __m128 x = _mm_loadu_ps(pIn+i);
+      __m128 y;
+      switch(op) {
+        case OP_EXP:
+          y = Exp4(x);
+          break;
+        case OP_SIGMOID:
+          y = _mm_div_ps(one, _mm_add_ps(one, Exp4(_mm_sub_ps(_mm_setzero_ps(), x))));
+          break;
+        default: {
+          __m128 e = Exp4(_mm_add_ps(x, x));
+          y = _mm_div_ps(_mm_sub_ps(e, one), _mm_add_ps(e, one));
+        }
+      }
+      _mm_storeu_ps(pOut+i, y);
+    }
+    for( ; i < n; i++) {
+      pOut[i] = OpPoly(pIn[i], op);
+    }
+  }
+
+
+  //****************************************************************************
+  // AVX2 + FMA
+  //****************************************************************************
+  __attribute__((target("avx2,fma")))
+  static inline __m256 Exp8(__m256 x)
+  {
+    x = _mm256_min_ps(x, _mm256_set1_ps(EXP_HI));
+    x = _mm256_max_ps(x, _mm256_set1_ps(EXP_LO));
+    __m256 fx = _mm256_fmadd_ps(x, _mm256_set1_ps(EXP_LOG2E), _mm256_set1_ps(0.5f));
+    fx = _mm256_floor_ps(fx);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C1), x);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C2), x);
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 y = _mm256_set1_ps(EXP_P0);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+    y = _mm256_add_ps(_mm256_fmadd_ps(y, z, x), _mm256_set1_ps(1.0f));
+    __m256i n = _mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127));
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(n, 23)));
+  }
+
+  __attribute__((target("avx2,fma")))
+  static void ApplyAvx2(const float* pIn, float* pOut, size_t n, int op)
+  {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for( ; i+8 <= n; i += 8) {
+      __m256 x = _mm256_loadu_ps(pIn+i);
+      __m256 y;
+      switch(op) {
+        case OP_EXP:
+          y = Exp8(x);
+          break;
+        case OP_SIGMOID:
+          y = _mm256_div_ps(one, _mm256_add_ps(one, Exp8(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+          break;
+        default: {
+          __m256 e = Exp8(_mm256_add_ps(x, x));
+          y = _mm256_div_ps(_mm256_sub_ps(e, one), _mm256_add_ps(e, one));
+        }
+      }
+      _mm256_storeu_ps(pOut+i, y);
+    }
+    for( ; i < n; i++) {
+      pOut[i] = OpPoly(pIn[i], op);
+    }
+  }
+
+
+  //****************************************************************************
+  // AVX-512F
+  //****************************************************************************
+  //the zero-masking forms with all the lanes set: the plain intrinsics
+  //pass an undefined vector as the source of the masked-off lanes,
+  //which GCC 12 reports as possibly uninitialized
+  static const __mmask16 MASK_ALL16 = 0xffff;
+
+  __attribute__((target("avx512f")))
+  static inline __m512 Exp16(__m512 x)
+  {
+    x = _mm512_maskz_min_ps(MASK_ALL16, x, _mm512_set1_ps(EXP_HI));
+    x = _mm512_maskz_max_ps(MASK_ALL16, x, _mm512_set1_ps(EXP_LO));
+    __m512 fx = _mm512_fmadd_ps(x, _mm512_set1_ps(EXP_LOG2E), _mm512_set1_ps(0.5f));
+    fx = _mm512_maskz_roundscale_ps(MASK_ALL16, fx, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C1), x);
+    x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C2), x);
+    __m512 z = _mm512_mul_ps(x, x);
+    __m512 y = _mm512_set1_ps(EXP_P0);
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P1));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P2));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P3));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P4));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P5));
+    y = _mm512_add_ps(_mm512_fmadd_ps(y, z, x), _mm512_set1_ps(1.0f));
+    __m512i n = _mm512_add_epi32(_mm512_maskz_cvttps_epi32(MASK_ALL16, fx), _mm512_set1_epi32(127));
+    return _mm512_mul_ps(y, _mm512_castsi512_ps(_mm512_maskz_slli_epi32(MASK_ALL16, n, 23)));
+  }
+
+  __attribute__((target("avx512f")))
+  static inline __m512 Op16(__m512 x, int op)
+  {
+    const __m512 one = _mm512_set1_ps(1.0f);
+    switch(op) {
+      case OP_EXP:
+        return Exp16(x);
+      case OP_SIGMOID:
+        return _mm512_div_ps(one, _mm512_add_ps(one, Exp16(_mm512_sub_ps(_mm512_setzero_ps(), x))));
+      default: {
+        __m512 e = Exp16(_mm512_add_ps(x, x));
+        return _mm512_div_ps(_mm512_sub_ps(e, one), _mm512_add_ps(e, one));
+      }
+    }
+  }
+
+  __attribute__((target("avx512f")))
+  static void ApplyAvx512(const float* pIn, float* pOut, size_t n, int op)
+  {
+    size_t i = 0;
+    for( ; i+16 <= n; i += 16) {
+      _mm512_storeu_ps(pOut+i, Op16(_mm512_loadu_ps(pIn+i), op));
+    }
+    //masked tail
+    if(i < n) {
+      __mmask16 mask = static_cast<__mmask16>((1u << (n-i)) - 1);
+      __m512 x = _mm512_maskz_loadu_ps(mask, pIn+i);
+      _mm512_mask_storeu_ps(pOut+i, mask, Op16(x, op));
+    }
+  }
+
+#endif //TNET_SIMD_X86
+
+
+  //****************************************************************************
+  // Runtime dispatch
+  //****************************************************************************
+  typedef void (*ApplyFnc)(const float*, float*, size_t, int);
+
+  static ApplyFnc gApply = ApplyLibm;
+  static SimdLevel gLevel = SIMD_NONE;
+
+  SimdLevel SimdDetect()
+  {
+#ifdef TNET_SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SIMD_AVX2;
+    if(__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+#endif
+    return SIMD_NONE;
+  }
+
+  SimdLevel SimdGetLevel()
+  { return gLevel; }
+
+  void SimdSetLevel(SimdLevel level)
+  {
+    SimdLevel best = SimdDetect();
+    if(level > best) level = best;
+    switch(level) {
+#ifdef TNET_SIMD_X86
+      case SIMD_AVX512: gApply = ApplyAvx512; break;
+      case SIMD_AVX2:   gApply = ApplyAvx2;   break;
+      case SIMD_SSE2:   gApply = ApplySse2;   break;
+#endif
+      default:          gApply = ApplyLibm;   level = SIMD_NONE;
+    }
+    gLevel = level;
+  }
+
+  const char* SimdName(SimdLevel level)
+  {
+    switch(level) {
+      case SIMD_AVX512: return "AVX-512";
+      case SIMD_AVX2:   return "AVX2";
+      case SIMD_SSE2:   return "SSE2";
+      default:          return "none";
+    }
+  }
+
+  /// Selects the best kernels when the library is loaded
+  static struct SimdInit {
+    SimdInit() { SimdSetLevel(SimdDetect()); }
+  } gSimdInit;
+
+
+  //****************************************************************************
+  // Interface
+  //****************************************************************************
+  void VecExp(const float* pIn, float* pOut, size_t n)
+  { gApply(pIn, pOut, n, OP_EXP); }
+
+  void VecSigmoid(const float* pIn, float* pOut, size_t n)
+  { gApply(pIn, pOut, n, OP_SIGMOID); }
+
+  void VecTanh(const float* pIn, float* pOut, size_t n)
+  { gApply(pIn, pOut, n, OP_TANH); }
+
+  void VecExp(const double* pIn, double* pOut, size_t n)
+  {
+    for(size_t i=0; i<n; i++) pOut[i] = exp(pIn[i]);
+  }
+
+  void VecSigmoid(const double* pIn, double* pOut, size_t n)
+  {
+    for(size_t i=0; i<n; i++) pOut[i] = 1.0/(1.0+exp(-pIn[i]));
+  }
+
+  void VecTanh(const double* pIn, double* pOut, size_t n)
+  {
+    for(size_t i=0; i<n; i++) {
+      double exp2x = exp(2.0*pIn[i]);
+      pOut[i] = (std::isinf(exp2x) ? 1.0 : (exp2x-1.0)/(exp2x+1.0));
+    }
+  }
+
+} //namespace TNet
+
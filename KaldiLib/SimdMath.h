@@ -0,0 +1,46 @@
+#ifndef TNet_SimdMath_h
+#define TNet_SimdMath_h
+
+#include <cstddef>
+
+namespace TNet {
+
+  /**
+   * Element-wise exp/sigmoid/tanh on float arrays,
+   * vectorized by SSE2/AVX2/AVX-512 kernels selected at runtime by CPUID.
+   *
+   * The kernels use a polynomial exp (relative error ~2e-7),
+   * the input of exp is saturated to [-88,88] (no inf, no denormals).
+   * SIMD_NONE and the double versions evaluate the expressions of the
+   * original scalar code by libm, giving the same results bit by bit.
+   */
+  typedef enum {
+    SIMD_NONE = 0,  ///< scalar libm code
+    SIMD_SSE2,
+    SIMD_AVX2,      ///< AVX2 + FMA
+    SIMD_AVX512     ///< AVX-512F
+  } SimdLevel;
+
+  /// Best level supported by the CPU and the compiler
+  SimdLevel SimdDetect();
+  /// Level of the kernels in use
+  SimdLevel SimdGetLevel();
+  /// Select the kernels (not above SimdDetect()), call before starting threads
+  void SimdSetLevel(SimdLevel level);
+  /// Name of the level for logging
+  const char* SimdName(SimdLevel level);
+
+  /// pOut[i] = exp(pIn[i]), in-place allowed
+  void VecExp(const float* pIn, float* pOut, size_t n);
+  /// pOut[i] = 1/(1+exp(-pIn[i])), in-place allowed
+  void VecSigmoid(const float* pIn, float* pOut, size_t n);
+  /// pOut[i] = tanh(pIn[i]), in-place allowed
+  void VecTanh(const float* pIn, float* pOut, size_t n);
+
+  void VecExp(const double* pIn, double* pOut, size_t n);
+  void VecSigmoid(const double* pIn, double* pOut, size_t n);
+  void VecTanh(const double* pIn, double* pOut, size_t n);
+
+} //namespace TNet
+
+#endif
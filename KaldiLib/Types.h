@@ -23,6 +23,7 @@ namespace TNet
   typedef unsigned        UINT_32   ;
   typedef short           INT_16    ;
   typedef int             INT_32    ;
+  typedef long long       INT_64    ;
   typedef float           FLOAT_32  ;
   typedef double          DOUBLE_64 ;
 #endif
@@ -17,10 +17,20 @@ extern "C"{
 #include "Common.h"
 #include "Matrix.h"
 #include "Vector.h"
+#include "SimdMath.h"
 
 namespace TNet
 {
 
+  template<>
+     Vector<float>&
+    Vector<float>::
+    ApplyExp()
+    {
+      VecExp(mpData, mpData, mDim);
+      return *this;
+    }
+
 #ifdef HAVE_BLAS
   template<>
      float
@@ -479,6 +479,34 @@ namespace TNet
     }
 
 
+    /**
+     * Use a binary vector record of a MemoryIstream in place,
+     * returns a read-only view of the mapped data, or NULL (nothing read)
+     * if the data are not a record of the same type aligned in memory
+     */
+    template <typename _ElemT>
+    const SubVector<_ElemT>* MapVector(std::istream& rIn)
+    {
+      rIn >> std::ws;
+      size_t avail = 0;
+      const char* p_rec = MappedPosition(rIn, avail);
+      const size_t header = 6;
+      if(NULL == p_rec || avail < header || IsBigEndian() ||
+         p_rec[0] != 'V' || p_rec[1] != BinaryTypeCode<_ElemT>()) {
+        return NULL;
+      }
+      int dim;
+      memcpy(&dim, p_rec+2, sizeof(int));
+      const char* p_data = p_rec + header;
+      if(dim <= 0 || ((size_t)p_data) % 16 != 0) return NULL;
+      if(avail < header + dim*sizeof(_ElemT)) {
+        throw std::runtime_error("Failed to map vector: truncated data");
+      }
+      rIn.seekg(header + dim*sizeof(_ElemT), std::ios::cur);
+      return new SubVector<_ElemT>(reinterpret_cast<_ElemT*>(const_cast<char*>(p_data)), dim);
+    }
+
+
 } // namespace TNet
 
 //*****************************************************************************
@@ -389,6 +389,12 @@ namespace TNet
       return *this;
     }
 
+  //vectorized version (SimdMath.h)
+  template<>
+    Vector<float>&
+    Vector<float>::
+    ApplyExp();
+
   //****************************************************************************
   //****************************************************************************
   template<typename _ElemT>
@@ -528,6 +534,21 @@ namespace TNet
      operator >> (std::istream& rIn, Vector<_ElemT>& rV)
     {
       rIn >> std::ws;
+      if(rIn.peek() == 'V'){ // binary record
+        rIn.get();
+        char type;
+        size_t dim;
+        ReadBinaryHeader(rIn, type, dim, NULL);
+        bool accumulate = MatrixVectorIostreamControl::Flags(rIn, ACCUMULATE_INPUT);
+        if(rV.Dim() != dim) {
+          if(accumulate) { 
+            throw std::runtime_error("Failed to accumulate vector from stream: size mismatch"); 
+          }
+          rV.Init(dim);
+        }
+        ReadBinaryElems(rIn, type, rV.pData(), dim, accumulate);
+        return rIn;
+      }
       if(rIn.peek() == 'v'){ // "new" format: v <dim> 1.0 0.2 4.3 ...
         rIn.get();
         long long int tmp=-1; 
@@ -566,6 +587,11 @@ namespace TNet
     std::ostream &
     operator << (std::ostream& rOut, const Vector<_ElemT>& rV)
     {
+      if(MatrixVectorIostreamControl::Flags(rOut, BINARY_OUTPUT)) {
+        WriteBinaryHeader(rOut, 'V', BinaryTypeCode<_ElemT>(), rV.Dim(), 0);
+        WriteBinaryData(rOut, rV.pData(), sizeof(_ElemT), rV.Dim());
+        return rOut;
+      }
       rOut << "v " << rV.Dim() << "  ";
       Save(rOut,rV);
       return rOut;
@@ -27,9 +27,15 @@
 #include "UserInterface.h"
 
 #include "Nnet.h"
+#include "FrameBatch.h"
+#include "Semaphore.h"
+#include "BlockingQueue.h"
+#include "Thread.h"
 
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <map>
 
 
 
@@ -61,7 +67,7 @@ void usage(const char* progname)
 " -T N       Set trace flags to N                            0\n"
 " -V         Print version information                       Off\n"
 "\n"
-"FEATURETRANSFORM GMMBYPASS LOGPOSTERIOR NATURALREADORDER PRINTCONFIG PRINTVERSION SCRIPT SOURCEMMF TARGETPARAMDIR TARGETPARAMEXT TRACE\n"
+"BATCHFRAMES BLOCKSIZE BLOCKTHREADS FEATURETRANSFORM GMMBYPASS LOGPOSTERIOR MAPFEATURES NATURALREADORDER PRINTCONFIG PRINTVERSION SCRIPT SOURCEMMF TARGETPARAMDIR TARGETPARAMEXT THREADS TRACE\n"
 "\n"
 "STARTFRMEXT ENDFRMEXT CMEANDIR CMEANMASK VARSCALEDIR VARSCALEMASK VARSCALEFN TARGETKIND DERIVWINDOWS DELTAWINDOW ACCWINDOW THIRDWINDOW\n"
 "\n"
@@ -74,6 +80,231 @@ void usage(const char* progname)
 
 
 
+///////////////////////////////////////////////////////////////////////
+// FORWARD PASS
+//
+
+/// Options of the forward pass and the output post-processing
+struct ForwardOptions {
+  size_t start_frm_ext;
+  size_t end_frm_ext;
+  size_t batch_frames; ///< pack utterances to at most this many input frames, as FrameBatch::Fits (0 = off)
+  size_t block_size;   ///< blocks of the long utterances (Network::SetFeedforward)
+  int block_threads;   ///< threads forwarding the blocks of an utterance
+  bool gmm_bypass;
+  bool log_posterior;
+};
+
+
+/// Post-process the network output (the context is already trimmed)
+void PostProcess(const ForwardOptions& opts, Matrix<BaseFloat>& feats_out)
+{
+  //GMM bypass for HVite using posteriors as features
+  if(opts.gmm_bypass) {
+    for(size_t i=0; i<feats_out.Rows(); i++) {
+      for(size_t j=0; j<feats_out.Cols(); j++) {
+        feats_out(i,j) = static_cast<BaseFloat>(sqrt(-2.0*log(feats_out(i,j))));
+      }
+    }
+  }
+
+  //Convert posteriors to logdomain
+  if(opts.log_posterior) {
+    for(size_t i=0; i<feats_out.Rows(); i++) {
+      for(size_t j=0; j<feats_out.Cols(); j++) {
+        feats_out(i,j) = static_cast<BaseFloat>(log(feats_out(i,j)));
+      }
+    }
+  }
+}
+
+
+/// Forward one utterance through the networks, trim the context 
+/// and post-process the output, nnet_out is a scratch buffer
+void ForwardUtterance(Network& transform_network, Network& network, 
+                      const ForwardOptions& opts,
+                      const Matrix<BaseFloat>& feats_in, 
+                      Matrix<BaseFloat>& feats_out, Matrix<BaseFloat>& nnet_out)
+{
+  //pass through transform network
+  //transform_network.Propagate(feats_in, feats_out);
+  transform_network.Feedforward(feats_in, feats_out, opts.start_frm_ext, opts.end_frm_ext);
+
+  //pass through network
+  //network.Propagate(feats_out,nnet_out);
+  network.Feedforward(feats_out,nnet_out,opts.start_frm_ext,opts.end_frm_ext);
+
+  //get the ouput, trim the start/end context
+  feats_out.Init(nnet_out.Rows()-opts.start_frm_ext-opts.end_frm_ext,nnet_out.Cols());
+  memcpy(feats_out.pData(),nnet_out.pRowData(opts.start_frm_ext),feats_out.MSize());
+
+  PostProcess(opts, feats_out);
+}
+
+
+struct UtteranceBatch;
+
+/// Utterance with its input and output
+struct Utterance {
+  size_t index;            ///< order in the list, the output is written in this order
+  UtteranceBatch* batch;   ///< the batch of the utterance, freed with its last utterance
+  std::string logical;     ///< logical name, for the output file name
+  int sample_period;
+  Matrix<BaseFloat> feats; ///< input features (batching off)
+  Matrix<BaseFloat> out;   ///< network output
+};
+
+/// Utterances forwarded together
+struct UtteranceBatch {
+  UtteranceBatch(const ForwardOptions& opts)
+   : packed(opts.batch_frames, opts.start_frm_ext, opts.end_frm_ext), unwritten(0)
+  { }
+
+  std::vector<Utterance*> utts;
+  FrameBatch packed;       ///< input of the utterances (batching on)
+  size_t unwritten;        ///< utterances waiting for the writer
+};
+
+
+/// Forward the utterances, packed to one matrix when batching is on
+void ForwardBatch(Network& transform_network, Network& network, 
+                  const ForwardOptions& opts, UtteranceBatch& batch)
+{
+  if(opts.batch_frames == 0) {
+    Matrix<BaseFloat> nnet_out;
+    for(size_t i=0; i<batch.utts.size(); i++) {
+      Utterance& utt = *batch.utts[i];
+      ForwardUtterance(transform_network, network, opts, utt.feats, utt.out, nnet_out);
+      utt.feats.Destroy();
+    }
+  } else {
+    batch.packed.Forward(transform_network, network);
+    for(size_t i=0; i<batch.utts.size(); i++) {
+      batch.packed.GetOutput(i, batch.utts[i]->out);
+      PostProcess(opts, batch.utts[i]->out);
+    }
+    batch.packed.Clear();
+  }
+}
+
+
+/// Read the next utterances of the list to a batch, a single one 
+/// if batching is off. The batch takes the utterances while they fit 
+/// to BATCHFRAMES (FrameBatch::Fits, as in TNorm), the one which does 
+/// not fit is read ahead to rpNext, which starts the next batch.
+UtteranceBatch* ReadBatch(FeatureRepository& repo, const ForwardOptions& opts, 
+                          size_t& index, UtteranceBatch*& rpNext)
+{
+  UtteranceBatch* batch = (NULL != rpNext) ? rpNext : new UtteranceBatch(opts);
+  rpNext = NULL;
+  Matrix<BaseFloat> feats_buf;
+  while(!repo.EndOfList() && NULL == rpNext) {
+    Utterance* utt = new Utterance;
+    utt->index = index++;
+    utt->logical = repo.Current().Logical();
+    if(opts.batch_frames == 0) {
+      //the features wait in the pipeline, a view would not outlive the next read
+      repo.ReadFullMatrix(utt->feats);
+      utt->sample_period = repo.CurrentHeader().mSamplePeriod;
+      repo.MoveNext();
+      batch->utts.push_back(utt);
+      utt->batch = batch;
+      break;
+    }
+    //pack the features (a view over the mapped file if MAPFEATURES needs no conversion)
+    const Matrix<BaseFloat>& feats = repo.ReadFullMatrixView(feats_buf);
+    utt->sample_period = repo.CurrentHeader().mSamplePeriod;
+    repo.MoveNext();
+    UtteranceBatch* tgt = batch;
+    if(!batch->packed.Fits(feats)) {
+      tgt = rpNext = new UtteranceBatch(opts);
+    }
+    tgt->packed.Add(feats);
+    tgt->utts.push_back(utt);
+    utt->batch = tgt;
+  }
+  return batch;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////
+// PIPELINE (THREADS > 1)
+// reader thread -> forward threads -> writer (main thread)
+//
+
+/// Reads the features and queues them for the forward threads
+class ReaderThread : public Thread {
+ public:
+  ReaderThread(FeatureRepository& rRepo, const ForwardOptions& rOpts,
+               BlockingQueue<UtteranceBatch*>& rOut, 
+               Semaphore& rTickets, Semaphore& rDone)
+   : mRepo(rRepo), mOpts(rOpts), mOut(rOut), mTickets(rTickets), mDone(rDone)
+  { }
+
+ protected:
+  void Execute(void*) 
+  {
+    size_t index = 0;
+    UtteranceBatch* p_next = NULL;
+    mRepo.Rewind();
+    while(!mRepo.EndOfList() || NULL != p_next) {
+      //limit the number of batches in the pipeline
+      mTickets.Wait();
+      mOut.Push(ReadBatch(mRepo, mOpts, index, p_next));
+    }
+    mOut.Close();
+    mDone.Post();
+  }
+
+ private:
+  FeatureRepository& mRepo;
+  const ForwardOptions& mOpts;
+  BlockingQueue<UtteranceBatch*>& mOut;
+  Semaphore& mTickets;
+  Semaphore& mDone;
+};
+
+
+/// Forwards the batches through its own clones of the networks
+class ForwardThread : public Thread {
+ public:
+  ForwardThread(Network& rTransf, Network& rNnet, const ForwardOptions& rOpts,
+                BlockingQueue<UtteranceBatch*>& rIn, BlockingQueue<UtteranceBatch*>& rOut, 
+                Semaphore& rDone)
+   : mpTransf(rTransf.Clone()), mpNnet(rNnet.Clone()), mOpts(rOpts), 
+     mIn(rIn), mOut(rOut), mDone(rDone)
+  { 
+    //the clones run single-threaded, each gets its own block workers
+    mpTransf->SetFeedforward(rOpts.block_size, rOpts.block_threads);
+    mpNnet->SetFeedforward(rOpts.block_size, rOpts.block_threads);
+  }
+
+  ~ForwardThread()
+  { delete mpTransf; delete mpNnet; }
+
+ protected:
+  void Execute(void*) 
+  {
+    UtteranceBatch* batch;
+    while(mIn.Pop(batch)) {
+      ForwardBatch(*mpTransf, *mpNnet, mOpts, *batch);
+      mOut.Push(batch);
+    }
+    mDone.Post();
+  }
+
+ private:
+  Network* mpTransf;
+  Network* mpNnet;
+  const ForwardOptions& mOpts;
+  BlockingQueue<UtteranceBatch*>& mIn;
+  BlockingQueue<UtteranceBatch*>& mOut;
+  Semaphore& mDone;
+};
+
+
+
 
 ///////////////////////////////////////////////////////////////////////
 // MAIN FUNCTION
@@ -109,12 +340,13 @@ int main(int argc, char *argv[]) try
   const char*                       p_source_mmf_file;
   const char*                       p_input_transform;
 
-  bool                              gmm_bypass;
-  bool                              log_posterior;
+  ForwardOptions                    opts;
+  int                               num_threads;
   int                               trace;
 
   // variables for feature repository
   bool                              swap_features;
+  bool                              map_features;
   int                               target_kind;
   int                               deriv_order;
   int*                              p_deriv_win_lenghts;
@@ -137,6 +369,7 @@ int main(int argc, char *argv[]) try
   // OPTION RETRIEVAL ........................................................
   // extract the feature parameters
   swap_features = !ui.GetBool(SNAME":NATURALREADORDER", TNet::IsBigEndian());
+  map_features  = ui.GetBool(SNAME":MAPFEATURES", false);
   
   target_kind = ui.GetFeatureParams(&deriv_order, &p_deriv_win_lenghts,
        &start_frm_ext, &end_frm_ext, &cmn_path, &cmn_file, &cmn_mask,
@@ -151,8 +384,16 @@ int main(int argc, char *argv[]) try
   p_target_fea_dir    = ui.GetStr(SNAME":TARGETPARAMDIR", NULL);
   p_target_fea_ext    = ui.GetStr(SNAME":TARGETPARAMEXT", NULL);
   
-  gmm_bypass          = ui.GetBool(SNAME":GMMBYPASS",     false);
-  log_posterior       = ui.GetBool(SNAME":LOGPOSTERIOR",  false);
+  opts.gmm_bypass     = ui.GetBool(SNAME":GMMBYPASS",     false);
+  opts.log_posterior  = ui.GetBool(SNAME":LOGPOSTERIOR",  false);
+  opts.start_frm_ext  = start_frm_ext;
+  opts.end_frm_ext    = end_frm_ext;
+
+  opts.batch_frames   = static_cast<int>(ui.GetInt(SNAME":BATCHFRAMES", 0));
+
+  num_threads         = static_cast<int>(ui.GetInt(SNAME":THREADS", 1));
+  opts.block_size     = static_cast<size_t>(ui.GetInt(SNAME":BLOCKSIZE", 1024));
+  opts.block_threads  = static_cast<int>(ui.GetInt(SNAME":BLOCKTHREADS", 1));
    
   trace               = ui.GetInt(SNAME":TRACE",          00);
 
@@ -181,23 +422,36 @@ int main(int argc, char *argv[]) try
   //read the input transform network
   if(NULL != p_input_transform) { 
     if(trace&1) KALDI_LOG << "Reading input transform network: " << p_input_transform;
-    transform_network.ReadNetwork(p_input_transform);
+    transform_network.MapNetwork(p_input_transform);
   }
 
   //read the neural network
   if(NULL != p_source_mmf_file) { 
     if(trace&1) KALDI_LOG << "Reading network: " << p_source_mmf_file;
-    network.ReadNetwork(p_source_mmf_file);
+    network.MapNetwork(p_source_mmf_file);
   } else {
     KALDI_ERR << "Source MMF must be specified [-H]";
   }
 
+  //blocks of the long utterances, possibly forwarded in parallel,
+  //with THREADS > 1 by the workers of each forward thread (ForwardThread)
+  int block_threads = (num_threads > 1 ? 1 : opts.block_threads);
+  transform_network.SetFeedforward(opts.block_size, block_threads);
+  network.SetFeedforward(opts.block_size, block_threads);
+
   //initialize the FeatureRepository
   feature_repo.Init(
     swap_features, start_frm_ext, end_frm_ext, target_kind,
     deriv_order, p_deriv_win_lenghts, 
     cmn_path, cmn_mask, cvn_path, cvn_mask, cvg_file
   );
+  feature_repo.MapFeatures(map_features);
+  //the mapped frames are used in place only as they are stored: in the
+  //byte order of the CPU (NATURALREADORDER), not normalized, not padded
+  if(map_features && (swap_features || cmn_path || cvn_path || cvg_file)) {
+    KALDI_WARN << "MAPFEATURES copies the features anyway without NATURALREADORDER "
+               << "or with CMN, CVN or CVG";
+  }
   if(NULL != p_script) {
     feature_repo.AddFileList(p_script);
   } 
@@ -216,54 +470,106 @@ int main(int argc, char *argv[]) try
   if(step == 0) step = 1;
   tim.Start();
 
-  //data carriers
-  Matrix<BaseFloat> feats_in,feats_out,nnet_out;
-  //process all the feature files
-  for(feature_repo.Rewind(); !feature_repo.EndOfList(); feature_repo.MoveNext()) {
-    //read file
-    feature_repo.ReadFullMatrix(feats_in);
-
-    //pass through transform network
-    //transform_network.Propagate(feats_in, feats_out);
-    transform_network.Feedforward(feats_in, feats_out, start_frm_ext, end_frm_ext);
-
-    //pass through network
-    //network.Propagate(feats_out,nnet_out);
-    network.Feedforward(feats_out,nnet_out,start_frm_ext,end_frm_ext);
+  //the batches in the pipeline (queued, forwarded or waiting for their turn),
+  //the ticket of a batch returns when all its utterances were written
+  Semaphore tickets(4*num_threads);
+  BlockingQueue<UtteranceBatch*> fea_queue(2*num_threads);
+  BlockingQueue<UtteranceBatch*> out_queue(4*num_threads);
+  Semaphore reader_done, forward_done;
+  ReaderThread* reader = NULL;
+  std::vector<ForwardThread*> forward;
+  
+  if(num_threads > 1) {
+    //start the threads
+    for(int i=0; i<num_threads; i++) {
+      forward.push_back(new ForwardThread(transform_network, network, opts, 
+                                          fea_queue, out_queue, forward_done));
+      forward.back()->Start(NULL);
+    }
+    reader = new ReaderThread(feature_repo, opts, fea_queue, tickets, reader_done);
+    reader->Start(NULL);
+  }
 
-    //get the ouput, trim the start/end context
-    feats_out.Init(nnet_out.Rows()-start_frm_ext-end_frm_ext,nnet_out.Cols());
-    memcpy(feats_out.pData(),nnet_out.pRowData(start_frm_ext),feats_out.MSize());
-   
-    //GMM bypass for HVite using posteriors as features
-    if(gmm_bypass) {
-      for(size_t i=0; i<feats_out.Rows(); i++) {
-        for(size_t j=0; j<feats_out.Cols(); j++) {
-          feats_out(i,j) = static_cast<BaseFloat>(sqrt(-2.0*log(feats_out(i,j))));
-        }
+  if(num_threads == 1 && opts.batch_frames == 0) {
+    //one utterance at a time, the features are a view over the mapped file
+    //if MAPFEATURES needs no conversion (see ReadFullMatrixView)
+    Matrix<BaseFloat> feats_buf,feats_out,nnet_out;
+    for(feature_repo.Rewind(); !feature_repo.EndOfList(); feature_repo.MoveNext()) {
+      const Matrix<BaseFloat>& feats_in = feature_repo.ReadFullMatrixView(feats_buf);
+      ForwardUtterance(transform_network, network, opts, feats_in, feats_out, nnet_out);
+
+      //build filename
+      MakeHtkFileName(p_target_fea, 
+                      feature_repo.Current().Logical().c_str(),
+                      p_target_fea_dir, p_target_fea_ext);
+      //save output   
+      int sample_period = feature_repo.CurrentHeader().mSamplePeriod;
+      feature_repo.WriteFeatureMatrix(feats_out,p_target_fea,PARAMKIND_USER,sample_period);
+      if(trace&2) KALDI_COUT << "Written: " << p_target_fea << "\n";
+    
+      //progress
+      if(trace&1) {
+        if((cnt++ % step) == 0) KALDI_COUT << 100 * cnt / feature_repo.QueueSize() << "%, " << std::flush;
       }
     }
-  
-    //Convert posteriors to logdomain
-    if(log_posterior) {
-      for(size_t i=0; i<feats_out.Rows(); i++) {
-        for(size_t j=0; j<feats_out.Cols(); j++) {
-          feats_out(i,j) = static_cast<BaseFloat>(log(feats_out(i,j)));
+  } else {
+    //write the outputs in the order of the list
+    std::map<size_t,Utterance*> waiting;
+    size_t next = 0, index = 0;
+    UtteranceBatch* p_next = NULL;
+    if(num_threads == 1) {
+      feature_repo.Rewind();
+    }
+    while(next < (size_t)feature_repo.QueueSize()) {
+      UtteranceBatch* batch;
+      if(num_threads > 1) {
+        if(!out_queue.Pop(batch)) break;
+      } else {
+        //read and forward the batch in this thread
+        batch = ReadBatch(feature_repo, opts, index, p_next);
+        ForwardBatch(transform_network, network, opts, *batch);
+      }
+      batch->unwritten = batch->utts.size();
+      for(size_t i=0; i<batch->utts.size(); i++) {
+        waiting[batch->utts[i]->index] = batch->utts[i];
+      }
+
+      std::map<size_t,Utterance*>::iterator it;
+      while((it = waiting.find(next)) != waiting.end()) {
+        Utterance* utt = it->second;
+        waiting.erase(it);
+        //build filename
+        MakeHtkFileName(p_target_fea, utt->logical.c_str(), 
+                        p_target_fea_dir, p_target_fea_ext);
+        //save output   
+        feature_repo.WriteFeatureMatrix(utt->out,p_target_fea,PARAMKIND_USER,utt->sample_period);
+        if(trace&2) KALDI_COUT << "Written: " << p_target_fea << "\n";
+        UtteranceBatch* written = utt->batch;
+        delete utt;
+        next++;
+        //the last utterance of the batch returns its ticket
+        if(--written->unwritten == 0) {
+          delete written;
+          if(num_threads > 1) tickets.Post();
+        }
+    
+        //progress
+        if(trace&1) {
+          if((cnt++ % step) == 0) KALDI_COUT << 100 * cnt / feature_repo.QueueSize() << "%, " << std::flush;
         }
       }
     }
+  }
 
-    //build filename
-    MakeHtkFileName(p_target_fea, 
-                    feature_repo.Current().Logical().c_str(),
-                    p_target_fea_dir, p_target_fea_ext);
-    //save output   
-    int sample_period = feature_repo.CurrentHeader().mSamplePeriod;
-    feature_repo.WriteFeatureMatrix(feats_out,p_target_fea,PARAMKIND_USER,sample_period);
-    
-    //progress
-    if(trace&1) {
-      if((cnt++ % step) == 0) KALDI_COUT << 100 * cnt / feature_repo.QueueSize() << "%, " << std::flush;
+  //wait for the threads to finish
+  if(num_threads > 1) {
+    reader_done.Wait();
+    for(int i=0; i<num_threads; i++) {
+      forward_done.Wait();
+    }
+    delete reader;
+    for(int i=0; i<num_threads; i++) {
+      delete forward[i];
     }
   }
   
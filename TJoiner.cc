@@ -71,7 +71,7 @@ void usage(const char* progname)
 " -T N       Set trace flags to N                            0\n" 
 " -V         Print version information                       Off\n"
 "\n"
-"NATURALREADORDER OUTPUTSCRIPT PRINTCONFIG PRINTVERSION SCRIPT TARGETPARAMDIR TARGETPARAMEXT TARGETSIZE TRACE\n"
+"ARCHIVE HALFPRECISION NATURALREADORDER OUTPUTSCRIPT PRINTCONFIG PRINTVERSION SCRIPT TARGETPARAMDIR TARGETPARAMEXT TARGETSIZE TRACE\n"
 "\n"
 "STARTFRMEXT ENDFRMEXT CMEANDIR CMEANMASK VARSCALEDIR VARSCALEMASK VARSCALEFN TARGETKIND DERIVWINDOWS DELTAWINDOW ACCWINDOW THIRDWINDOW\n"
 "\n"
@@ -122,6 +122,8 @@ int main(int argc, char *argv[]) try
   int                               trace;
   int                               target_size;
   bool                              dir_strip;
+  bool                              archive;
+  bool                              half_precision;
 
   // variables for feature repository
   bool                              swap_features;
@@ -162,6 +164,8 @@ int main(int argc, char *argv[]) try
   trace               = ui.GetInt(SNAME":TRACE",          00);
   target_size         = ui.GetInt(SNAME":TARGETSIZE",   20000);
   dir_strip           = ui.GetBool(SNAME":DIRSTRIP", true);
+  archive             = ui.GetBool(SNAME":ARCHIVE", false);
+  half_precision      = ui.GetBool(SNAME":HALFPRECISION", false);
 
   // process the parameters
   if(ui.GetBool(SNAME":PRINTCONFIG", false)) {
@@ -229,6 +233,10 @@ int main(int argc, char *argv[]) try
   std::string file_out;
   file_out = std::string(p_tgt_param_dir) + "/" + int2str(file_out_ctr) + "." + p_tgt_param_ext;
 
+  //packed archive output, TARGETSIZE frames per archive
+  FeatureArchiveWriter archive_out;
+  int frames_out = 0;
+
   features.Rewind();
   for( ; !features.EndOfList(); features.MoveNext(), cnt++) {
     //read the features
@@ -248,6 +256,36 @@ int main(int argc, char *argv[]) try
       continue;
     }
 
+    //store the utterance as an archive entry
+    if(archive) {
+      //strip directory from logical filename
+      std::string name_logical(features.Current().Logical());
+      size_t str_pos;
+      if(dir_strip && (str_pos = name_logical.rfind("/")) != std::string::npos) {
+        name_logical.erase(0,str_pos+1);
+      }
+      if(!archive_out.IsOpen()) {
+        archive_out.Open(file_out, half_precision);
+      }
+      size_t entry = archive_out.Write(name_logical, mat_in, 
+                                       features.CurrentHeader().mSampleKind,
+                                       features.CurrentHeader().mSamplePeriod);
+      //add scriptfile record
+      out_scp << name_logical << "=" << file_out << "#" << entry << "[" << start_frm_ext << "," << mat_in.Rows()-end_frm_ext-1 << "]\n";
+
+      //start a new archive
+      frames_out += static_cast<int>(mat_in.Rows());
+      if(frames_out >= target_size) {
+        archive_out.Close();
+        file_out_ctr++;
+        file_out = std::string(p_tgt_param_dir) + "/" + int2str(file_out_ctr) + "." + p_tgt_param_ext;
+        frames_out = 0;
+      }
+
+      if((cnt % step) == 0) KALDI_COUT << 100 * cnt / features.QueueSize() << "%, " << std::flush;
+      continue;
+    }
+
     //lazy buffer init
     if(mat_buffer.Rows() == 0) {
       dim = mat_in.Cols();
@@ -310,6 +348,11 @@ int main(int argc, char *argv[]) try
     if((cnt % step) == 0) KALDI_COUT << 100 * cnt / features.QueueSize() << "%, " << std::flush;
   }
 
+  //finish the last archive
+  if(archive_out.IsOpen()) {
+    archive_out.Close();
+  }
+
   //store the content of the buffer
   if(pos_buf > 0) {
     mat_out.Init(pos_buf-1,dim); //don't store separator! => -1
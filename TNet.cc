@@ -60,6 +60,7 @@ void usage(const char* progname)
 " -n f       Set learning rate to f                          0.06\n"
 " -o ext     Set target model ext                            None\n"
 " -A         Print command line arguments                    Off\n" 
+" -B         Save NN macro files in binary format            Off\n"
 " -C cf      Set config file to cf                           Default\n"
 " -D         Display configuration variables                 Off\n"
 " -H mmf     Load NN macro file                              \n"
@@ -72,7 +73,7 @@ void usage(const char* progname)
 " -V         Print version information                       Off\n"
 " -X ext     Set input label file ext                        lab\n"
 "\n"
-"BUNCHSIZE CACHESIZE CONFUSIONMODE[no,max,soft,dmax,dsoft] CROSSVALIDATE FEATURETRANSFORM LEARNINGRATE LEARNRATEFACTORS MLFTRANSC MOMENTUM NATURALREADORDER OBJECTIVEFUNCTION[mse,xent] OUTPUTLABELMAP PRINTCONFIG PRINTVERSION RANDOMIZE SCRIPT SEED SOURCEMLF SOURCEMMF SOURCETRANSCDIR SOURCETRANSCEXT TARGETMMF TARGETMODELDIR TARGETMODELEXT TRACE WEIGHTCOST\n"
+"AVERAGEBUNCHES BUNCHSIZE CACHEDATA CACHESIZE CONFUSIONMODE[no,max,soft,dmax,dsoft] CROSSVALIDATE CVSCRIPT ENDHALVING EPOCHS FEATURETRANSFORM FLOATACCU HALVINGFACTOR LEARNINGRATE LEARNRATEFACTORS MAPFEATURES MAXSTALENESS MLFTRANSC MOMENTUM NATURALREADORDER NESTEROV OBJECTIVEFUNCTION[mse,xent] OUTPUTLABELMAP PARALLELMODE[sync,async,average] PRINTCONFIG PRINTVERSION QUEUESIZE RANDOMIZE READTHREADS SAVEBINARY SCRIPT SEED SHUFFLEFILES SOURCEMLF SOURCEMMF SOURCETRANSCDIR SOURCETRANSCEXT SPARSETARGETS STARTHALVING TARGETMMF TARGETMODELDIR TARGETMODELEXT THREADPLACEMENT[none,compact,scatter,cpulist] TRACE WEIGHTCOST WORKERRANK WORKERS WORKERSOCKET\n"
 "\n"
 "STARTFRMEXT ENDFRMEXT CMEANDIR CMEANMASK VARSCALEDIR VARSCALEMASK VARSCALEFN TARGETKIND DERIVWINDOWS DELTAWINDOW ACCWINDOW THIRDWINDOW\n"
 "\n"
@@ -84,6 +85,32 @@ void usage(const char* progname)
 }
 
 
+/// Cross-validate the weights of rNnet, print the report of the epoch
+/// and return the loss per frame; of several training processes
+/// the process 0 cross-validates and sends the loss to the others,
+/// so that all the processes accept or reject the epoch alike
+static double CrossValidate(Platform& rPlCv, Network& rNnet, ObjectiveFunction* pObjFun,
+                            int threads, RingAllreduce* pWorkers, const char* pCvScript, int epoch)
+{
+  Vector<double> loss(1);
+  if(NULL == pWorkers || pWorkers->Rank() == 0) {
+    rPlCv.obj_fun_ = pObjFun->Clone();
+    rPlCv.nnet_.CopyWeights(rNnet);
+    rPlCv.RunTrain(threads);
+    if(rPlCv.obj_fun_->GetFrames() == 0) {
+      KALDI_ERR << "No cross-validation frames in: " << pCvScript;
+    }
+    loss[0] = rPlCv.obj_fun_->GetError() / static_cast<double>(rPlCv.obj_fun_->GetFrames());
+    KALDI_COUT << "EPOCH " << epoch << " CV " << rPlCv.obj_fun_->Report();
+    delete rPlCv.obj_fun_;
+    rPlCv.obj_fun_ = NULL;
+  }
+  //the others add zero
+  if(NULL != pWorkers) pWorkers->Sum(loss);
+  return loss[0];
+}
+
+
 
 ///////////////////////////////////////////////////////////////////////
 // MAIN FUNCTION
@@ -119,6 +146,7 @@ int main(int argc, char *argv[])
   try {
     UserInterface        ui;
     Platform             pl;
+    Platform             pl_cv; //< cross-validation after the epochs
     Timer                timer;
 
    
@@ -127,6 +155,9 @@ int main(int argc, char *argv[])
     BaseFloat                         learning_rate;
     const char*                       learning_rate_factors;
     BaseFloat                         weightcost;
+    BaseFloat                         momentum;
+    bool                              nesterov;
+    bool                              float_accu;
     ObjectiveFunction::ObjFunType     obj_fun_id;
     CrossEntropy::ConfusionMode       xent_conf_mode;
 
@@ -151,10 +182,29 @@ int main(int argc, char *argv[])
     int                               trace;
     bool                              crossval;
     int                               num_threads;
+    int                               num_read_threads;
+    const char*                       p_thread_placement;
+    bool                              shuffle_files;
+    int                               queue_size;
+    bool                              sparse_targets;
+    bool                              save_binary;
+    Platform::ParallelMode            parallel_mode;
+    int                               max_staleness;
+    int                               average_bunches;
+    int                               num_workers;
+    int                               worker_rank;
+    const char*                       p_worker_socket;
+    int                               num_epochs;
+    const char*                       p_cv_script;
+    BaseFloat                         halving_factor;
+    BaseFloat                         start_halving;
+    BaseFloat                         end_halving;
+    bool                              cache_data;
 
 
     // variables for feature repository
     bool                              swap_features;
+    bool                              map_features;
     int                               target_kind;
     int                               deriv_order;
     int*                              p_deriv_win_lenghts;
@@ -178,6 +228,7 @@ int main(int argc, char *argv[])
     // OPTION RETRIEVAL ........................................................
     // extract the feature parameters
     swap_features = !ui.GetBool(SNAME":NATURALREADORDER", TNet::IsBigEndian());
+    map_features  = ui.GetBool(SNAME":MAPFEATURES", false);
     
     target_kind = ui.GetFeatureParams(&deriv_order, &p_deriv_win_lenghts,
          &start_frm_ext, &end_frm_ext, &cmn_path, &cmn_file, &cmn_mask,
@@ -197,6 +248,9 @@ int main(int argc, char *argv[])
     learning_rate       = ui.GetFlt(SNAME":LEARNINGRATE"  , 0.06f);
     learning_rate_factors = ui.GetStr(SNAME":LEARNRATEFACTORS", NULL);
     weightcost          = ui.GetFlt(SNAME":WEIGHTCOST"    , 0.0);
+    momentum            = ui.GetFlt(SNAME":MOMENTUM"      , 0.0);
+    nesterov            = ui.GetBool(SNAME":NESTEROV"     , false);
+    float_accu          = ui.GetBool(SNAME":FLOATACCU"    , false);
 
     obj_fun_id          = static_cast<ObjectiveFunction::ObjFunType>(
                           ui.GetEnum(SNAME":OBJECTIVEFUNCTION", 
@@ -230,8 +284,34 @@ int main(int argc, char *argv[])
     //Fill the global variables of the singleton 'Gl'
     trace               = ui.GetInt(SNAME":TRACE",               0);
     num_threads         = ui.GetInt(SNAME":THREADS",          1);
+    num_read_threads    = static_cast<int>(ui.GetInt(SNAME":READTHREADS", 1));
+    p_thread_placement  = ui.GetStr(SNAME":THREADPLACEMENT",  "none");
+    shuffle_files       = ui.GetBool(SNAME":SHUFFLEFILES",   false);
+    queue_size          = static_cast<int>(ui.GetInt(SNAME":QUEUESIZE", 50));
+    sparse_targets      = ui.GetBool(SNAME":SPARSETARGETS",  false);
+    save_binary         = ui.GetBool(SNAME":SAVEBINARY",     false);
     crossval            = ui.GetBool(SNAME":CROSSVALIDATE",  false);
 
+    parallel_mode       = static_cast<Platform::ParallelMode>(
+                          ui.GetEnum(SNAME":PARALLELMODE",
+                                     Platform::SYNC_MODE, //< default
+                                     "sync", Platform::SYNC_MODE,
+                                     "async", Platform::ASYNC_MODE,
+                                     "average", Platform::AVERAGE_MODE,
+                                     NULL
+                          ));
+    max_staleness       = static_cast<int>(ui.GetInt(SNAME":MAXSTALENESS", 4));
+    average_bunches     = static_cast<int>(ui.GetInt(SNAME":AVERAGEBUNCHES", 8));
+    num_workers         = static_cast<int>(ui.GetInt(SNAME":WORKERS", 1));
+    worker_rank         = static_cast<int>(ui.GetInt(SNAME":WORKERRANK", 0));
+    p_worker_socket     = ui.GetStr(SNAME":WORKERSOCKET",     NULL);
+    num_epochs          = static_cast<int>(ui.GetInt(SNAME":EPOCHS", 1));
+    p_cv_script         = ui.GetStr(SNAME":CVSCRIPT",         NULL);
+    halving_factor      = ui.GetFlt(SNAME":HALVINGFACTOR",    0.5f);
+    start_halving       = ui.GetFlt(SNAME":STARTHALVING",     0.01f);
+    end_halving         = ui.GetFlt(SNAME":ENDHALVING",       0.001f);
+    cache_data          = ui.GetBool(SNAME":CACHEDATA",      false);
+
 
     // process the parameters
     if(ui.GetBool(SNAME":PRINTCONFIG", false)) {
@@ -273,6 +353,7 @@ int main(int argc, char *argv[])
       cmn_path, cmn_mask, cvn_path, cvn_mask, cvg_file
     );
     pl.feature_.Trace(trace);
+    pl.feature_.MapFeatures(map_features);
     //open the scp file
     pl.feature_.AddFileList(p_script);
 
@@ -302,6 +383,24 @@ int main(int argc, char *argv[])
     }
     pl.nnet_.SetLearnRate(learning_rate, learning_rate_factors);
     pl.nnet_.SetWeightcost(weightcost);
+    if(momentum < 0.0 || momentum >= 1.0) {
+      KALDI_ERR << "MOMENTUM must be in [0,1): " << momentum;
+    }
+    if(momentum != 0.0 && parallel_mode != Platform::SYNC_MODE) {
+      KALDI_WARN << "MOMENTUM is used only by PARALLELMODE=sync";
+    }
+    pl.nnet_.SetMomentum(momentum, nesterov);
+    //the model averaging sums the weights in double precision
+#ifdef DOUBLEPRECISION
+    if(float_accu) {
+      KALDI_ERR << "FLOATACCU needs single-precision BaseFloat, this build uses -DDOUBLEPRECISION";
+    }
+#endif
+    if(float_accu && parallel_mode != Platform::SYNC_MODE) {
+      KALDI_WARN << "FLOATACCU is used only by PARALLELMODE=sync";
+      float_accu = false;
+    }
+    pl.nnet_.SetFloatAccu(float_accu);
 
     //get objective function instance
     pl.obj_fun_ = ObjectiveFunction::Factory(obj_fun_id);
@@ -312,6 +411,13 @@ int main(int argc, char *argv[])
       xent->SetConfusionMode(xent_conf_mode);
       //pass the outputlabelmap
       xent->SetOutputLabelMap(p_output_label_map);
+      //class ids instead of the one-hot desired matrix
+      xent->SetSparseTargets(sparse_targets);
+    }
+    if(sparse_targets) {
+      if(obj_fun_id != ObjectiveFunction::CROSS_ENTROPY || !pl.label_.IsReady()) {
+        KALDI_ERR << "SPARSETARGETS requires the cross-entropy objective and the MLF labels";
+      }
     }
 
     //initialize the cache
@@ -323,10 +429,77 @@ int main(int argc, char *argv[])
     pl.end_frm_ext_ = end_frm_ext;
     pl.trace_ = trace;
     pl.crossval_ = crossval;
+    //
+    pl.read_threads_ = num_read_threads;
+    pl.placement_.Init(p_thread_placement);
+    pl.shuffle_files_ = shuffle_files;
+    pl.queue_size_ = queue_size;
+    pl.sparse_targets_ = sparse_targets;
+    pl.parallel_mode_ = parallel_mode;
+    pl.max_staleness_ = max_staleness;
+    pl.average_bunches_ = average_bunches;
+    //several training processes average their models
+    if(num_workers > 1 && !crossval) {
+      if(parallel_mode != Platform::AVERAGE_MODE) {
+        KALDI_ERR << "WORKERS>1 requires PARALLELMODE=average";
+      }
+      //the sockets of concurrent jobs must not collide
+      if(NULL == p_worker_socket) {
+        KALDI_ERR << "WORKERS>1 requires WORKERSOCKET, a socket path prefix unique to the job";
+      }
+      pl.workers_ = new RingAllreduce(p_worker_socket, worker_rank, num_workers);
+    }
 
     //TODO do someting with seed!!!
     pl.seed_ = seed;
     //data_proxy.InitCache(cache_size, bunch_size, network, randomize, seed);
+
+    //several epochs in one run, the data can stay in RAM
+    if(num_epochs < 1) {
+      KALDI_ERR << "EPOCHS must be positive: " << num_epochs;
+    }
+    if(crossval && (num_epochs > 1 || NULL != p_cv_script)) {
+      KALDI_ERR << "EPOCHS and CVSCRIPT cannot be used with CROSSVALIDATE";
+    }
+    pl.cache_data_ = cache_data && num_epochs > 1;
+
+    //the cross-validation platform, same setup as the training one
+    if(NULL != p_cv_script) {
+      pl_cv.feature_.Init(
+        swap_features, start_frm_ext, end_frm_ext, target_kind,
+        deriv_order, p_deriv_win_lenghts, 
+        cmn_path, cmn_mask, cvn_path, cvn_mask, cvg_file
+      );
+      pl_cv.feature_.Trace(trace);
+      pl_cv.feature_.MapFeatures(map_features);
+      pl_cv.feature_.AddFileList(p_cv_script);
+      if(pl.label_.IsReady()) {
+        pl_cv.label_.Init(p_source_mlf_file,p_output_label_map, p_src_lbl_dir, p_src_lbl_ext);
+        pl_cv.label_.Trace(trace);
+      }
+      if(NULL != p_input_transform) {
+        pl_cv.nnet_transf_.ReadNetwork(p_input_transform);
+      }
+      //own weights, CopyWeights() from pl.nnet_ before each cross-validation
+      pl_cv.nnet_.ReadNetwork(p_source_mmf_file);
+      pl_cv.bunchsize_ = bunch_size;
+      pl_cv.cachesize_ = cache_size;
+      //the same frames in each cross-validation
+      pl_cv.randomize_ = false;
+      pl_cv.start_frm_ext_ = start_frm_ext;
+      pl_cv.end_frm_ext_ = end_frm_ext;
+      pl_cv.trace_ = trace;
+      pl_cv.crossval_ = true;
+      pl_cv.read_threads_ = num_read_threads;
+      pl_cv.placement_ = pl.placement_;
+      pl_cv.shuffle_files_ = false;
+      pl_cv.queue_size_ = queue_size;
+      pl_cv.sparse_targets_ = sparse_targets;
+      pl_cv.cache_data_ = cache_data;
+      pl_cv.seed_ = seed;
+    }
+    //the runs get clones with the fresh stats
+    ObjectiveFunction* obj_fun = pl.obj_fun_;
     
     timer.Start();
     KALDI_COUT << "===== TNET " 
@@ -337,41 +510,107 @@ int main(int argc, char *argv[])
     if(!crossval) {
       pl.nnet_.PrintLearnRate();
       KALDI_COUT << "weightcost: " << weightcost << std::endl;
+      KALDI_COUT << "momentum: " << momentum << (nesterov?" (nesterov)":"") << std::endl;
       KALDI_COUT << "using seed: " << seed << std::endl;
     }
+    if(num_epochs > 1) {
+      KALDI_COUT << "epochs: " << num_epochs 
+                 << (pl.cache_data_?" (data cached in RAM)":"") << std::endl;
+    }
+
+    //newbob: the epoch is rejected when the CV error does not decrease,
+    //the learning rate is halved since the relative improvement
+    //is below start_halving, the training stops when it is below end_halving
+    double cv_loss = 0.0;
+    bool halving = false;
+    Network* p_best = NULL;
+    if(NULL != p_cv_script) {
+      cv_loss = CrossValidate(pl_cv, pl.nnet_, obj_fun, num_threads, pl.workers_, p_cv_script, 0);
+      //the weights of the last accepted epoch
+      p_best = pl.nnet_.Clone();
+      p_best->DetachWeights();
+    }
+    size_t frames = 0;
+
+    for(int epoch=1; epoch<=num_epochs; epoch++) {
+      //each epoch shuffles differently
+      pl.seed_ = (seed == 0) ? 0 : seed + epoch - 1;
+      if(epoch > 1) delete pl.obj_fun_;
+      pl.obj_fun_ = obj_fun->Clone();
+
+      /*
+       * PERFORM ONE ITERATION OF THE TRAINING
+       */
+      pl.RunTrain(num_threads);
+      /*
+       *
+       */
+
+      frames += pl.obj_fun_->GetFrames();
+      if(num_epochs > 1 || NULL != p_cv_script) {
+        KALDI_COUT << "EPOCH " << epoch << " TR " << pl.obj_fun_->Report();
+      }
+      if(NULL == p_cv_script) continue;
 
+      //cross-validate the new weights
+      double loss = CrossValidate(pl_cv, pl.nnet_, obj_fun, num_threads, pl.workers_, p_cv_script, epoch);
 
-    /*
-     * PERFORM ONE ITERATION OF THE TRAINING
-     */
-    pl.RunTrain(num_threads);
-    /*
-     *
-     */
+      //accept or roll back
+      double loss_prev = cv_loss;
+      if(loss < cv_loss) {
+        cv_loss = loss;
+        p_best->CopyWeights(pl.nnet_);
+        KALDI_COUT << "EPOCH " << epoch << " accepted (" << loss << ")" << std::endl;
+      } else {
+        pl.nnet_.CopyWeights(*p_best);
+        //the velocity belongs to the rejected weights
+        pl.nnet_.ResetMomentum();
+        KALDI_COUT << "EPOCH " << epoch << " rejected (" << loss << ")" << std::endl;
+      }
+
+      //learning rate schedule, a zero loss cannot improve
+      double rel_impr = (loss_prev > 0.0) ? (loss_prev - cv_loss) / loss_prev : 0.0;
+      if(halving && rel_impr < end_halving) {
+        KALDI_COUT << "Finished, too small improvement: " << rel_impr << std::endl;
+        break;
+      }
+      if(rel_impr < start_halving) {
+        halving = true;
+      }
+      if(halving) {
+        learning_rate *= halving_factor;
+        pl.nnet_.SetLearnRate(learning_rate, learning_rate_factors);
+        pl.nnet_.PrintLearnRate();
+      }
+    }
+    delete p_best;
 
 
     if(trace&1) KALDI_LOG << "Training finished";
     KALDI_COUT << "features with missing labels : " << pl.feats_with_missing_labels_ << "\n"; 
-    //write the network
-    if(!crossval) {
+    //write the network (the processes have the same one)
+    if(!crossval && (NULL == pl.workers_ || pl.workers_->Rank() == 0)) {
       if (NULL != p_targetmmf) {
         if(trace&1) KALDI_LOG << "Writing network: " << p_targetmmf;
-        pl.nnet_.WriteNetwork(p_targetmmf);
+        pl.nnet_.WriteNetwork(p_targetmmf, save_binary);
       } else {
         MakeHtkFileName(p_trg_mmf_file, p_source_mmf_file, p_trg_mmf_dir, p_trg_mmf_ext);
         if(trace&1) KALDI_LOG << "Writing network: " << p_trg_mmf_file;
-        pl.nnet_.WriteNetwork(p_trg_mmf_file);
+        pl.nnet_.WriteNetwork(p_trg_mmf_file, save_binary);
       }
     }
 
+    delete pl.workers_;
+    pl.workers_ = NULL;
+
     //show report
     timer.End();
 
     pl.cout_mutex_.Lock();
 
     KALDI_COUT << "===== TNET FINISHED ( " << timer.Val() << "s ) "
-               << "[ FPS: " << pl.obj_fun_->GetFrames() / timer.Val() 
-               << " RT: " << 1.0f / (pl.obj_fun_->GetFrames() / timer.Val() / 100.0f)
+               << "[ FPS: " << static_cast<double>(frames) / timer.Val() 
+               << " RT: " << 1.0f / (static_cast<double>(frames) / timer.Val() / 100.0f)
                << " ] =====" << std::endl;
 
     //report objective function
@@ -65,6 +65,7 @@ void usage(const char* progname)
 " -n f       Set learning rate to f                          0.06\n"
 " -o ext     Set target model ext                            None\n"
 " -A         Print command line arguments                    Off\n" 
+" -B         Save NN macro files in binary format            Off\n"
 " -C cf      Set config file to cf                           Default\n"
 " -D         Display configuration variables                 Off\n"
 " -H mmf     Load NN macro file                              \n"
@@ -77,7 +78,7 @@ void usage(const char* progname)
 " -V         Print version information                       Off\n"
 " -X ext     Set input label file ext                        lab\n"
 "\n"
-"BUNCHSIZE CACHESIZE CROSSVALIDATE FEATURETRANSFORM L1 LEARNINGRATE LEARNRATEFACTORS MLFTRANSC MOMENTUM NATURALREADORDER OBJECTIVEFUNCTION OUTPUTLABELMAP PRINTCONFIG PRINTVERSION RANDOMIZE SCRIPT SEED SOURCEMLF SOURCEMMF SOURCETRANSCDIR SOURCETRANSCEXT TARGETMMF TARGETMODELDIR TARGETMODELEXT TRACE USEGPUID WEIGHTCOST\n"
+"BUNCHSIZE CACHESIZE CROSSVALIDATE FEATURETRANSFORM L1 LEARNINGRATE LEARNRATEFACTORS MLFTRANSC MOMENTUM NATURALREADORDER OBJECTIVEFUNCTION OUTPUTLABELMAP PRINTCONFIG PRINTVERSION RANDOMIZE SAVEBINARY SCRIPT SEED SOURCEMLF SOURCEMMF SOURCETRANSCDIR SOURCETRANSCEXT TARGETMMF TARGETMODELDIR TARGETMODELEXT TRACE USEGPUID WEIGHTCOST\n"
 "\n"
 "STARTFRMEXT ENDFRMEXT CMEANDIR CMEANMASK VARSCALEDIR VARSCALEMASK VARSCALEFN TARGETKIND DERIVWINDOWS DELTAWINDOW ACCWINDOW THIRDWINDOW\n"
 "\n"
@@ -103,6 +104,7 @@ int main(int argc, char *argv[]) try
     " -m r   OUTPUTLABELMAP" 
     " -n r   LEARNINGRATE" 
     " -o r   TARGETMODELEXT" 
+    " -B n   SAVEBINARY=TRUE" 
     " -D n   PRINTCONFIG=TRUE"
     " -H l   SOURCEMMF"
     " -I r   SOURCEMLF"
@@ -154,6 +156,7 @@ int main(int argc, char *argv[]) try
   long int                          seed;
 
   bool                              cross_validate;
+  bool                              save_binary;
 
   int                               trace;
 
@@ -226,6 +229,7 @@ int main(int argc, char *argv[]) try
   seed                = ui.GetInt(SNAME":SEED", 0);
 
   cross_validate      = ui.GetBool(SNAME":CROSSVALIDATE",  false);
+  save_binary         = ui.GetBool(SNAME":SAVEBINARY",     false);
 
   trace       = ui.GetInt(SNAME":TRACE",               0);
   if(trace&4) { CuDevice::Instantiate().Verbose(true); }
@@ -456,11 +460,11 @@ int main(int argc, char *argv[]) try
   if(!cross_validate) {
     if (NULL != p_targetmmf) {
       if(trace&1) KALDI_LOG << "Writing network: " << p_targetmmf;
-      network.WriteNetwork(p_targetmmf);
+      network.WriteNetwork(p_targetmmf, save_binary);
     } else {
       MakeHtkFileName(p_trg_mmf_file, p_source_mmf_file, p_trg_mmf_dir, p_trg_mmf_ext);
       if(trace&1) KALDI_LOG << "Writing network: " << p_trg_mmf_file;
-      network.WriteNetwork(p_trg_mmf_file);
+      network.WriteNetwork(p_trg_mmf_file, save_binary);
     }
   }
 
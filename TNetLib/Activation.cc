@@ -1,15 +1,14 @@
 
 #include "Activation.h"
+#include "SimdMath.h"
 
 
 namespace TNet {
 
 void Sigmoid::PropagateFnc(const BfMatrix& X, BfMatrix& Y) {
-  //Y = 1/(1+e^{-X})
+  //Y = 1/(1+e^{-X}), vectorized per row
   for(size_t r=0; r<X.Rows(); r++) {
-    for(size_t c=0; c<X.Cols(); c++) {
-      Y(r,c) = 1.0f/(1.0f+exp(-X(r,c)));
-    }
+    VecSigmoid(X.pRowData(r), Y.pRowData(r), X.Cols());
   }
 }
 
@@ -18,8 +17,11 @@ void Sigmoid::BackpropagateFnc(const Matrix<BaseFloat>& X, Matrix<BaseFloat>& Y)
   const Matrix<BaseFloat>& out = GetOutput();
   //Y = OUT*(1-OUT)*X //ODVOZENO
   for(size_t r=0; r<X.Rows(); r++) {
+    const BaseFloat* x = X.pRowData(r);
+    const BaseFloat* o = out.pRowData(r);
+    BaseFloat* y = Y.pRowData(r);
     for(size_t c=0; c<X.Cols(); c++) {
-      Y(r,c) = X(r,c)*out(r,c)*(1.0f-out(r,c));
+      y[c] = x[c]*o[c]*(1.0f-o[c]);
     }
   }
 }
@@ -27,16 +29,9 @@ void Sigmoid::BackpropagateFnc(const Matrix<BaseFloat>& X, Matrix<BaseFloat>& Y)
 
 
 void Tanh::PropagateFnc(const BfMatrix& X, BfMatrix& Y) {
-  //Y = exp(2x)-1 / exp(2x)+1
+  //Y = exp(2x)-1 / exp(2x)+1, vectorized per row
   for(size_t r=0; r<X.Rows(); r++) {
-    for(size_t c=0; c<X.Cols(); c++) {
-      BaseFloat exp2x = exp(2.0*X(r,c));
-      if(isinf(exp2x)) {
-        Y(r,c) = 1.0;
-      } else {
-        Y(r,c) = (exp2x-1.0)/(exp2x+1.0);
-      }
-    }
+    VecTanh(X.pRowData(r), Y.pRowData(r), X.Cols());
   }
 }
 
@@ -45,8 +40,11 @@ void Tanh::BackpropagateFnc(const Matrix<BaseFloat>& X, Matrix<BaseFloat>& Y) {
   const Matrix<BaseFloat>& out = GetOutput();
   //Y = X * (1 - OUT^2)
   for(size_t r=0; r<X.Rows(); r++) {
+    const BaseFloat* x = X.pRowData(r);
+    const BaseFloat* o = out.pRowData(r);
+    BaseFloat* y = Y.pRowData(r);
     for(size_t c=0; c<X.Cols(); c++) {
-      Y(r,c) = X(r,c) * (1.0 - out(r,c)*out(r,c));
+      y[c] = static_cast<BaseFloat>(x[c]*(1.0-o[c]*o[c]));
     }
   }
 }
@@ -38,12 +38,19 @@ void
 BiasedLinearity::
 ReadFromStream(std::istream& rIn)
 {
-  //matrix is stored transposed as SNet does
-  Matrix<BaseFloat> transpose;
-  rIn >> transpose;
-  mLinearity = Matrix<BaseFloat>(transpose, TRANS);
+  //matrix is stored transposed as SNet does,
+  //the binary records of a mapped model are used in place (read-only)
+  if(NULL != (mpMappedLinearity = MapTransposed<BaseFloat>(rIn))) {
+    mpLinearity = mpMappedLinearity;
+  } else {
+    ReadTransposed(rIn, mLinearity);
+  }
   //biases stored normally
-  rIn >> mBias;
+  if(NULL != (mpMappedBias = MapVector<BaseFloat>(rIn))) {
+    mpBias = mpMappedBias;
+  } else {
+    rIn >> mBias;
+  }
 }
 
  
@@ -52,10 +59,9 @@ BiasedLinearity::
 WriteToStream(std::ostream& rOut)
 {
   //matrix is stored transposed as SNet does
-  Matrix<BaseFloat> transpose(mLinearity, TRANS);
-  rOut << transpose;
+  WriteTransposed(rOut, *mpLinearity);
   //biases stored normally
-  rOut << mBias;
+  rOut << *mpBias;
   rOut << std::endl;
 }
 
@@ -64,6 +70,11 @@ void
 BiasedLinearity::
 Gradient()
 {
+  //allocate the gradient buffer when needed 
+  //(the networks used only for inference don't have it)
+  if(mLinearityCorrection.MSize() == 0) {
+    mLinearityCorrection.Init(GetNInputs(),GetNOutputs());
+  }
   //calculate gradient of weight matrix
   mLinearityCorrection.Zero();
   mLinearityCorrection.BlasGemm(1.0f, GetInput(), TRANS, 
@@ -87,21 +98,39 @@ Gradient()
 
 void 
 BiasedLinearity::
-AccuGradient(const UpdatableComponent& src, int thr, int thrN) {
-  //cast the argument
-  const BiasedLinearity& src_comp = dynamic_cast<const BiasedLinearity&>(src);
-
+AccuGradient(const std::vector<const UpdatableComponent*>& src, int thr, int thrN) {
   //allocate accumulators when needed
-  if(mLinearityCorrectionAccu.MSize() == 0) {
-    mLinearityCorrectionAccu.Init(mLinearity.Rows(),mLinearity.Cols());
+  if(mFloatAccu) {
+    LinearityAccuFloat();
+  } else {
+    LinearityAccu();
   }
-  if(mBiasCorrectionAccu.MSize() == 0) {
-    mBiasCorrectionAccu.Init(mBias.Dim());
+  BiasAccu();
+
+  //cast the arguments
+  std::vector<const Matrix<BaseFloat>*> src_mat(src.size());
+  for(size_t s=0; s<src.size(); s++) {
+    src_mat[s] = &dynamic_cast<const BiasedLinearity&>(*src[s]).mLinearityCorrection;
+  }
+
+  //the thread sums its part of the bias correction
+  int bdiv = static_cast<int>(mBias.Dim()) / thrN;
+  int bmod = static_cast<int>(mBias.Dim()) % thrN;
+
+  int borigin = thr * bdiv + ((bmod > thr)? thr : bmod);
+  int bdim = bdiv + ((bmod > thr)? 1 : 0);
+
+  for(size_t s=0; s<src.size(); s++) {
+    const BaseFloat* p_src = dynamic_cast<const BiasedLinearity&>(*src[s]).mBiasCorrection.pData() + borigin;
+    double* p_tgt = mBiasCorrectionAccu.pData() + borigin;
+    for(int i=0; i<bdim; i++) {
+      p_tgt[i] += p_src[i];
+    }
   }
 
   //need to find out which rows to sum...
-  int div = mLinearityCorrection.Rows() / thrN;
-  int mod = mLinearityCorrection.Rows() % thrN;
+  int div = static_cast<int>(mLinearity.Rows()) / thrN;
+  int mod = static_cast<int>(mLinearity.Rows()) % thrN;
 
   int origin = thr * div + ((mod > thr)? thr : mod);
   int rows = div + ((mod > thr)? 1 : 0);
@@ -110,32 +139,70 @@ AccuGradient(const UpdatableComponent& src, int thr, int thrN) {
   //so some threads will not do anything
   if(rows == 0) return;
 
-  //create the matrix windows
-  const SubMatrix<BaseFloat> src_mat (
-    src_comp.mLinearityCorrection, 
-    origin, rows, 
-    0, mLinearityCorrection.Cols()
-  );
-  SubMatrix<double> tgt_mat (
-    mLinearityCorrectionAccu, 
-    origin, rows, 
-    0, mLinearityCorrection.Cols()
-  );
-  //sum the rows
-  Add(tgt_mat,src_mat);
-
-  //first thread will always sum the bias correction
-  if(thr == 0) {
-    Add(mBiasCorrectionAccu,src_comp.mBiasCorrection);
+  //sum the rows of all the sources in one pass
+  if(mFloatAccu) {
+    SubMatrix<BaseFloat> tgt_mat (
+      mLinearityCorrectionAccuFloat, 
+      origin, rows, 
+      0, mLinearity.Cols()
+    );
+    AddRowsKahan(tgt_mat,src_mat,origin);
+  } else {
+    SubMatrix<double> tgt_mat (
+      mLinearityCorrectionAccu, 
+      origin, rows, 
+      0, mLinearity.Cols()
+    );
+    AddRows(tgt_mat,src_mat,origin);
   }
 
 }
 
 
+template<typename _ElemT>
+void
+BiasedLinearity::
+UpdateRows(const Matrix<_ElemT>& rGrad, SubMatrix<BaseFloat>& rTgt, int origin, BaseFloat rate)
+{
+  //the momentum step is normalized by the gain 1/(1-mmt)
+  //as in the CUDA components
+  if(mMomentum != 0.0) {
+    assert(mLinearityMomentum.Rows() == mLinearity.Rows());
+    for(size_t r=0; r<rTgt.Rows(); r++) {
+      MomentumStep(rTgt.pRowData(r), mLinearityMomentum.pRowData(origin+r), 
+                   rGrad.pRowData(r), rTgt.Cols(), rate*(1.0f-mMomentum));
+    }
+  } else {
+    AddScaled(rTgt, rGrad, -rate);
+  }
+}
+
+
 void
 BiasedLinearity::
 Update(int thr, int thrN)
 {
+  CheckWritable(__func__);
+  //the thread updates its part of the bias
+  int bdiv = static_cast<int>(mBias.Dim()) / thrN;
+  int bmod = static_cast<int>(mBias.Dim()) % thrN;
+
+  int borigin = thr * bdiv + ((bmod > thr)? thr : bmod);
+  int bdim = bdiv + ((bmod > thr)? 1 : 0);
+
+  if(bdim > 0) {
+    SubVector<double> src_vec(mBiasCorrectionAccu, borigin, bdim);
+    SubVector<BaseFloat> tgt_vec(mBias, borigin, bdim);
+    if(mMomentum != 0.0) {
+      assert(mBiasMomentum.Dim() == mBias.Dim());
+      MomentumStep(tgt_vec.pData(), mBiasMomentum.pData()+borigin, src_vec.pData(), bdim,
+                   mLearningRate*(1.0f-mMomentum));
+    } else {
+      AddScaled(tgt_vec, src_vec, -mLearningRate);
+    }
+    src_vec.Zero();
+  }
+
   //need to find out which rows to sum...
   int div = mLinearity.Rows() / thrN;
   int mod = mLinearity.Rows() % thrN;
@@ -147,31 +214,192 @@ Update(int thr, int thrN)
   //so some threads will not do anything
   if(rows == 0) return;
 
+  //get the matrix window
+  SubMatrix<BaseFloat> tgt_mat (
+    mLinearity, 
+    origin, rows, 
+    0, mLinearity.Cols()
+  );
+
+  //update weights by the accumulated gradient, reset the accumulator
+  if(mFloatAccu) {
+    SubMatrix<BaseFloat> src_mat (
+      mLinearityCorrectionAccuFloat, 
+      origin, rows, 
+      0, mLinearity.Cols()
+    );
+    UpdateRows(src_mat, tgt_mat, origin, mLearningRate);
+    src_mat.Zero();
+  } else {
+    SubMatrix<double> src_mat (
+      mLinearityCorrectionAccu, 
+      origin, rows, 
+      0, mLinearity.Cols()
+    );
+    UpdateRows(src_mat, tgt_mat, origin, mLearningRate);
+    src_mat.Zero();
+  }
+
+  //perform L2 regularization (weight decay)
+  BaseFloat L2_decay = -mLearningRate * mWeightcost * mBunchsize;
+  if(L2_decay != 0.0) {
+    tgt_mat.AddScaled(L2_decay, tgt_mat);
+  }
+
+}
+
+
+void
+BiasedLinearity::
+ApplyGradient(const UpdatableComponent& src, int thr, int thrN)
+{
+  CheckWritable(__func__);
+  //cast the argument
+  const BiasedLinearity& src_comp = dynamic_cast<const BiasedLinearity&>(src);
+
+  //need to find out which rows to update...
+  int div = static_cast<int>(mLinearity.Rows()) / thrN;
+  int mod = static_cast<int>(mLinearity.Rows()) % thrN;
+
+  int origin = thr * div + ((mod > thr)? thr : mod);
+  int rows = div + ((mod > thr)? 1 : 0);
+
+  //we may have more parts than lines in a matrix
+  if(rows == 0) return;
+
   //get the matrix windows
-  SubMatrix<double> src_mat (
-    mLinearityCorrectionAccu, 
+  const SubMatrix<BaseFloat> src_mat (
+    src_comp.mLinearityCorrection, 
     origin, rows, 
-    0, mLinearityCorrection.Cols()
+    0, mLinearity.Cols()
   );
   SubMatrix<BaseFloat> tgt_mat (
     mLinearity, 
     origin, rows, 
-    0, mLinearityCorrection.Cols()
+    0, mLinearity.Cols()
   );
 
-
   //update weights
-  AddScaled(tgt_mat, src_mat, -mLearningRate);
+  tgt_mat.AddScaled(-mLearningRate, src_mat);
 
-  //perform L2 regularization (weight decay)
-  BaseFloat L2_decay = -mLearningRate * mWeightcost * mBunchsize;
+  //perform L2 regularization (weight decay), 
+  //the bunch is the input of the source
+  BaseFloat L2_decay = -mLearningRate * mWeightcost * static_cast<BaseFloat>(src_comp.GetInput().Rows());
   if(L2_decay != 0.0) {
     tgt_mat.AddScaled(L2_decay, tgt_mat);
   }
 
-  //first thread always update bias
+  //first part always updates bias
+  if(thr == 0) {
+    mBias.AddScaled(-mLearningRate, src_comp.mBiasCorrection);
+  }
+}
+
+
+void
+BiasedLinearity::
+DetachWeights()
+{
+  //copy the weights we were pointing to
+  if(mpLinearity != &mLinearity) {
+    mLinearity = *mpLinearity;
+    mpLinearity = &mLinearity;
+  }
+  if(mpBias != &mBias) {
+    mBias = *mpBias;
+    mpBias = &mBias;
+  }
+}
+
+
+void
+BiasedLinearity::
+CheckWritable(const char* pFnc) const
+{
+  if(mpLinearity == mpMappedLinearity || mpBias == mpMappedBias) {
+    KALDI_ERR << pFnc << ": the weights of " << GetName() 
+              << " are mapped read-only from the model file (MapNetwork), "
+              << "load the model by ReadNetwork to train it";
+  }
+}
+
+
+void
+BiasedLinearity::
+AccuWeights(const UpdatableComponent& src, double scale, int thr, int thrN)
+{
+  CheckWritable(__func__);
+  //cast the argument
+  const BiasedLinearity& src_comp = dynamic_cast<const BiasedLinearity&>(src);
+
+  //allocate accumulators when needed
+  LinearityAccu();
+  BiasAccu();
+
+  //need to find out which rows to sum...
+  int div = static_cast<int>(mLinearity.Rows()) / thrN;
+  int mod = static_cast<int>(mLinearity.Rows()) % thrN;
+
+  int origin = thr * div + ((mod > thr)? thr : mod);
+  int rows = div + ((mod > thr)? 1 : 0);
+
+  //we may have more threads than lines in a matrix
+  if(rows == 0) return;
+
+  //create the matrix windows
+  const SubMatrix<BaseFloat> src_mat (
+    *src_comp.mpLinearity, 
+    origin, rows, 
+    0, mLinearity.Cols()
+  );
+  SubMatrix<double> tgt_mat (
+    mLinearityCorrectionAccu, 
+    origin, rows, 
+    0, mLinearity.Cols()
+  );
+  //sum the scaled rows
+  AddScaled(tgt_mat, src_mat, scale);
+
+  //first thread will always sum the bias
+  if(thr == 0) {
+    AddScaled(mBiasCorrectionAccu, *src_comp.mpBias, scale);
+  }
+}
+
+
+void
+BiasedLinearity::
+AverageWeights(int thr, int thrN)
+{
+  CheckWritable(__func__);
+  //need to find out which rows to set...
+  int div = static_cast<int>(mLinearity.Rows()) / thrN;
+  int mod = static_cast<int>(mLinearity.Rows()) % thrN;
+
+  int origin = thr * div + ((mod > thr)? thr : mod);
+  int rows = div + ((mod > thr)? 1 : 0);
+
+  //we may have more threads than lines in a matrix
+  if(rows == 0) return;
+
+  //get the matrix windows
+  SubMatrix<double> src_mat (
+    mLinearityCorrectionAccu, 
+    origin, rows, 
+    0, mLinearity.Cols()
+  );
+  SubMatrix<BaseFloat> tgt_mat (
+    mLinearity, 
+    origin, rows, 
+    0, mLinearity.Cols()
+  );
+
+  //set the averaged weights
+  tgt_mat.Copy(src_mat);
+
+  //first thread always sets bias
   if(thr == 0) {
-    AddScaled(mBias, mBiasCorrectionAccu, -mLearningRate);
+    mBias.Copy(mBiasCorrectionAccu);
   }
 
   //reset the accumulators
@@ -179,7 +407,76 @@ Update(int thr, int thrN)
   if(thr == 0) {
     mBiasCorrectionAccu.Zero();
   }
+}
+
+
+void
+BiasedLinearity::
+CopyWeights(const UpdatableComponent& src)
+{
+  CheckWritable(__func__);
+  //cast the argument
+  const BiasedLinearity& src_comp = dynamic_cast<const BiasedLinearity&>(src);
 
+  //the weights must be detached
+  assert(mpLinearity == &mLinearity && mpBias == &mBias);
+  mLinearity.Copy(*src_comp.mpLinearity);
+  mBias.Copy(*src_comp.mpBias);
 }
 
+Matrix<double>&
+BiasedLinearity::
+LinearityAccu(bool clear)
+{
+  if(mLinearityCorrectionAccu.MSize() == 0) {
+    mLinearityCorrectionAccu.Init(mLinearity.Rows(),mLinearity.Cols(),clear);
+  }
+  return mLinearityCorrectionAccu;
+}
+
+
+Vector<double>&
+BiasedLinearity::
+BiasAccu()
+{
+  if(mBiasCorrectionAccu.MSize() == 0) {
+    mBiasCorrectionAccu.Init(mBias.Dim());
+  }
+  return mBiasCorrectionAccu;
+}
+
+
+Matrix<BaseFloat>&
+BiasedLinearity::
+LinearityAccuFloat(bool clear)
+{
+  if(mLinearityCorrectionAccuFloat.MSize() == 0) {
+    mLinearityCorrectionAccuFloat.Init(mLinearity.Rows(),mLinearity.Cols(),clear);
+  }
+  return mLinearityCorrectionAccuFloat;
+}
+
+
+Matrix<BaseFloat>&
+BiasedLinearity::
+LinearityMomentum(bool clear)
+{
+  if(mLinearityMomentum.MSize() == 0) {
+    mLinearityMomentum.Init(mLinearity.Rows(),mLinearity.Cols(),clear);
+  }
+  return mLinearityMomentum;
+}
+
+
+Vector<BaseFloat>&
+BiasedLinearity::
+BiasMomentum(bool clear)
+{
+  if(mBiasMomentum.MSize() == 0) {
+    mBiasMomentum.Init(mBias.Dim(),clear);
+  }
+  return mBiasMomentum;
+}
+
+
 } //namespace
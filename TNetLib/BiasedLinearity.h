@@ -15,7 +15,8 @@ class BiasedLinearity : public UpdatableComponent
  public:
 
   BiasedLinearity(size_t nInputs, size_t nOutputs, Component *pPred);
-  ~BiasedLinearity() { } 
+  ~BiasedLinearity() 
+  { delete mpMappedLinearity; delete mpMappedBias; }
   
   ComponentType GetType() const
   { return BIASED_LINEARITY; }
@@ -34,9 +35,30 @@ class BiasedLinearity : public UpdatableComponent
   /// calculate gradient
   void Gradient();
   /// accumulate gradient from other components
-  void AccuGradient(const UpdatableComponent& src, int thr, int thrN);  
+  void AccuGradient(const std::vector<const UpdatableComponent*>& src, int thr, int thrN);  
   /// update weights, reset the accumulator
   void Update(int thr, int thrN);
+  /// update the weights by the gradient of src directly
+  void ApplyGradient(const UpdatableComponent& src, int thr, int thrN);
+
+  /// model averaging (see UpdatableComponent)
+  void DetachWeights();
+  void AccuWeights(const UpdatableComponent& src, double scale, int thr, int thrN);
+  void AverageWeights(int thr, int thrN);
+  void CopyWeights(const UpdatableComponent& src);
+
+  Matrix<double>& LinearityAccu(bool clear = true);
+  Vector<double>& BiasAccu();
+  Matrix<BaseFloat>& LinearityAccuFloat(bool clear = true);
+  Matrix<BaseFloat>& LinearityMomentum(bool clear = true);
+  Vector<BaseFloat>& BiasMomentum(bool clear = true);
+
+ private:
+  /// update the rows of the weights by the accumulated gradient
+  template<typename _ElemT>
+  void UpdateRows(const Matrix<_ElemT>& rGrad, SubMatrix<BaseFloat>& rTgt, int origin, BaseFloat rate);
+  /// the weights mapped from a model file are read-only (Network::MapNetwork)
+  void CheckWritable(const char* pFnc) const;
 
  protected:
   Matrix<BaseFloat> mLinearity;  ///< Matrix with neuron weights
@@ -45,12 +67,20 @@ class BiasedLinearity : public UpdatableComponent
   const Matrix<BaseFloat>* mpLinearity;
   const Vector<BaseFloat>* mpBias;
 
+  const SubMatrix<BaseFloat>* mpMappedLinearity; ///< weights used in place from a mapped model (read-only)
+  const SubVector<BaseFloat>* mpMappedBias;      ///< ...
+
   Matrix<BaseFloat> mLinearityCorrection; ///< Matrix for linearity updates
   Vector<BaseFloat> mBiasCorrection;      ///< Vector for bias updates
 
   Matrix<double> mLinearityCorrectionAccu; ///< Matrix for summing linearity updates
   Vector<double> mBiasCorrectionAccu;      ///< Vector for summing bias updates
 
+  Matrix<BaseFloat> mLinearityCorrectionAccuFloat; ///< single-precision accumulator (FloatAccu)
+
+  Matrix<BaseFloat> mLinearityMomentum; ///< velocity of the linearity (momentum)
+  Vector<BaseFloat> mBiasMomentum;      ///< velocity of the bias (momentum)
+
 };
 
 
@@ -65,7 +95,8 @@ BiasedLinearity(size_t nInputs, size_t nOutputs, Component *pPred)
   : UpdatableComponent(nInputs, nOutputs, pPred), 
     mLinearity(), mBias(), //cloned instaces don't need this
     mpLinearity(&mLinearity), mpBias(&mBias), 
-    mLinearityCorrection(nInputs,nOutputs), mBiasCorrection(nOutputs),
+    mpMappedLinearity(NULL), mpMappedBias(NULL),
+    mLinearityCorrection(), mBiasCorrection(nOutputs), //allocated by Gradient()
     mLinearityCorrectionAccu(), mBiasCorrectionAccu() //cloned instances don't need this
 { }
 
@@ -80,6 +111,8 @@ Clone() const
 
   ptr->mLearningRate = mLearningRate;
   ptr->mMomentum = mMomentum;
+  ptr->mNesterov = mNesterov;
+  ptr->mFloatAccu = mFloatAccu;
   ptr->mWeightcost = mWeightcost;
   ptr->mBunchsize = mBunchsize;
   
@@ -44,6 +44,20 @@ namespace TNet
   }
 
 
+  void
+  BlockArray::
+  GetContext(size_t& rLeft, size_t& rRight) const
+  {
+    rLeft = rRight = 0;
+    for(size_t i=0; i<mBlocks.size(); i++) {
+      size_t left, right;
+      mBlocks[i]->GetContext(left, right);
+      if(left > rLeft) rLeft = left;
+      if(right > rRight) rRight = right;
+    }
+  }
+
+
   void 
   BlockArray::
   BackpropagateFnc(const Matrix<BaseFloat>& X, Matrix<BaseFloat>& Y)
@@ -32,6 +32,9 @@ namespace TNet {
  
       Component* Clone() const;
 
+      /// Frame context of the blocks (maximum over the blocks)
+      void GetContext(size_t& rLeft, size_t& rRight) const;
+
     protected:
       std::vector<Network*> mBlocks; ///< vector with networks, one network is one block
       size_t mNBlocks;  
@@ -0,0 +1,145 @@
+#ifndef _BLOCKING_QUEUE_H_
+#define _BLOCKING_QUEUE_H_
+
+#include <pthread.h>
+#include <deque>
+
+#include "Error.h"
+
+namespace TNet {
+
+  /**
+   * Bounded producer/consumer queue,
+   * Push() blocks while the queue is full,
+   * Pop() blocks while the queue is empty and not closed
+   */
+  template<typename T>
+  class BlockingQueue {
+    public:
+      BlockingQueue(size_t capacity = 1)
+       : mCapacity(capacity), mClosed(false)
+      {
+        if(0 != pthread_mutex_init(&mMutex, NULL)) {
+          KALDI_ERR << "Cannot initialize mutex";
+        }
+        if(0 != pthread_cond_init(&mCondPush, NULL) ||
+           0 != pthread_cond_init(&mCondPop, NULL)) {
+          KALDI_ERR << "Cannot initialize condv";
+        }
+      }
+
+      ~BlockingQueue()
+      {
+        if(0 != pthread_mutex_destroy(&mMutex)) {
+          KALDI_ERR << "Cannot destroy mutex";
+        }
+        if(0 != pthread_cond_destroy(&mCondPush) ||
+           0 != pthread_cond_destroy(&mCondPop)) {
+          KALDI_ERR << "Cannot destroy condv";
+        }
+      }
+
+      /// Set the maximal number of queued items (before use)
+      void Capacity(size_t capacity)
+      { mCapacity = (capacity > 0 ? capacity : 1); }
+
+      /// Append the item, wait while the queue is full
+      void Push(const T& rItem)
+      {
+        Lock();
+        while(mQueue.size() >= mCapacity && !mClosed) {
+          Wait(mCondPush);
+        }
+        if(mClosed) {
+          Unlock();
+          KALDI_ERR << "Push to a closed queue";
+        }
+        mQueue.push_back(rItem);
+        Broadcast(mCondPop);
+        Unlock();
+      }
+
+      /// Get the first item, wait while the queue is empty,
+      /// returns false when the queue was closed and all the items were taken
+      bool Pop(T& rItem)
+      {
+        Lock();
+        while(mQueue.empty() && !mClosed) {
+          Wait(mCondPop);
+        }
+        if(mQueue.empty()) {
+          Unlock();
+          return false;
+        }
+        rItem = mQueue.front();
+        mQueue.pop_front();
+        Broadcast(mCondPush);
+        Unlock();
+        return true;
+      }
+
+      /// Mark the end of the data, wakes all the waiting threads
+      void Close()
+      {
+        Lock();
+        mClosed = true;
+        Broadcast(mCondPop);
+        Broadcast(mCondPush);
+        Unlock();
+      }
+
+      /// Number of queued items
+      size_t Size()
+      {
+        Lock();
+        size_t size = mQueue.size();
+        Unlock();
+        return size;
+      }
+
+    private:
+      void Lock()
+      {
+        if(0 != pthread_mutex_lock(&mMutex)) {
+          KALDI_ERR << "Cannot lock mutex";
+        }
+      }
+
+      void Unlock()
+      {
+        if(0 != pthread_mutex_unlock(&mMutex)) {
+          KALDI_ERR << "Cannot unlock mutex";
+        }
+      }
+
+      void Wait(pthread_cond_t& rCond)
+      {
+        if(0 != pthread_cond_wait(&rCond, &mMutex)) {
+          KALDI_ERR << "Error on pthread_cond_wait";
+        }
+      }
+
+      void Broadcast(pthread_cond_t& rCond)
+      {
+        if(0 != pthread_cond_broadcast(&rCond)) {
+          KALDI_ERR << "Error on pthread_cond_broadcast";
+        }
+      }
+
+      /// the mutex/condvars cannot be copied
+      BlockingQueue(const BlockingQueue&);
+      BlockingQueue& operator=(const BlockingQueue&);
+
+    private:
+      std::deque<T> mQueue;
+      size_t mCapacity;
+      bool mClosed;
+
+      pthread_mutex_t mMutex;
+      pthread_cond_t mCondPush;
+      pthread_cond_t mCondPop;
+  };
+
+} //namespace
+
+#endif
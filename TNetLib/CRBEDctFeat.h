@@ -44,6 +44,10 @@ namespace TNet {
 
     void WriteToStream(std::ostream& rOut)  
     { rOut << mFrameOffset; }
+
+    /// Frame offsets of the spliced frames
+    const Vector<int>& FrameOffset() const
+    { return mFrameOffset; }
      
    protected:
     void PropagateFnc(const Matrix<BaseFloat>& X, Matrix<BaseFloat>& Y)
@@ -263,10 +267,7 @@ namespace TNet {
 
       void ReadFromStream(std::istream& rIn)
       { 
-        Matrix<BaseFloat> mat;
-        rIn >> mat;
-        Matrix<BaseFloat> trans(mat,TRANS);
-        mBlockLinearity.Init(trans.Rows(),trans.Cols()).Copy(trans);
+        ReadTransposed(rIn, mBlockLinearity);
 
         if((GetNOutputs() % mBlockLinearity.Cols() != 0) ||
            (GetNInputs() % mBlockLinearity.Rows() != 0) ||
@@ -283,8 +284,7 @@ namespace TNet {
 
       void WriteToStream(std::ostream& rOut)
       {
-        Matrix<BaseFloat> trans(mBlockLinearity,TRANS);
-        rOut << trans;
+        WriteTransposed(rOut, mBlockLinearity);
       }
 
     private:
@@ -157,24 +157,15 @@ namespace TNet {
 
     if(mTrace&3) KALDI_COUT << "R"; // << std::flush;
 
-    //lazy initialization of the output buffers
-    mFeaturesRandom.Init(mCachesize,mFeatures.Cols());
-    mDesiredRandom.Init(mCachesize,mDesired.Cols());
-
-    //generate random series of integers
-    Vector<int> randmask(mIntakePos);
+    //generate random series of integers,
+    //the rows are gathered by GetBunch in this order
+    mRandomIndex.Init(mIntakePos,false);
     for(unsigned int i=0; i<mIntakePos; i++) {
-      randmask[i]=i;
+      mRandomIndex[i]=i;
     }
-    int* ptr = randmask.pData();
+    int* ptr = mRandomIndex.pData();
     std::random_shuffle(ptr, ptr+mIntakePos, mGenerateRandom);
 
-    //randomize
-    for(int i=0; i<randmask.Dim(); i++) {
-      mFeaturesRandom[i].Copy(mFeatures[randmask[i]]);
-      mDesiredRandom[i].Copy(mDesired[randmask[i]]);
-    }
-
     mRandomized = true;
   }
 
@@ -210,13 +201,14 @@ namespace TNet {
 
     //copy the output
     if(mRandomized) {
-      memcpy(rFeatures.pData(),
-             mFeaturesRandom.pData()+mExhaustPos*mFeatures.Stride(),
-             rFeatures.MSize());
-
-      memcpy(rDesired.pData(),
-             mDesiredRandom.pData()+mExhaustPos*mDesired.Stride(),
-             rDesired.MSize());
+      //gather the rows in the shuffled order
+      size_t fea_bytes = mFeatures.Cols()*sizeof(BaseFloat);
+      size_t des_bytes = mDesired.Cols()*sizeof(BaseFloat);
+      for(size_t i=0; i<mBunchsize; i++) {
+        int r = mRandomIndex[mExhaustPos+i];
+        memcpy(rFeatures.pRowData(i), mFeatures.pRowData(r), fea_bytes);
+        memcpy(rDesired.pRowData(i), mDesired.pRowData(r), des_bytes);
+      }
     } else {
       memcpy(rFeatures.pData(),
              mFeatures.pData()+mExhaustPos*mFeatures.Stride(),
@@ -2,6 +2,7 @@
 #define _CUCACHE_H_
 
 #include "Matrix.h"
+#include "Vector.h"
 
 namespace TNet {
 
@@ -20,7 +21,7 @@ namespace TNet {
 
       /// Add data to cache, returns number of added vectors
       void AddData(const Matrix<BaseFloat>& rFeatures, const Matrix<BaseFloat>& rDesired);
-      /// Randomizes the cache
+      /// Randomizes the cache (shuffles the row indices, the data stay in place)
       void Randomize();
       /// Get the bunch of training data
       void GetBunch(Matrix<BaseFloat>& rFeatures, Matrix<BaseFloat>& rDesired);
@@ -74,13 +75,12 @@ namespace TNet {
       int mDiscarded; ///< Number of discarded frames
 
       Matrix<BaseFloat> mFeatures; ///< Feature cache
-      Matrix<BaseFloat> mFeaturesRandom; ///< Feature cache
       Matrix<BaseFloat> mFeaturesLeftover; ///< Feature cache
       
       Matrix<BaseFloat> mDesired;  ///< Desired vector cache
-      Matrix<BaseFloat> mDesiredRandom;  ///< Desired vector cache
       Matrix<BaseFloat> mDesiredLeftover;  ///< Desired vector cache
 
+      Vector<int> mRandomIndex; ///< Shuffled row indices of the cache
       bool mRandomized;
 
       int mTrace;
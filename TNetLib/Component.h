@@ -6,6 +6,7 @@
 #include "Matrix.h"
 
 #include <iostream>
+#include <algorithm>
 #include <stdexcept>
 
 
@@ -86,6 +87,17 @@ namespace TNet {
        
       /// Perform forward pass propagateion Input->Output
       void Propagate(); 
+      /// Perform forward pass of this component and the following 
+      /// element-wise component rNext (Input->rNext.Output), 
+      /// the own output is not stored, see Network::Propagate
+      void PropagateFused(Component& rNext); 
+
+      /// Forward pass X->Y without storing the output (inference only),
+      /// Y must be allocated by the caller
+      void Forward(const Matrix<BaseFloat>& X, Matrix<BaseFloat>& Y);
+      /// Forward pass of this component and the following element-wise
+      /// component rNext X->Y, no output is stored (inference only)
+      void ForwardFused(Component& rNext, const Matrix<BaseFloat>& X, Matrix<BaseFloat>& Y);
       /// Perform backward pass propagateion ErrorInput->ErrorOutput
       void Backpropagate(); 
  
@@ -145,10 +157,39 @@ namespace TNet {
 
       /// calculate gradient
       virtual void Gradient() = 0;
-      /// accumulate gradient from other components
-      virtual void AccuGradient(const UpdatableComponent& src, int thr, int thrN) = 0;  
+      /// accumulate the gradients of the other components,
+      /// the thread sums its part of the weight rows and of the bias
+      virtual void AccuGradient(const std::vector<const UpdatableComponent*>& src, int thr, int thrN) = 0;  
       /// update weights, reset the accumulator
       virtual void Update(int thr, int thrN) = 0;
+      /// update the rows of part thr (of thrN) of the weights 
+      /// by the gradient of src directly (asynchronous SGD)
+      virtual void ApplyGradient(const UpdatableComponent& src, int thr, int thrN) = 0;
+
+      /// use a private copy of the weights 
+      /// (a clone shares the weights of the original)
+      virtual void DetachWeights() = 0;
+      /// accumulate the scaled weights of src, rows of part thr (of thrN),
+      /// the gradient accumulator is used (model averaging)
+      virtual void AccuWeights(const UpdatableComponent& src, double scale, int thr, int thrN) = 0;
+      /// replace the weights by the accumulated ones, reset the accumulator
+      virtual void AverageWeights(int thr, int thrN) = 0;
+      /// copy the weights of src
+      virtual void CopyWeights(const UpdatableComponent& src) = 0;
+
+      /// accumulator of the weights (allocated when needed,
+      /// with clear=false the threads zero their rows: first touch)
+      virtual Matrix<double>& LinearityAccu(bool clear = true) = 0;
+      /// accumulator of the bias (allocated when needed)
+      virtual Vector<double>& BiasAccu() = 0;
+      /// single-precision accumulator of the weight gradient,
+      /// used instead of LinearityAccu() by AccuGradient/Update with FloatAccu()
+      virtual Matrix<BaseFloat>& LinearityAccuFloat(bool clear = true) = 0;
+      /// velocity of the weights and of the bias for Momentum() != 0
+      /// (allocated when needed, with clear=false the threads zero 
+      /// their parts: first touch, as the accumulators)
+      virtual Matrix<BaseFloat>& LinearityMomentum(bool clear = true) = 0;
+      virtual Vector<BaseFloat>& BiasMomentum(bool clear = true) = 0;
 
       /// Sets the learning rate of gradient descent
       void LearnRate(BaseFloat rate);
@@ -158,17 +199,34 @@ namespace TNet {
       void Momentum(BaseFloat mmt);
       BaseFloat Momentum() const ;
 
+      /// Nesterov momentum (the step is g+mmt*v instead of v)
+      void Nesterov(bool nesterov);
+      bool Nesterov() const;
+
       void Weightcost(BaseFloat cost);
       BaseFloat Weightcost() const;
 
+      /// sum the gradients in BaseFloat with Kahan summation
+      /// (single precision, double with -DDOUBLEPRECISION)
+      void FloatAccu(bool floatAccu);
+      bool FloatAccu() const;
+
       void Bunchsize(size_t size);
       size_t Bunchsize() const;
 
+    protected:
+      /// Update n weights by the summed gradient with momentum: 
+      /// v = mmt*v + g, w -= rate*v (w -= rate*(g+mmt*v) with Nesterov)
+      template<typename _ElemT>
+      void MomentumStep(BaseFloat* pW, BaseFloat* pV, const _ElemT* pG, size_t n, BaseFloat rate) const;
+
     protected:
       BaseFloat mLearningRate;
       BaseFloat mMomentum;
+      bool mNesterov;
       BaseFloat mWeightcost;
       size_t mBunchsize;
+      bool mFloatAccu;
   };
 
 
@@ -218,6 +276,61 @@ namespace TNet {
   }
 
 
+  inline void
+  Component::
+  PropagateFused(Component& rNext)
+  {
+    //initialize output buffer of the following component
+    if(rNext.mOutput.Rows() != GetInput().Rows() || rNext.mOutput.Cols() != rNext.GetNOutputs()) {
+      rNext.mOutput.Init(GetInput().Rows(),rNext.GetNOutputs());
+    }
+    //run both transforms
+    ForwardFused(rNext, GetInput(), rNext.mOutput);
+  }
+
+
+  inline void
+  Component::
+  Forward(const Matrix<BaseFloat>& X, Matrix<BaseFloat>& Y)
+  {
+    //do the dimensionality test
+    if(GetNInputs() != X.Cols()) {
+      KALDI_ERR << "Non-matching INPUT dim!!! Network dim: " << GetNInputs() 
+                << " Data dim: " << X.Cols();
+    }
+    assert(Y.Rows() == X.Rows() && Y.Cols() == GetNOutputs());
+    //run transform
+    PropagateFnc(X,Y);
+  }
+
+
+  inline void
+  Component::
+  ForwardFused(Component& rNext, const Matrix<BaseFloat>& X, Matrix<BaseFloat>& Y)
+  {
+    //do the dimensionality test
+    if(GetNInputs() != X.Cols()) {
+      KALDI_ERR << "Non-matching INPUT dim!!! Network dim: " << GetNInputs() 
+                << " Data dim: " << X.Cols();
+    }
+    assert(GetNOutputs() == rNext.GetNInputs());
+    assert(rNext.GetNInputs() == rNext.GetNOutputs());
+    assert(Y.Rows() == X.Rows() && Y.Cols() == rNext.GetNOutputs());
+
+    //run both transforms per blocks of rows, 
+    //the second one in-place while the block is in the cache
+    size_t block = (256*1024) / (sizeof(BaseFloat)*Y.Cols());
+    if(block < 32) block = 32;
+    for(size_t r=0; r<X.Rows(); r+=block) {
+      size_t rows = std::min(block, X.Rows()-r);
+      SubMatrix<BaseFloat> x_block(X, r, rows, 0, X.Cols());
+      SubMatrix<BaseFloat> y_block(Y, r, rows, 0, Y.Cols());
+      PropagateFnc(x_block, y_block);
+      rNext.PropagateFnc(y_block, y_block);
+    }
+  }
+
+
   inline void
   Component::
   Backpropagate()
@@ -309,7 +422,8 @@ namespace TNet {
   UpdatableComponent::
   UpdatableComponent(size_t nInputs, size_t nOutputs, Component *pPred) 
     : Component(nInputs, nOutputs, pPred), 
-      mLearningRate(0.0), mMomentum(0.0), mWeightcost(0.0), mBunchsize(0)
+      mLearningRate(0.0), mMomentum(0.0), mNesterov(false), mWeightcost(0.0), mBunchsize(0),
+      mFloatAccu(false)
   {
     ; 
   } 
@@ -351,6 +465,42 @@ namespace TNet {
   {
     return mMomentum;
   }
+
+
+  inline void
+  UpdatableComponent::
+  Nesterov(bool nesterov)
+  {
+    mNesterov = nesterov;
+  }
+
+  inline bool
+  UpdatableComponent::
+  Nesterov() const
+  {
+    return mNesterov;
+  }
+
+
+  template<typename _ElemT>
+  inline void
+  UpdatableComponent::
+  MomentumStep(BaseFloat* pW, BaseFloat* pV, const _ElemT* pG, size_t n, BaseFloat rate) const
+  {
+    const BaseFloat mmt = mMomentum;
+    if(mNesterov) {
+      for(size_t i=0; i<n; i++) {
+        BaseFloat g = static_cast<BaseFloat>(pG[i]);
+        pV[i] = mmt*pV[i] + g;
+        pW[i] -= rate*(g + mmt*pV[i]);
+      }
+    } else {
+      for(size_t i=0; i<n; i++) {
+        pV[i] = mmt*pV[i] + static_cast<BaseFloat>(pG[i]);
+        pW[i] -= rate*pV[i];
+      }
+    }
+  }
   
   
   inline void
@@ -367,6 +517,21 @@ namespace TNet {
     return mWeightcost;
   }
 
+
+  inline void
+  UpdatableComponent::
+  FloatAccu(bool floatAccu)
+  {
+    mFloatAccu = floatAccu;
+  }
+
+  inline bool
+  UpdatableComponent::
+  FloatAccu() const
+  {
+    return mFloatAccu;
+  }
+
   
   inline void
   UpdatableComponent::
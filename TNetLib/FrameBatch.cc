@@ -0,0 +1,91 @@
+
+#include "FrameBatch.h"
+
+#include <algorithm>
+
+namespace TNet {
+
+
+  FrameBatch::
+  FrameBatch(size_t maxFrames, size_t startFrmExt, size_t endFrmExt)
+   : mMaxFrames(maxFrames), mStartFrmExt(startFrmExt), mEndFrmExt(endFrmExt),
+     mFrames(0)
+  { }
+
+
+  void
+  FrameBatch::
+  Add(const Matrix<BaseFloat>& rFeats)
+  {
+    if(rFeats.Rows() <= mStartFrmExt + mEndFrmExt) {
+      KALDI_ERR << "Utterance not longer than its context: " << rFeats.Rows();
+    }
+    if(!Empty() && rFeats.Cols() != mInput.Cols()) {
+      KALDI_ERR << "Feature dimension mismatch, batch: " << mInput.Cols()
+                << " utterance: " << rFeats.Cols();
+    }
+
+    //grow the buffer (only an utterance longer than the batch limit
+    //does not fit to the default capacity)
+    size_t rows = mFrames + rFeats.Rows();
+    if(rows > mInput.Rows() || rFeats.Cols() != mInput.Cols()) {
+      if(mFrames > 0) {
+        Matrix<BaseFloat> packed(mInput.Range(0,mFrames,0,mInput.Cols()));
+        mInput.Init(std::max(rows,mMaxFrames), rFeats.Cols());
+        mInput.Range(0,mFrames,0,mInput.Cols()).Copy(packed);
+      } else {
+        mInput.Init(std::max(rows,mMaxFrames), rFeats.Cols());
+      }
+    }
+
+    //append the utterance
+    mInput.Range(mFrames,rFeats.Rows(),0,mInput.Cols()).Copy(rFeats);
+    mOffset.push_back(mFrames);
+    mRows.push_back(rFeats.Rows());
+    mFrames += rFeats.Rows();
+  }
+
+
+  void
+  FrameBatch::
+  Forward(Network& rTransf, Network& rNnet)
+  {
+    assert(!Empty());
+    const SubMatrix<BaseFloat> packed = mInput.Range(0,mFrames,0,mInput.Cols());
+    rTransf.Feedforward(packed, mTransfOut, mStartFrmExt, mEndFrmExt);
+    rNnet.Feedforward(mTransfOut, mOutput, mStartFrmExt, mEndFrmExt);
+  }
+
+
+  void
+  FrameBatch::
+  Forward(Network& rNnet)
+  {
+    assert(!Empty());
+    const SubMatrix<BaseFloat> packed = mInput.Range(0,mFrames,0,mInput.Cols());
+    rNnet.Feedforward(packed, mOutput, mStartFrmExt, mEndFrmExt);
+  }
+
+
+  void
+  FrameBatch::
+  GetOutput(size_t i, Matrix<BaseFloat>& rOut) const
+  {
+    assert(i < Utterances());
+    size_t rows = mRows[i] - mStartFrmExt - mEndFrmExt;
+    rOut.Init(rows, mOutput.Cols());
+    rOut.Copy(mOutput.Range(mOffset[i]+mStartFrmExt, rows, 0, mOutput.Cols()));
+  }
+
+
+  void
+  FrameBatch::
+  Clear()
+  {
+    mFrames = 0;
+    mOffset.clear();
+    mRows.clear();
+  }
+
+
+} //namespace TNet
@@ -0,0 +1,75 @@
+#ifndef _FRAME_BATCH_H_
+#define _FRAME_BATCH_H_
+
+#include "Matrix.h"
+#include "Nnet.h"
+
+#include <vector>
+
+namespace TNet {
+
+
+  /**
+   * Packs the frames of several utterances into one matrix for inference,
+   * so the networks run large GEMMs also on short utterances.
+   *
+   * Each utterance keeps its start/end context frames, which are trimmed 
+   * from the output, so the context of the other frames never crosses 
+   * the utterance boundary (as in Network::Feedforward)
+   *
+   * A batch takes utterances while the packed input frames (with the
+   * context) stay within maxFrames, a longer utterance forms a batch
+   * alone. TNorm and TFeaCat share this meaning of BATCHFRAMES.
+   */
+  class FrameBatch {
+    public:
+      FrameBatch(size_t maxFrames, size_t startFrmExt, size_t endFrmExt);
+
+      /// Returns true if the utterance fits to the batch,
+      /// an empty batch takes any utterance
+      bool Fits(const Matrix<BaseFloat>& rFeats) const
+      { return Empty() || mFrames + rFeats.Rows() <= mMaxFrames; }
+
+      /// Append the utterance (including the context frames)
+      void Add(const Matrix<BaseFloat>& rFeats);
+
+      /// Forward the batch through the networks (the transform may be empty)
+      void Forward(Network& rTransf, Network& rNnet);
+      /// Forward the batch through a single network
+      void Forward(Network& rNnet);
+
+      /// Number of utterances in the batch
+      size_t Utterances() const
+      { return mOffset.size(); }
+
+      /// Returns true if there is no utterance in the batch
+      bool Empty() const
+      { return mOffset.empty(); }
+
+      /// Number of input frames of the i-th utterance (including the context)
+      size_t InputFrames(size_t i) const
+      { return mRows[i]; }
+
+      /// Get the output of the i-th utterance (the context frames trimmed)
+      void GetOutput(size_t i, Matrix<BaseFloat>& rOut) const;
+
+      /// Remove all the utterances
+      void Clear();
+
+    private:
+      size_t mMaxFrames;   ///< flush limit of the packed frames
+      size_t mStartFrmExt; ///< context frames on the utterance start
+      size_t mEndFrmExt;   ///< context frames on the utterance end
+
+      size_t mFrames;              ///< number of packed frames
+      std::vector<size_t> mOffset; ///< first row of the utterances
+      std::vector<size_t> mRows;   ///< rows of the utterances
+
+      Matrix<BaseFloat> mInput;     ///< packed input (capacity mMaxFrames)
+      Matrix<BaseFloat> mTransfOut; ///< output of the transform
+      Matrix<BaseFloat> mOutput;    ///< output of the network
+  };
+
+} //namespace TNet
+
+#endif
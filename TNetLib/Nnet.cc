@@ -3,13 +3,33 @@
 //#include <locale>
 #include <cctype>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
 #include "Nnet.h"
 #include "CRBEDctFeat.h"
 #include "BlockArray.h"
+#include "ParallelFeedforward.h"
 
 namespace TNet {
 
 
+Network::~Network() {
+  //stop the Feedforward workers
+  delete mpParallel;
+  //delete all the components
+  LayeredType::iterator it;
+  for(it=mNnet.begin(); it!=mNnet.end(); ++it) {
+    delete *it;
+  }
+  //release the mapped weights
+  if(NULL != mpMapData) {
+    munmap(mpMapData, mMapSize);
+  }
+}
 
 
 void Network::Feedforward(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out, 
@@ -24,44 +44,60 @@ void Network::Feedforward(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out,
   }
   
   //short input: propagate in one block  
-  if(in.Rows() < 5000) { 
-    Propagate(in,out);
-  } else {//long input: propagate per parts
-    //initialize
-    out.Init(in.Rows(),GetNOutputs());
-    Matrix<BaseFloat> tmp_in, tmp_out;
-    int done=0, block=1024;
-    //propagate first part
-    tmp_in.Init(block+end_frm_ext,in.Cols());
-    tmp_in.Copy(in.Range(0,block+end_frm_ext,0,in.Cols()));
-    Propagate(tmp_in,tmp_out);
-    out.Range(0,block,0,tmp_out.Cols()).Copy(
-      tmp_out.Range(0,block,0,tmp_out.Cols())
-    );
+  size_t block = mFeedforwardBlock;
+  if(in.Rows() < std::max((size_t)5000, 2*block)) { 
+    Forward(in,out);
+    return;
+  }
+
+  //long input: propagate per parts,
+  //the last part takes the rest (block..2*block frames)
+  out.Init(in.Rows(),GetNOutputs());
+  std::vector<size_t> begin;
+  size_t done = 0;
+  do {
+    begin.push_back(done);
     done += block;
-    //propagate middle parts
-    while((done+2*block) < in.Rows()) {
-      tmp_in.Init(block+start_frm_ext+end_frm_ext,in.Cols());
-      tmp_in.Copy(in.Range(done-start_frm_ext, block+start_frm_ext+end_frm_ext, 0,in.Cols()));      Propagate(tmp_in,tmp_out);
-      out.Range(done,block,0,tmp_out.Cols()).Copy(
-        tmp_out.Range(start_frm_ext,block,0,tmp_out.Cols())
-      );
-      done += block;
+  } while((done+2*block) < in.Rows());
+  begin.push_back(done);
+
+  if(NULL != mpParallel) {
+    mpParallel->Feedforward(in, out, begin, start_frm_ext, end_frm_ext);
+  } else {
+    for(size_t i=0; i<begin.size(); i++) {
+      size_t end = (i+1 < begin.size() ? begin[i+1] : in.Rows());
+      FeedforwardBlock(in, out, begin[i], end-begin[i], 
+                       start_frm_ext, end_frm_ext, mFeedforwardBuf);
     }
-    //propagate last part
-    tmp_in.Init(in.Rows()-done+start_frm_ext,in.Cols());
-    tmp_in.Copy(in.Range(done-start_frm_ext,in.Rows()-done+start_frm_ext,0,in.Cols()));
-    Propagate(tmp_in,tmp_out);
-    out.Range(done,out.Rows()-done,0,out.Cols()).Copy(
-      tmp_out.Range(start_frm_ext,tmp_out.Rows()-start_frm_ext,0,tmp_out.Cols())   
-    );
+  }
+}
 
-    done += tmp_out.Rows()-start_frm_ext;
-    assert(done == out.Rows());
+
+void Network::SetFeedforward(size_t block, int threads) {
+  if(block < 1) KALDI_ERR << "Feedforward block must have at least one frame";
+  mFeedforwardBlock = block;
+  delete mpParallel;
+  mpParallel = NULL;
+  if(threads > 1 && mNnet.size() > 0) {
+    mpParallel = new ParallelFeedforward(*this, threads);
   }
 }
 
 
+void Network::FeedforwardBlock(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out,
+                               size_t begin, size_t rows,
+                               size_t start_frm_ext, size_t end_frm_ext,
+                               Matrix<BaseFloat>& buf) {
+  //context frames around the block, read in place
+  size_t left = std::min(start_frm_ext, begin);
+  size_t right = std::min(end_frm_ext, in.Rows()-begin-rows);
+  Forward(in.Range(begin-left, left+rows+right, 0, in.Cols()), buf);
+  out.Range(begin, rows, 0, out.Cols()).Copy(
+    buf.Range(left, rows, 0, buf.Cols())
+  );
+}
+
+
 void Network::Propagate(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out) {
   //empty network: copy input to output 
   if(mNnet.size() == 0) {
@@ -72,14 +108,8 @@ void Network::Propagate(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out) {
     return;
   }
   
-  //this will keep pointer to matrix 'in', for backprop
-  mNnet.front()->SetInput(in); 
-
   //propagate
-  LayeredType::iterator it;
-  for(it=mNnet.begin(); it!=mNnet.end(); ++it) {
-    (*it)->Propagate();
-  }
+  PropagateLayers(in, mNnet.size());
 
   //copy the output matrix
   const Matrix<BaseFloat>& mat = mNnet.back()->GetOutput();
@@ -91,6 +121,100 @@ void Network::Propagate(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out) {
 }
 
 
+bool Network::IsFusable(size_t i, size_t end) const {
+  return (i+1 < end && mNnet[i]->GetType() == Component::BIASED_LINEARITY &&
+          (mNnet[i+1]->GetType() == Component::SIGMOID || 
+           mNnet[i+1]->GetType() == Component::TANH));
+}
+
+
+void Network::Forward(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out) {
+  //empty network: copy input to output 
+  if(mNnet.size() == 0) {
+    if(out.Rows() != in.Rows() || out.Cols() != in.Cols()) {
+      out.Init(in.Rows(),in.Cols());
+    }
+    out.Copy(in);
+    return;
+  }
+
+  if(in.Cols() != GetNInputs()) {
+    KALDI_ERR << "Non-matching INPUT dim!!! Network dim: " << GetNInputs() 
+              << " Data dim: " << in.Cols();
+  }
+
+  //the last layer writes to the output
+  if(out.Rows() != in.Rows() || out.Cols() != GetNOutputs()) {
+    out.Init(in.Rows(),GetNOutputs());
+  }
+
+  //the scratch buffers are sized to the widest hidden layer,
+  //they only grow, so they are reused by the next calls
+  size_t rows = in.Rows();
+  size_t width = 0;
+  for(size_t i=0; i+1<mNnet.size(); i++) {
+    width = std::max(width, mNnet[i]->GetNOutputs());
+  }
+  for(int k=0; k<2; k++) {
+    if(width > 0 && (mForwardBuf[k].Rows() < rows || mForwardBuf[k].Cols() < width)) {
+      mForwardBuf[k].Init(std::max(rows,mForwardBuf[k].Rows()),
+                          std::max(width,mForwardBuf[k].Cols()), false);
+    }
+  }
+
+  //ping-pong between the buffers
+  int cur = 0;
+  for(size_t i=0; i<mNnet.size(); i++) {
+    bool fused = IsFusable(i,mNnet.size());
+    size_t j = (fused ? i+1 : i); //last layer of this step
+    bool first = (i == 0);
+    bool last = (j+1 == mNnet.size());
+
+    const SubMatrix<BaseFloat> x(first ? in : mForwardBuf[cur], 
+                                 0, rows, 0, mNnet[i]->GetNInputs());
+    SubMatrix<BaseFloat> y(last ? out : mForwardBuf[1-cur],
+                           0, rows, 0, mNnet[j]->GetNOutputs());
+    if(fused) {
+      mNnet[i]->ForwardFused(*mNnet[j],x,y);
+    } else {
+      mNnet[i]->Forward(x,y);
+    }
+    cur = 1-cur;
+    i = j;
+  }
+}
+
+
+void Network::PropagateLayers(const Matrix<BaseFloat>& in, size_t end) {
+  //this will keep pointer to matrix 'in', for backprop
+  mNnet.front()->SetInput(in); 
+
+  for(size_t i=0; i<end; i++) {
+    //the output of the linearity is not needed by the backpropagation
+    //of sigmoid/tanh (it uses its own output), so it is not stored
+    if(IsFusable(i,end)) {
+      mNnet[i]->PropagateFused(*mNnet[i+1]);
+      i++;
+    } else {
+      mNnet[i]->Propagate();
+    }
+  }
+}
+
+
+const Matrix<BaseFloat>& Network::PropagateLogits(const Matrix<BaseFloat>& in) {
+  if(mNnet.size() < 2 || mNnet.back()->GetType() != Component::SOFTMAX) {
+    KALDI_ERR << "The network does not end with <softmax>";
+  }
+
+  //propagate, skip the softmax
+  PropagateLayers(in, mNnet.size()-1);
+
+  //the input of the softmax
+  return mNnet[mNnet.size()-2]->GetOutput();
+}
+
+
 void Network::Backpropagate(const Matrix<BaseFloat>& globerr) {
   //pass matrix to last component
   mNnet.back()->SetErrorInput(globerr);
@@ -111,7 +235,34 @@ void Network::Backpropagate(const Matrix<BaseFloat>& globerr) {
 }
 
 
-void Network::AccuGradient(const Network& src, int thr, int thrN) {
+void Network::AccuGradient(const std::vector<const Network*>& src, int thr, int thrN) {
+  std::vector<const UpdatableComponent*> comp2(src.size());
+
+  for(int i=0; i<Layers(); i++) {
+    if(Layer(i).IsUpdatable()) {
+      UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(Layer(i));
+      for(size_t s=0; s<src.size(); s++) {
+        comp2[s] = &dynamic_cast<const UpdatableComponent&>(src[s]->Layer(i));
+      }
+      comp.AccuGradient(comp2,thr,thrN);
+    }
+  }
+}
+
+
+void Network::Update(int thr, int thrN) {
+  LayeredType::iterator it;
+
+  for(it=mNnet.begin(); it!=mNnet.end(); ++it) {
+    if((*it)->IsUpdatable()) {
+      UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(**it);
+      comp.Update(thr,thrN);
+    }
+  }
+}
+
+
+void Network::ApplyGradient(const Network& src, int thr, int thrN) {
   LayeredType::iterator it;
   LayeredType::const_iterator it2;
 
@@ -119,24 +270,81 @@ void Network::AccuGradient(const Network& src, int thr, int thrN) {
     if((*it)->IsUpdatable()) {
       UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(**it);
       const UpdatableComponent& comp2 = dynamic_cast<const UpdatableComponent&>(**it2);
-      comp.AccuGradient(comp2,thr,thrN);
+      comp.ApplyGradient(comp2,thr,thrN);
     }
   }
 }
 
 
-void Network::Update(int thr, int thrN) {
+void Network::DetachWeights() {
   LayeredType::iterator it;
+  for(it=mNnet.begin(); it!=mNnet.end(); ++it) {
+    if((*it)->IsUpdatable()) {
+      dynamic_cast<UpdatableComponent&>(**it).DetachWeights();
+    }
+  }
+}
 
+
+void Network::AccuWeights(const Network& src, double scale, int thr, int thrN) {
+  LayeredType::iterator it;
+  LayeredType::const_iterator it2;
+
+  for(it=mNnet.begin(), it2=src.mNnet.begin(); it!=mNnet.end(); ++it,++it2) {
+    if((*it)->IsUpdatable()) {
+      UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(**it);
+      const UpdatableComponent& comp2 = dynamic_cast<const UpdatableComponent&>(**it2);
+      comp.AccuWeights(comp2,scale,thr,thrN);
+    }
+  }
+}
+
+
+void Network::AverageWeights(int thr, int thrN) {
+  LayeredType::iterator it;
   for(it=mNnet.begin(); it!=mNnet.end(); ++it) {
+    if((*it)->IsUpdatable()) {
+      dynamic_cast<UpdatableComponent&>(**it).AverageWeights(thr,thrN);
+    }
+  }
+}
+
+
+void Network::CopyWeights(const Network& src) {
+  LayeredType::iterator it;
+  LayeredType::const_iterator it2;
+
+  for(it=mNnet.begin(), it2=src.mNnet.begin(); it!=mNnet.end(); ++it,++it2) {
     if((*it)->IsUpdatable()) {
       UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(**it);
-      comp.Update(thr,thrN);
+      const UpdatableComponent& comp2 = dynamic_cast<const UpdatableComponent&>(**it2);
+      comp.CopyWeights(comp2);
     }
   }
 }
 
 
+void Network::GetContext(size_t& rLeft, size_t& rRight) const {
+  rLeft = rRight = 0;
+  LayeredType::const_iterator it;
+  for(it = mNnet.begin(); it != mNnet.end(); ++it) {
+    size_t left = 0, right = 0;
+    if((*it)->GetType() == Component::EXPAND) {
+      const Vector<int>& offset = dynamic_cast<const Expand*>(*it)->FrameOffset();
+      for(size_t i=0; i<offset.Dim(); i++) {
+        if(offset[i] < 0 && (size_t)(-offset[i]) > left) left = -offset[i];
+        if(offset[i] > 0 && (size_t)offset[i] > right) right = offset[i];
+      }
+    } else if((*it)->GetType() == Component::BLOCK_ARRAY) {
+      dynamic_cast<const BlockArray*>(*it)->GetContext(left, right);
+    }
+    //the context of the stacked layers adds up
+    rLeft += left;
+    rRight += right;
+  }
+}
+
+
 Network* Network::Clone() {
   Network* net = new Network;
   LayeredType::iterator it;
@@ -155,12 +363,15 @@ Network* Network::Clone() {
   //copy the learning rate
   //net->SetLearnRate(GetLearnRate());
 
+  //the Feedforward block size (the clone runs single-threaded)
+  net->mFeedforwardBlock = mFeedforwardBlock;
+
   return net;
 }
 
 
 void Network::ReadNetwork(const char* pSrc) {
-  std::ifstream in(pSrc);
+  std::ifstream in(pSrc, std::ios::in | std::ios::binary);
   if(!in.good()) {
     KALDI_ERR << "Cannot read model: " << pSrc;
   }
@@ -170,7 +381,46 @@ void Network::ReadNetwork(const char* pSrc) {
 
   
 
+void Network::MapNetwork(const char* pSrc) {
+  int fd = open(pSrc, O_RDONLY);
+  if(fd < 0) {
+    KALDI_ERR << "Cannot read model: " << pSrc;
+  }
+  struct stat st;
+  char* p_data = NULL;
+  //only regular files with the binary model header are mapped
+  if(0 == fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 2) {
+    void* p_map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(p_map == MAP_FAILED) {
+      KALDI_WARN << "Cannot map model, reading it instead: " << pSrc;
+    } else if(static_cast<char*>(p_map)[0] != '\0') {
+      munmap(p_map, st.st_size);
+    } else {
+      p_data = static_cast<char*>(p_map);
+    }
+  }
+  close(fd);
+
+  if(NULL == p_data) {
+    ReadNetwork(pSrc);
+    return;
+  }
+  
+  if(NULL != mpMapData) {
+    KALDI_ERR << "Network already mapped a model";
+  }
+  mpMapData = p_data;
+  mMapSize = st.st_size;
+
+  MemoryIstream in(mpMapData, mMapSize);
+  ReadNetwork(in);
+}
+
+
 void Network::ReadNetwork(std::istream& rIn) {
+  //skip the header of binary models, 
+  //the binary matrices are detected by their readers
+  ReadBinaryModelHeader(rIn);
   //get the network elements from a factory
   Component *pComp;
   while(NULL != (pComp = ComponentFactory(rIn))) 
@@ -178,11 +428,14 @@ void Network::ReadNetwork(std::istream& rIn) {
 }
 
 
-void Network::WriteNetwork(const char* pDst) {
-  std::ofstream out(pDst);
+void Network::WriteNetwork(const char* pDst, bool binary) {
+  std::ofstream out(pDst, std::ios::out | std::ios::binary);
   if(!out.good()) {
     KALDI_ERR << "Cannot write model: " << pDst;
   }
+  if(binary) {
+    WriteBinaryModelHeader(out);
+  }
   WriteNetwork(out);
   out.close();
 }
@@ -14,6 +14,8 @@
 
 namespace TNet {
 
+class ParallelFeedforward;
+
 class Network
 {
 //////////////////////////////////////
@@ -29,7 +31,8 @@ typedef std::vector<Component*> LayeredType;
  public:
   // allow incomplete network creation
   Network()
-   : mGlobLearnRate(0) 
+   : mGlobLearnRate(0), mFeedforwardBlock(1024), mpParallel(NULL),
+     mpMapData(NULL), mMapSize(0)
   { }
 
   ~Network();
@@ -46,28 +49,66 @@ typedef std::vector<Component*> LayeredType;
   /// Feedforward the data per blocks, this needs less memory, 
   /// and allows to process very long files.
   /// It does not trim the *_frm_ext, but uses it 
-  /// for concatenation of segments
+  /// for concatenation of segments (inference only, see Forward)
   void Feedforward(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out, 
                    size_t start_frm_ext, size_t end_frm_ext);
+  /// set the block size of Feedforward, with threads > 1 the blocks 
+  /// are forwarded in parallel by clones of the network 
+  /// (the clones share the weights, inference only)
+  void SetFeedforward(size_t block, int threads = 1);
+  /// forward the rows [begin,begin+rows) of 'in' to the same rows of 'out',
+  /// the neighbouring rows (up to *_frm_ext) are used as the context,
+  /// 'buf' is a scratch buffer (a block of Feedforward)
+  void FeedforwardBlock(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out,
+                        size_t begin, size_t rows,
+                        size_t start_frm_ext, size_t end_frm_ext,
+                        Matrix<BaseFloat>& buf);
   /// forward the data to the output
   void Propagate(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out);
+  /// forward the data to the output in inference mode,
+  /// the layers don't keep their outputs (no Backpropagate possible),
+  /// the data go through two scratch buffers, the last layer writes to 'out'
+  void Forward(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out);
+  /// forward the data to the input of the final softmax, 
+  /// the softmax is left to the objective function (CrossEntropy::EvaluateLogits)
+  const Matrix<BaseFloat>& PropagateLogits(const Matrix<BaseFloat>& in);
   /// backpropagate the error while calculating the gradient
   void Backpropagate(const Matrix<BaseFloat>& globerr); 
 
-  /// accumulate the gradient from other networks
-  void AccuGradient(const Network& src, int thr, int thrN);
+  /// accumulate the gradients of other networks
+  /// (the part thr of thrN, one pass over the accumulators)
+  void AccuGradient(const std::vector<const Network*>& src, int thr, int thrN);
   /// update weights, reset the accumulator
   void Update(int thr, int thrN);
+  /// update the rows of part thr (of thrN) of the weights
+  /// by the gradient of src (asynchronous SGD, no accumulator)
+  void ApplyGradient(const Network& src, int thr, int thrN);
+
+  /// use a private copy of the weights (a clone shares them)
+  void DetachWeights();
+  /// accumulate the scaled weights of src, rows of part thr (of thrN)
+  void AccuWeights(const Network& src, double scale, int thr, int thrN);
+  /// replace the weights by the accumulated ones, reset the accumulator
+  void AverageWeights(int thr, int thrN);
+  /// copy the weights of src
+  void CopyWeights(const Network& src);
   
   Network* Clone(); ///< Clones the network
 
-  void ReadNetwork(const char* pSrc);     ///< read the network from file
+  void ReadNetwork(const char* pSrc);     ///< read the network from file (text or binary)
   void ReadNetwork(std::istream& rIn);    ///< read the network from stream
-  void WriteNetwork(const char* pDst);    ///< write network to file
+  /// read the network from file, the weights of binary models are used 
+  /// in place from the file mapped read-only (inference only, shared by 
+  /// the processes through the page cache), other models are read as usual
+  void MapNetwork(const char* pSrc);
+  void WriteNetwork(const char* pDst, bool binary = false); ///< write network to file
   void WriteNetwork(std::ostream& rOut);  ///< write network to stream
 
   size_t GetNInputs() const; ///< Dimensionality of the input features
   size_t GetNOutputs() const; ///< Dimensionality of the desired vectors
+  /// Number of past/future frames needed for one output frame, 
+  /// the sum over the <expand> components
+  void GetContext(size_t& rLeft, size_t& rRight) const;
 
   /// set the learning rate
   void SetLearnRate(BaseFloat learnRate, const char* pLearnRateFactors = NULL); 
@@ -75,11 +116,19 @@ typedef std::vector<Component*> LayeredType;
   void PrintLearnRate();     ///< log the learning rate values
 
   void SetWeightcost(BaseFloat l2); ///< set the L2 regularization const
+  void SetMomentum(BaseFloat mmt, bool nesterov = false); ///< set the momentum (sync update)
+  void ResetMomentum(); ///< zero the velocities of the momentum (after restoring the weights)
+  void SetFloatAccu(bool floatAccu); ///< sum the gradients in single precision (sync update)
 
   void ResetBunchsize(); ///< reset the frame counter (needed for L2 regularization
   void AccuBunchsize(const Network& src); ///< accumulate frame counts in bunch (needed in L2 regularization
 
  private:
+  /// Forward the data through the layers [0,end), 
+  /// <BiasedLinearity> followed by <sigmoid>/<tanh> is done in one pass
+  void PropagateLayers(const Matrix<BaseFloat>& in, size_t end);
+  /// Check if layer i can be fused with layer i+1 (i+1 < end)
+  bool IsFusable(size_t i, size_t end) const;
   /// Creates a component by reading from stream
   Component* ComponentFactory(std::istream& In);
   /// Dumps component into a stream
@@ -89,21 +138,21 @@ typedef std::vector<Component*> LayeredType;
   LayeredType mNnet; ///< container with the network layers
   BaseFloat mGlobLearnRate; ///< unscaled learning rate
 
+  Matrix<BaseFloat> mForwardBuf[2]; ///< ping-pong buffers for Forward()
+
+  size_t mFeedforwardBlock;         ///< block size of Feedforward()
+  ParallelFeedforward* mpParallel;  ///< workers of Feedforward() (threads > 1)
+  Matrix<BaseFloat> mFeedforwardBuf; ///< block output of Feedforward()
+
+  char* mpMapData;  ///< model file mapped by MapNetwork()
+  size_t mMapSize;
+
 };
   
 
 //////////////////////////////////////////////////////////////////////////
 // INLINE FUNCTIONS 
 // Network::
-inline Network::~Network() {
-  //delete all the components
-  LayeredType::iterator it;
-  for(it=mNnet.begin(); it!=mNnet.end(); ++it) {
-    delete *it;
-  }
-}
-
-    
 inline size_t Network::GetNInputs() const {
   assert(mNnet.size() > 0);
   return mNnet.front()->GetNInputs();
@@ -143,6 +192,51 @@ SetWeightcost(BaseFloat l2)
 }
 
 
+inline void
+Network::
+SetMomentum(BaseFloat mmt, bool nesterov)
+{
+  LayeredType::iterator it;
+  for(it=mNnet.begin(); it!=mNnet.end(); ++it) {
+    if((*it)->IsUpdatable()) {
+      UpdatableComponent* comp = dynamic_cast<UpdatableComponent*>(*it);
+      comp->Momentum(mmt);
+      comp->Nesterov(nesterov);
+    }
+  }
+}
+
+
+inline void
+Network::
+ResetMomentum()
+{
+  LayeredType::iterator it;
+  for(it=mNnet.begin(); it!=mNnet.end(); ++it) {
+    if((*it)->IsUpdatable()) {
+      UpdatableComponent* comp = dynamic_cast<UpdatableComponent*>(*it);
+      if(comp->Momentum() != 0.0) {
+        comp->LinearityMomentum().Zero();
+        comp->BiasMomentum().Zero();
+      }
+    }
+  }
+}
+
+
+inline void
+Network::
+SetFloatAccu(bool floatAccu)
+{
+  LayeredType::iterator it;
+  for(it=mNnet.begin(); it!=mNnet.end(); ++it) {
+    if((*it)->IsUpdatable()) {
+      dynamic_cast<UpdatableComponent*>(*it)->FloatAccu(floatAccu);
+    }
+  }
+}
+
+
 inline void 
 Network::
 ResetBunchsize()
@@ -166,7 +260,7 @@ AccuBunchsize(const Network& src)
     if(Layer(i).IsUpdatable()) {
       UpdatableComponent& tgt_comp = dynamic_cast<UpdatableComponent&>(Layer(i));
       const UpdatableComponent& src_comp = dynamic_cast<const UpdatableComponent&>(src.Layer(i));
-      tgt_comp.Bunchsize(tgt_comp.Bunchsize()+src_comp.GetOutput().Rows());
+      tgt_comp.Bunchsize(tgt_comp.Bunchsize()+src_comp.GetInput().Rows());
     }
   }
 }
@@ -81,6 +81,11 @@ inline int FindMaxId(const BaseFloat* ptr, size_t N) {
 void
 CrossEntropy::Evaluate(const Matrix<BaseFloat>& net_out, const Matrix<BaseFloat>& target, Matrix<BaseFloat>* err)
 {
+  if(sparse_targets_) {
+    EvaluateSparse(net_out,target,err);
+    return;
+  }
+
   if(net_out.Cols() != target.Cols()) {
     KALDI_ERR << "Nonmatching dim of data : net_out " << net_out.Cols()
               << " target " << target.Cols();
@@ -142,26 +147,71 @@ CrossEntropy::Evaluate(const Matrix<BaseFloat>& net_out, const Matrix<BaseFloat>
   //accumulate confusuion network
   if(confusion_mode_ != NO_CONF) {
     for(size_t r=0; r<net_out.Rows(); r++) {
-      int id_target = max_target_id[r];
-      int id_netout = max_netout_id[r];
-      switch(confusion_mode_) {
-        case MAX_CONF:
-          confusion_(id_target,id_netout) += 1;
-          break;
-        case SOFT_CONF:
-          confusion_[id_target].Add(net_out[r]);
-          break;
-        case DIAG_MAX_CONF:
-          diag_confusion_[id_target] += ((id_target==id_netout)?1:0);
-          break;
-        case DIAG_SOFT_CONF:
-          diag_confusion_[id_target] += net_out[r][id_target];
-          break;
-        default:
-          KALDI_ERR << "unknown confusion type" << confusion_mode_;
-      }
-      confusion_count_[id_target] += 1;
+      AccuConfusion(net_out[r].pData(),static_cast<int>(max_target_id[r]),static_cast<int>(max_netout_id[r]));
+    }
+  }
+
+  error_ -= sumerr;
+  frames_ += net_out.Rows();
+  corr_ += corr;
+}
+
+
+void
+CrossEntropy::PrepareSparse(const Matrix<BaseFloat>& net_out, const Matrix<BaseFloat>& target, Matrix<BaseFloat>* err)
+{
+  if(target.Cols() != 1) {
+    KALDI_ERR << "Sparse targets must have 1 column (class ids), got : " << target.Cols();
+  }
+
+  //check dimensions
+  assert(net_out.Rows() == target.Rows());
+  if(err->Rows() != net_out.Rows() || err->Cols() != net_out.Cols()) {
+    err->Init(net_out.Rows(),net_out.Cols());
+  }
+
+  //allocate confunsion buffers
+  if(confusion_mode_ != NO_CONF) {
+    if(confusion_.Rows() != net_out.Cols() || confusion_.Cols() != net_out.Cols()) {
+      confusion_.Init(net_out.Cols(),net_out.Cols());
+      confusion_count_.Init(net_out.Cols());
+      diag_confusion_.Init(net_out.Cols());
+    }
+  }
+}
+
+
+void
+CrossEntropy::EvaluateSparse(const Matrix<BaseFloat>& net_out, const Matrix<BaseFloat>& target, Matrix<BaseFloat>* err)
+{
+  PrepareSparse(net_out,target,err);
+
+  int corr = 0;
+  double sumerr = 0;
+  for(size_t r=0; r<net_out.Rows(); r++) {
+    int id_target = static_cast<int>(target(r,0));
+    if(id_target < 0 || id_target >= (int)net_out.Cols()) {
+      KALDI_ERR << "Target class id " << id_target 
+                << " out of range, net_out dim " << net_out.Cols();
+    }
+
+    //check correct classification
+    int id_netout = FindMaxId(net_out[r].pData(),net_out.Cols());
+    if(id_netout == id_target) corr++;
+    if(confusion_mode_ != NO_CONF) {
+      AccuConfusion(net_out[r].pData(),id_target,id_netout);
     }
+
+    //compute loss function
+    BaseFloat val = static_cast<BaseFloat>(log(net_out(r,id_target)));
+    if(val < -1e10f) val = -1e10f;
+    sumerr += val;
+
+    //compute global gradient (assuming on softmax input),
+    //subtract the one-hot target
+    BfSubVector err_r((*err)[r]);
+    err_r.Copy(net_out[r]);
+    err_r[id_target] -= 1.0f;
   }
 
   error_ -= sumerr;
@@ -170,6 +220,82 @@ CrossEntropy::Evaluate(const Matrix<BaseFloat>& net_out, const Matrix<BaseFloat>
 }
 
 
+void
+CrossEntropy::EvaluateLogits(const Matrix<BaseFloat>& logits, const Matrix<BaseFloat>& target, Matrix<BaseFloat>* err)
+{
+  if(!sparse_targets_) {
+    KALDI_ERR << "The fused softmax cross entropy requires sparse targets";
+  }
+  PrepareSparse(logits,target,err);
+
+  //all the work is done on one row of err, while it is in the cache
+  int corr = 0;
+  double sumerr = 0;
+  for(size_t r=0; r<logits.Rows(); r++) {
+    int id_target = static_cast<int>(target(r,0));
+    if(id_target < 0 || id_target >= (int)logits.Cols()) {
+      KALDI_ERR << "Target class id " << id_target 
+                << " out of range, net_out dim " << logits.Cols();
+    }
+
+    //softmax (as in Softmax::PropagateFnc)
+    BfSubVector y_r((*err)[r]);
+    y_r.Copy(logits[r]);
+    BaseFloat max = y_r.Max();
+    y_r.Subtract(max);
+    y_r.ApplyExp();
+    BaseFloat sum = y_r.Sum();
+    y_r.Scale(1.0f/sum);
+
+    //check correct classification
+    int id_netout = FindMaxId(y_r.pData(),y_r.Dim());
+    if(id_netout == id_target) corr++;
+    if(confusion_mode_ != NO_CONF) {
+      AccuConfusion(y_r.pData(),id_target,id_netout);
+    }
+
+    //compute loss function
+    BaseFloat val = static_cast<BaseFloat>(log(y_r[id_target]));
+    if(val < -1e10f) val = -1e10f;
+    sumerr += val;
+
+    //gradient: out - onehot
+    y_r[id_target] -= 1.0f;
+  }
+
+  error_ -= sumerr;
+  frames_ += logits.Rows();
+  corr_ += corr;
+}
+
+
+void
+CrossEntropy::AccuConfusion(const BaseFloat* net_out, int id_target, int id_netout)
+{
+  switch(confusion_mode_) {
+    case MAX_CONF:
+      confusion_(id_target,id_netout) += 1;
+      break;
+    case SOFT_CONF: {
+      BaseFloat* conf = confusion_[id_target].pData();
+      for(size_t c=0; c<confusion_.Cols(); c++) {
+        conf[c] += net_out[c];
+      }
+      break;
+    }
+    case DIAG_MAX_CONF:
+      diag_confusion_[id_target] += ((id_target==id_netout)?1:0);
+      break;
+    case DIAG_SOFT_CONF:
+      diag_confusion_[id_target] += net_out[id_target];
+      break;
+    default:
+      KALDI_ERR << "unknown confusion type" << confusion_mode_;
+  }
+  confusion_count_[id_target] += 1;
+}
+
+
 std::string CrossEntropy::Report() {
   std::stringstream ss;
   ss << "Xent:" << error_ << " frames:" << frames_
@@ -4,6 +4,7 @@
 #include <cassert>
 #include <limits>
 #include <cmath>
+#include <vector>
 
 #include "Matrix.h"
 #include "Vector.h"
@@ -109,7 +110,7 @@ namespace TNet {
 
    public:
     CrossEntropy()
-     : ObjectiveFunction(), frames_(0), error_(0), corr_(0), confusion_mode_(NO_CONF), output_label_map_(NULL)
+     : ObjectiveFunction(), frames_(0), error_(0), corr_(0), confusion_mode_(NO_CONF), output_label_map_(NULL), sparse_targets_(false)
     { }
 
     ~CrossEntropy()
@@ -138,9 +139,28 @@ namespace TNet {
     void SetOutputLabelMap(const char* map)
     { output_label_map_ = map; }
 
+    /// The targets are the class ids (one column),
+    /// instead of the dense desired matrix
+    void SetSparseTargets(bool sparse)
+    { sparse_targets_ = sparse; }
+
+    /// Fused softmax and cross entropy for sparse targets, 
+    /// the input are the softmax activations (see Network::PropagateLogits),
+    /// err receives the gradient on the softmax input
+    void EvaluateLogits(const Matrix<BaseFloat>& logits, const Matrix<BaseFloat>& target, Matrix<BaseFloat>* err);
+
     std::string Report();    
      
     void MergeStats(const ObjectiveFunction& inst);   
+   private:
+    /// Evaluate with the sparse targets
+    void EvaluateSparse(const Matrix<BaseFloat>& net_out, const Matrix<BaseFloat>& target, Matrix<BaseFloat>* err);
+
+    /// Check the sparse targets, allocate the buffers
+    void PrepareSparse(const Matrix<BaseFloat>& net_out, const Matrix<BaseFloat>& target, Matrix<BaseFloat>* err);
+    /// Accumulate the confusion statistics of one frame
+    void AccuConfusion(const BaseFloat* net_out, int id_target, int id_netout);
+
    private:
     size_t frames_;
     double error_;
@@ -151,6 +171,7 @@ namespace TNet {
     Vector<int> confusion_count_;
     Vector<double> diag_confusion_;
     const char* output_label_map_;
+    bool sparse_targets_;
   };
  
 
@@ -0,0 +1,89 @@
+#include "ParallelFeedforward.h"
+#include "Thread.h"
+
+namespace TNet {
+
+
+  /// Forwards the queued blocks by its clone of the network
+  class ParallelFeedforward::Worker : public Thread {
+    public:
+      Worker(Network& rNnet, BlockingQueue<Job>& rJobs,
+             Semaphore& rDone, Semaphore& rFinished)
+       : mpNnet(rNnet.Clone()), mJobs(rJobs), mDone(rDone), mFinished(rFinished)
+      { }
+
+      ~Worker()
+      { delete mpNnet; }
+
+    protected:
+      void Execute(void*)
+      {
+        Job job;
+        while(mJobs.Pop(job)) {
+          mpNnet->FeedforwardBlock(*job.in, *job.out, job.begin, job.rows,
+                                   job.start_frm_ext, job.end_frm_ext, mBuf);
+          mDone.Post();
+        }
+        mFinished.Post();
+      }
+
+    private:
+      Network* mpNnet;
+      Matrix<BaseFloat> mBuf;
+      BlockingQueue<Job>& mJobs;
+      Semaphore& mDone;
+      Semaphore& mFinished;
+  };
+
+
+
+  ParallelFeedforward::
+  ParallelFeedforward(Network& rNnet, int threads)
+   : mJobs(2*threads)
+  {
+    for(int i=0; i<threads; i++) {
+      mWorkers.push_back(new Worker(rNnet, mJobs, mDone, mFinished));
+      mWorkers.back()->Start(NULL);
+    }
+  }
+
+
+  ParallelFeedforward::
+  ~ParallelFeedforward()
+  {
+    //let the workers leave the loop
+    mJobs.Close();
+    for(size_t i=0; i<mWorkers.size(); i++) {
+      mFinished.Wait();
+    }
+    for(size_t i=0; i<mWorkers.size(); i++) {
+      delete mWorkers[i];
+    }
+  }
+
+
+  void
+  ParallelFeedforward::
+  Feedforward(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out,
+              const std::vector<size_t>& rBegin,
+              size_t start_frm_ext, size_t end_frm_ext)
+  {
+    assert(out.Rows() == in.Rows());
+    for(size_t i=0; i<rBegin.size(); i++) {
+      Job job;
+      job.in = &in;
+      job.out = &out;
+      job.begin = rBegin[i];
+      job.rows = (i+1 < rBegin.size() ? rBegin[i+1] : in.Rows()) - rBegin[i];
+      job.start_frm_ext = start_frm_ext;
+      job.end_frm_ext = end_frm_ext;
+      mJobs.Push(job);
+    }
+    //wait for all the blocks
+    for(size_t i=0; i<rBegin.size(); i++) {
+      mDone.Wait();
+    }
+  }
+
+
+} //namespace TNet
@@ -0,0 +1,54 @@
+#ifndef _PARALLEL_FEEDFORWARD_H_
+#define _PARALLEL_FEEDFORWARD_H_
+
+#include "Matrix.h"
+#include "Nnet.h"
+#include "Semaphore.h"
+#include "BlockingQueue.h"
+
+#include <vector>
+
+namespace TNet {
+
+
+  /**
+   * Pool of threads forwarding the blocks of Network::Feedforward,
+   * each thread has its own clone of the network (the weights are shared).
+   *
+   * The blocks are independent given the start/end context frames,
+   * the workers read the input blocks in place and write
+   * to disjoint rows of the output.
+   */
+  class ParallelFeedforward {
+    public:
+      ParallelFeedforward(Network& rNnet, int threads);
+      ~ParallelFeedforward();
+
+      /// Forward the blocks starting at the rows rBegin
+      /// (the last one ends at in.Rows()), 'out' must be initialized
+      void Feedforward(const Matrix<BaseFloat>& in, Matrix<BaseFloat>& out,
+                       const std::vector<size_t>& rBegin,
+                       size_t start_frm_ext, size_t end_frm_ext);
+
+    private:
+      /// One block of the input
+      struct Job {
+        const Matrix<BaseFloat>* in;
+        Matrix<BaseFloat>* out;
+        size_t begin;
+        size_t rows;
+        size_t start_frm_ext;
+        size_t end_frm_ext;
+      };
+
+      class Worker;
+
+      BlockingQueue<Job> mJobs;
+      Semaphore mDone;      ///< posted per forwarded block
+      Semaphore mFinished;  ///< posted per finished worker
+      std::vector<Worker*> mWorkers;
+  };
+
+} //namespace TNet
+
+#endif
@@ -15,10 +15,15 @@
 #include "Semaphore.h"
 #include "Barrier.h"
 #include "Thread.h"
+#include "BlockingQueue.h"
+#include "RingAllreduce.h"
+#include "ThreadPlacement.h"
 
 #include <vector>
-#include <list>
 #include <iterator>
+#include <utility>
+#include <algorithm>
+#include <limits>
 
 namespace TNet {
 
@@ -26,6 +31,14 @@ class PlatformThread;
 
 class Platform {
 
+public:
+  /// Synchronization of the training threads
+  typedef enum {
+    SYNC_MODE = 0, ///< gradients summed and applied together (barriers)
+    ASYNC_MODE,    ///< each thread applies its own gradient (no barriers)
+    AVERAGE_MODE   ///< local SGD per thread, models averaged periodically
+  } ParallelMode;
+
 /*
 * Variables to be initialized directly from the main function
 */
@@ -50,15 +63,29 @@ public:
   long int seed_;
   int feats_with_missing_labels_; 
 
+  int read_threads_;
+  bool shuffle_files_;
+  int queue_size_;
+  bool sparse_targets_;
+
+  ParallelMode parallel_mode_;
+  int max_staleness_; ///< async: max bunches a thread may be ahead of the slowest
+  int average_bunches_; ///< average: local bunches between the averagings
+  RingAllreduce* workers_; ///< average: ring of the training processes (NULL for one process)
+  ThreadPlacement placement_; ///< CPUs of the training threads
+  bool cache_data_; ///< keep the data read by the first RunTrain in RAM for the next ones
+
  /*
   * Variables to be used internally during the multi-threaded training
   */
  private:
-  Semaphore semaphore_read_;
+  typedef std::pair<Matrix<BaseFloat>*,Matrix<BaseFloat>*> FeaLabPair;
+  std::vector<FeatureRepository*> feature2_;
+  Mutex label_mutex_; ///< the readers share label_, indexed once
+  std::vector<BlockingQueue<FeaLabPair>*> read_queue_;
  
-  std::vector<std::list<Matrix<BaseFloat>*> > feature_buf_;
-  std::vector<std::list<Matrix<BaseFloat>*> > label_buf_;
-  std::vector<Mutex> mutex_buf_;
+  std::vector<BlockingQueue<FeaLabPair>*> train_queue_;
+  Semaphore semaphore_pop_;
 
   std::vector<Network*> nnet_transf2_;
 
@@ -69,7 +96,6 @@ public:
   std::vector<bool> sync_mask_;
 
   Barrier barrier_;
-  bool end_reading_;
   std::vector<Timer> tim_;
   std::vector<double> tim_accu_;
 
@@ -77,6 +103,20 @@ public:
   Semaphore semaphore_endtrain_;
   Semaphore semaphore_endtrain2_;
 
+  std::vector<Mutex*> part_mutex_; ///< async: one per row-part of the weights
+  std::vector<long> clock_;        ///< async: bunches done per thread
+  pthread_mutex_t clock_mutex_;
+  pthread_cond_t clock_cond_;
+
+  std::vector<long> avg_frames_;   ///< average: frames since the last averaging
+  Vector<double> avg_stats_;       ///< average: [frames, unfinished threads] of all the processes
+
+  std::vector<FeaLabPair> data_store_; ///< cache_data_: the delivered data, in delivery order
+  int data_store_missing_;             ///< cache_data_: units with missing labels
+  bool data_stored_;                   ///< cache_data_: data_store_ is complete
+
+  bool momentum_zeroed_; ///< the momentum buffers were zeroed, the velocity is kept for the next RunTrain
+
  public:
   Mutex cout_mutex_;
 
@@ -89,32 +129,79 @@ public:
      start_frm_ext_(0), end_frm_ext_(0), trace_(0),
      crossval_(false), seed_(0),
      feats_with_missing_labels_(0),
-     end_reading_(false), num_thr_(0)
-  { }
+     read_threads_(1), shuffle_files_(false),
+     queue_size_(50), sparse_targets_(false),
+     parallel_mode_(SYNC_MODE), max_staleness_(4), average_bunches_(8),
+     workers_(NULL), cache_data_(false),
+     num_thr_(0),
+     data_store_missing_(0), data_stored_(false),
+     momentum_zeroed_(false)
+  { 
+    pthread_mutex_init(&clock_mutex_, NULL);
+    pthread_cond_init(&clock_cond_, NULL);
+  }
 
   ~Platform()
   {
-    for(size_t i=0; i<nnet_transf2_.size(); i++) {
-      delete nnet_transf2_[i];
-    }
-    for(size_t i=0; i<nnet2_.size(); i++) {
-      delete nnet2_[i];
-    }
-    for(size_t i=0; i<obj_fun2_.size(); i++) {
-      delete obj_fun2_[i];
+    FreeRun();
+    for(size_t i=0; i<data_store_.size(); i++) {
+      delete data_store_[i].first;
+      delete data_store_[i].second;
     }
+    pthread_mutex_destroy(&clock_mutex_);
+    pthread_cond_destroy(&clock_cond_);
   }
  
-  /// Run the training using num_threads threads
+  /// Run the training using num_threads threads,
+  /// can be called again for the next epoch (the weights stay in nnet_,
+  /// the stats go to obj_fun_, which should be a fresh instance)
   void RunTrain(int num_threads);
 
  private:
-  /// The data-reading thread
+  /// Free the clones, queues and repositories of the previous RunTrain
+  void FreeRun();
+  /// Deliver the data from the readers to the training threads
   void ReadData();
+  /// Deliver the data stored by the previous RunTrain (cache_data_)
+  void ReadStoredData();
+  /// Wait for space in the train queues and push the data to the thread
+  void PushData(int thr, Matrix<BaseFloat>* fea, Matrix<BaseFloat>* lab);
+  /// Shuffle the order of the units by seed_
+  void ShuffleOrder(std::vector<size_t>& rOrder);
+  /// The data-reading thread
+  void Reader(int rd);
   /// The training thread
   void Thread(int thr);
+  /// Create the buffers of the training thread in the thread,
+  /// so they are allocated on its NUMA node (first touch)
+  void InitThread(int thr);
+  /// Zero the rows of part thr (of thrN) of the matrix
+  template<typename _ElemT>
+  static void ZeroPart(Matrix<_ElemT>& rM, int thr, int thrN);
+  /// Zero the elements of part thr (of thrN) of the vector
+  template<typename _ElemT>
+  static void ZeroPart(Vector<_ElemT>& rV, int thr, int thrN);
+
+  /// Sum the gradients of the active threads to nnet_, the thread
+  /// sums its part of the rows over all the clones (sync, call after a barrier)
+  void AccuGradients(int thr);
+
+  /// Apply the gradient of the thread to the shared weights (async)
+  void AsyncUpdate(int thr);
+  /// Count the bunch of the thread, wait while the thread is
+  /// more than max_staleness_ bunches ahead of the slowest one (async)
+  void AsyncTick(int thr);
+  /// The thread has no more data, wait for the other threads (async)
+  void AsyncFinish(int thr);
+
+  /// Average the models of the threads weighted by their frames
+  /// to nnet_ and copy it back (average, call after a barrier),
+  /// with workers_ the average is over all the processes;
+  /// returns true when all the threads of all the processes finished
+  bool AverageModels(int thr);
 
  friend class PlatformThread;
+ friend class PlatformReaderThread;
 };
 
 
@@ -139,39 +226,137 @@ class PlatformThread : public Thread {
 };
 
 
+/**
+ * Inherit Thread for the data-reading threads
+ */
+class PlatformReaderThread : public Thread {
+ public:
+  PlatformReaderThread(Platform* pf)
+   : platform_(*pf)
+  { }
+ 
+ private:
+  void Execute(void* arg) {
+    long long rd_id = reinterpret_cast<long long>(arg);
+    platform_.Reader(static_cast<int>(rd_id));
+  }
+   
+ private:
+  Platform& platform_;
+};
+
+
+
+
+
+void Platform::FreeRun() {
+  for(size_t i=0; i<nnet_transf2_.size(); i++) {
+    delete nnet_transf2_[i];
+  }
+  nnet_transf2_.clear();
+  for(size_t i=0; i<nnet2_.size(); i++) {
+    delete nnet2_[i];
+  }
+  nnet2_.clear();
+  for(size_t i=0; i<obj_fun2_.size(); i++) {
+    delete obj_fun2_[i];
+  }
+  obj_fun2_.clear();
+  for(size_t i=0; i<feature2_.size(); i++) {
+    delete feature2_[i];
+    delete read_queue_[i];
+  }
+  feature2_.clear();
+  read_queue_.clear();
+  for(size_t i=0; i<train_queue_.size(); i++) {
+    delete train_queue_[i];
+  }
+  train_queue_.clear();
+  for(size_t i=0; i<part_mutex_.size(); i++) {
+    delete part_mutex_[i];
+  }
+  part_mutex_.clear();
+}
 
 
 
 void Platform::RunTrain(int num_thr) {
   num_thr_ = num_thr;
 
+  //the previous run (epoch) left its clones and counters
+  FreeRun();
+  while(semaphore_endtrain_.TryWait() == 0) { }
+  while(semaphore_pop_.TryWait() == 0) { }
+  feats_with_missing_labels_ = 0;
+
   /*
    * Initialize parallel training
    */
-  feature_buf_.resize(num_thr);
-  label_buf_.resize(num_thr);
-  mutex_buf_.resize(num_thr);
+  for(int i=0; i<num_thr; i++) {
+    //the back-pressure is done in ReadData()
+    train_queue_.push_back(new BlockingQueue<FeaLabPair>(std::numeric_limits<size_t>::max()));
+  }
   cache_.resize(num_thr);
   sync_mask_.resize(num_thr);
   barrier_.SetThreshold(num_thr);
+  clock_.assign(num_thr,0);
+  avg_frames_.assign(num_thr,0);
+  avg_stats_.Init(2);
+  for(int i=0; i<num_thr; i++) {
+    part_mutex_.push_back(new Mutex);
+  }
 
   tim_.resize(num_thr);
-  tim_accu_.resize(num_thr,0.0);
+  tim_accu_.assign(num_thr,0.0);
 
   int bunchsize = bunchsize_/num_thr;
   int cachesize = (cachesize_/num_thr/bunchsize)*bunchsize;
   KALDI_COUT << "Bunchsize:" << bunchsize << "*" << num_thr << "=" << bunchsize*num_thr
             << " Cachesize:" << cachesize << "*" << num_thr << "=" << cachesize*num_thr << "\n";
+  if(parallel_mode_ == ASYNC_MODE && !crossval_) {
+    KALDI_COUT << "Asynchronous updates, max staleness: " << max_staleness_ << " bunches\n";
+  }
+  if(parallel_mode_ == AVERAGE_MODE && !crossval_) {
+    KALDI_COUT << "Model averaging after: " << average_bunches_ << " bunches";
+    if(NULL != workers_) {
+      KALDI_COUT << ", process " << workers_->Rank() << " of " << workers_->Size();
+    }
+    KALDI_COUT << "\n";
+  }
+  if(placement_.Cpu(0) >= 0) {
+    KALDI_COUT << "Threads on CPUs:";
+    for(int i=0; i<num_thr; i++) {
+      KALDI_COUT << " " << placement_.Cpu(i);
+    }
+    KALDI_COUT << " (" << placement_.Nodes() << " NUMA nodes)\n";
+  }
+  if(!crossval_) {
+    //allocate the accumulators and the momentum buffers before the
+    //threads use them, the threads zero their rows in InitThread()
+    //(the momentum buffers only in the first run)
+    for(int i=0; i<nnet_.Layers(); i++) {
+      if(nnet_.Layer(i).IsUpdatable()) {
+        UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(nnet_.Layer(i));
+        if(comp.FloatAccu()) {
+          comp.LinearityAccuFloat(false);
+        } else {
+          comp.LinearityAccu(false);
+        }
+        comp.BiasAccu();
+        if(comp.Momentum() != 0.0) {
+          comp.LinearityMomentum(momentum_zeroed_);
+          comp.BiasMomentum(momentum_zeroed_);
+        }
+      }
+    }
+  }
+  //the threads create their clones and caches in InitThread()
+  nnet_transf2_.resize(num_thr,NULL);
+  nnet2_.resize(num_thr,NULL);
+  obj_fun2_.resize(num_thr,NULL);
   for(int i=0; i<num_thr; i++) {
-    //clone transforms
-    nnet_transf2_.push_back(nnet_transf_.Clone()); 
-    //create cache
     cache_[i].Init(cachesize,bunchsize,seed_);
     cache_[i].Trace(trace_);
-    //clone networks
-    nnet2_.push_back(nnet_.Clone());
-    //clone objective function objects
-    obj_fun2_.push_back(obj_fun_->Clone());
     //enable threads to sync weights
     sync_mask_[i] = true;
   }
@@ -182,19 +367,28 @@ void Platform::RunTrain(int num_thr) {
   std::vector<PlatformThread*> threads;
   for(intptr_t i=0; i<num_thr; i++) {
     PlatformThread* t = new PlatformThread(this);
-    t->Start(reinterpret_cast<void*>(i));
+    t->Start(reinterpret_cast<void*>(i), placement_.Cpu(static_cast<int>(i)));
     threads.push_back(t);
   }
 
   /*
    * Read the training data
    */
-  ReadData();
+  if(data_stored_) {
+    ReadStoredData();
+  } else {
+    ReadData();
+  }
 
   /*
-   * Wait for training to finish
+   * Wait for all the training threads to finish
    */
-  semaphore_endtrain2_.Wait(); 
+  for(int i=0; i<num_thr; i++) {
+    semaphore_endtrain2_.Wait(); 
+  }
+  if(!crossval_) {
+    momentum_zeroed_ = true;
+  }
 
 }
 
@@ -204,66 +398,212 @@ void Platform::ReadData() try {
   cout_mutex_.Lock();  
   KALDI_COUT << "queuesize " << feature_.QueueSize() << "\n";
   cout_mutex_.Unlock();  
-  
+
+  //the reading units are single files or input/target pairs of files
+  int unit = label_.IsReady() ? 1 : 2;
+  size_t num_units = feature_.QueueSize() / unit;
+
+  //order of delivering the units
+  std::vector<size_t> order(num_units);
+  for(size_t i=0; i<num_units; i++) {
+    order[i] = i;
+  }
+  if(shuffle_files_) {
+    ShuffleOrder(order);
+  }
+
+  //several training processes, process r gets every workers-th unit
+  if(NULL != workers_ && !crossval_) {
+    size_t num_shard = 0;
+    for(size_t i=workers_->Rank(); i<num_units; i+=workers_->Size()) {
+      order[num_shard++] = order[i];
+    }
+    order.resize(num_shard);
+    num_units = num_shard;
+    cout_mutex_.Lock();  
+    KALDI_COUT << "units of process " << workers_->Rank() << ": " << num_units << "\n";
+    cout_mutex_.Unlock();  
+  }
+
+  //start the readers, reader rd gets every num_rd-th unit
+  int num_rd = std::max(1,read_threads_);
+  std::vector<PlatformReaderThread*> readers;
+  for(intptr_t rd=0; rd<num_rd; rd++) {
+    std::vector<size_t> positions;
+    for(size_t i=rd; i<num_units; i+=num_rd) {
+      for(int u=0; u<unit; u++) {
+        positions.push_back(order[i]*unit+u);
+      }
+    }
+    //own copy of the feature repository, the labels are shared
+    feature2_.push_back(new FeatureRepository(feature_));
+    feature2_.back()->Trace(trace_);
+    feature2_.back()->SelectRecords(positions);
+    read_queue_.push_back(new BlockingQueue<FeaLabPair>(std::max(1,queue_size_)));
+
+    readers.push_back(new PlatformReaderThread(this));
+    readers.back()->Start(reinterpret_cast<void*>(rd), -1, true);
+  }
+
+  //deliver the data in the order of 'order'
   int thr = 0;
-  for(feature_.Rewind();!feature_.EndOfList();feature_.MoveNext()) {
+  for(size_t n=0; n<num_units; n++) {
+    FeaLabPair fea_lab;
+    if(!read_queue_[n % num_rd]->Pop(fea_lab)) {
+      KALDI_ERR << "Reader " << n % num_rd << " finished prematurely";
+    }
+    Matrix<BaseFloat>* fea = fea_lab.first;
+    Matrix<BaseFloat>* lab = fea_lab.second;
+
+    //the labels were missing
+    if(NULL == fea) {
+      feats_with_missing_labels_++;
+      continue;
+    }
+
+    //keep a copy for the next run, the thread deletes its matrices
+    if(cache_data_) {
+      data_store_.push_back(FeaLabPair(new Matrix<BaseFloat>(*fea),
+                                       new Matrix<BaseFloat>(*lab)));
+    }
+
+    PushData(thr,fea,lab);
+
+    thr = (thr+1) % num_thr_;
+  }
+  if(cache_data_) {
+    data_store_missing_ = feats_with_missing_labels_;
+    data_stored_ = true;
+  }
+
+  //wait until the readers are finished
+  for(int rd=0; rd<num_rd; rd++) {
+    FeaLabPair fea_lab;
+    while(read_queue_[rd]->Pop(fea_lab)) { }
+    readers[rd]->Join();
+    delete readers[rd];
+  }
+
+  KALDI_COUT << "[Reading finished]\n" << std::flush; 
+  for(int i=0; i<num_thr_; i++) {
+    train_queue_[i]->Close();
+  }
+
+} catch (std::exception& rExc) {
+  KALDI_CERR << "Exception thrown" << std::endl;
+  KALDI_CERR << rExc.what() << std::endl;
+  exit(1);
+}
+
+void Platform::ReadStoredData() try {
+  cout_mutex_.Lock();  
+  KALDI_COUT << "stored units " << data_store_.size() << "\n";
+  cout_mutex_.Unlock();  
+
+  std::vector<size_t> order(data_store_.size());
+  for(size_t i=0; i<order.size(); i++) {
+    order[i] = i;
+  }
+  if(shuffle_files_) {
+    ShuffleOrder(order);
+  }
+
+  int thr = 0;
+  for(size_t n=0; n<order.size(); n++) {
+    const FeaLabPair& fea_lab = data_store_[order[n]];
+    PushData(thr, new Matrix<BaseFloat>(*fea_lab.first),
+                  new Matrix<BaseFloat>(*fea_lab.second));
+    thr = (thr+1) % num_thr_;
+  }
+  feats_with_missing_labels_ += data_store_missing_;
+
+  KALDI_COUT << "[Reading finished]\n" << std::flush; 
+  for(int i=0; i<num_thr_; i++) {
+    train_queue_[i]->Close();
+  }
+
+} catch (std::exception& rExc) {
+  KALDI_CERR << "Exception thrown" << std::endl;
+  KALDI_CERR << rExc.what() << std::endl;
+  exit(1);
+}
+
+void Platform::PushData(int thr, Matrix<BaseFloat>* fea, Matrix<BaseFloat>* lab) {
+  //wait while all the training threads have queue_size_ matrices,
+  //(the queue of a single thread cannot block the reading, 
+  //the threads wait for each other in the barrier)
+  while(1) {
+    size_t minsize = train_queue_[0]->Size();
+    for(int i=1; i<num_thr_; i++) {
+      minsize = std::min(minsize, train_queue_[i]->Size());
+    }
+    if(minsize < (size_t)std::max(1,queue_size_)) break;
+    semaphore_pop_.Wait();
+  }
+
+  train_queue_[thr]->Push(FeaLabPair(fea,lab));
+}
+
+void Platform::ShuffleOrder(std::vector<size_t>& rOrder) {
+  struct drand48_data rand_buf;
+  srand48_r(seed_,&rand_buf);
+  for(size_t i=rOrder.size(); i>1; i--) {
+    long int j;
+    lrand48_r(&rand_buf,&j);
+    std::swap(rOrder[i-1],rOrder[j%i]);
+  }
+}
+
+void Platform::Reader(int rd) try {
+  FeatureRepository& feature = *feature2_[rd];
+
+  for(feature.Rewind(); !feature.EndOfList(); feature.MoveNext()) {
     Matrix<BaseFloat>* fea = new Matrix<BaseFloat>;
     Matrix<BaseFloat>* lab = new Matrix<BaseFloat>;
 
     //read feature matrix
-    feature_.ReadFullMatrix(*fea);
+    feature.ReadFullMatrix(*fea);
 
     //read target matrix
     if(label_.IsReady()) {
-      //we will use LabelRepository as target matrix input
-      bool success = label_.GenDesiredMatrix(*lab,
-                              fea->Rows()-start_frm_ext_-end_frm_ext_,
-                              feature_.CurrentHeader().mSamplePeriod,
-                              feature_.Current().Logical().c_str());
+      //we will use LabelRepository as target matrix input,
+      //sparse targets are the class ids instead of the one-hot matrix
+      size_t frames = fea->Rows()-start_frm_ext_-end_frm_ext_;
+      size_t period = feature.CurrentHeader().mSamplePeriod;
+      const char* logical = feature.Current().Logical().c_str();
+      //the MLF stream is shared, a record is parsed at a time
+      label_mutex_.Lock();
+      bool success = sparse_targets_ ?
+        label_.GenTargetIds(*lab, frames, period, logical) :
+        label_.GenDesiredMatrix(*lab, frames, period, logical);
+      label_mutex_.Unlock();
       if(!success) {
-        delete fea;
-        feats_with_missing_labels_++;
+        delete fea; delete lab;
+        //keep the order of delivery
+        read_queue_[rd]->Push(FeaLabPair(NULL,NULL));
         continue;
       }
     } else {
       //we will use Feature/Target pairs from the FeatureRepository
-      std::string feature_name = feature_.Current().Logical();
+      std::string feature_name = feature.Current().Logical();
       //go to next file
-      feature_.MoveNext();
-      feature_.ReadFullMatrix(*lab);
+      feature.MoveNext();
+      feature.ReadFullMatrix(*lab);
       //check the dim
       if(fea->Rows()-start_frm_ext_-end_frm_ext_ != lab->Rows()) {
         KALDI_ERR << "Nonmatching number of rows,\n"
                   << "INPUT_ROWS=" << fea->Rows()-start_frm_ext_-end_frm_ext_ 
                   << " " << feature_name << "\n"
-                  << "TARGET_ROWS=" << lab->Rows() << " " << feature_.Current().Logical(); 
+                  << "TARGET_ROWS=" << lab->Rows() << " " << feature.Current().Logical(); 
       }
     }
     
-    fea->CheckData(feature_.Current().Logical());
-
-    mutex_buf_[thr].Lock();
-    feature_buf_[thr].push_back(fea);
-    label_buf_[thr].push_back(lab);
-    mutex_buf_[thr].Unlock();
+    fea->CheckData(feature.Current().Logical());
 
-    //suspend reading when shortest buffer has 50 matrices
-    if(thr == 0) {
-      int minsize=1e6;
-      for(size_t i=0; i<feature_buf_.size(); i++) {
-        mutex_buf_[i].Lock();
-        int s = feature_buf_[i].size();
-        mutex_buf_[i].Unlock();
-        if(s < minsize) minsize = s;
-      }
-      if(minsize > 50) semaphore_read_.Wait();
-    }
-
-    thr = (thr+1) % num_thr_;
+    read_queue_[rd]->Push(FeaLabPair(fea,lab));
   }
 
-  KALDI_COUT << "[Reading finished]\n" << std::flush; 
-  end_reading_ = true;
+  read_queue_[rd]->Close();
 
 } catch (std::exception& rExc) {
   KALDI_CERR << "Exception thrown" << std::endl;
@@ -275,35 +615,31 @@ void Platform::Thread(int thr_id) try {
 
   const int thr = thr_id; //make id const for safety!
 
+  //the threads use the clones of each other
+  InitThread(thr);
+  barrier_.Wait();//*********/
+
+  //with sparse targets the final softmax is evaluated with the objective function
+  CrossEntropy* xent_fused = NULL;
+  const Network& nnet = *nnet2_[thr];
+  if(sparse_targets_ && nnet.Layers() > 1 && 
+     nnet.Layer(nnet.Layers()-1).GetType() == Component::SOFTMAX) {
+    xent_fused = dynamic_cast<CrossEntropy*>(obj_fun2_[thr]);
+  }
+
+  //bunches since the last averaging
+  int local_bunches = 0;
+
   while(1) {
     //fill the cache
     while(!cache_[thr].Full()) {
-      //get the size of the feature buffer
-      mutex_buf_[thr].Lock();
-      size_t feature_buf_size = feature_buf_[thr].size();
-      mutex_buf_[thr].Unlock();
-      //no more data : END
-      if(end_reading_ && (feature_buf_size == 0)) break;
-      //little data? make sure the reader thread is awake
-      if(feature_buf_size <= 10) {
-        if(semaphore_read_.GetValue() <= 0) {
-          semaphore_read_.Post(); //wake the reader
-        }
-      }
-      //no data ready at the moment? : sleep 1s 
-      if(feature_buf_size == 0) {
-        cout_mutex_.Lock();  
-        KALDI_COUT << "Thread" << thr << ",waiting for data\n";
-        cout_mutex_.Unlock();  
-        sleep(1);
-      } else {
-        //get the matrices
-        mutex_buf_[thr].Lock();
-        Matrix<BaseFloat>* fea = feature_buf_[thr].front();
-        Matrix<BaseFloat>* lab = label_buf_[thr].front();
-        feature_buf_[thr].pop_front();
-        label_buf_[thr].pop_front();
-        mutex_buf_[thr].Unlock();
+      //get the matrices, wait for the reader if needed
+      FeaLabPair fea_lab;
+      if(!train_queue_[thr]->Pop(fea_lab)) break; //no more data : END
+      semaphore_pop_.Post(); //let the reader check the queue sizes
+      {
+        Matrix<BaseFloat>* fea = fea_lab.first;
+        Matrix<BaseFloat>* lab = fea_lab.second;
 
         //transform the features
         Matrix<BaseFloat> fea_transf;
@@ -338,10 +674,36 @@ void Platform::Thread(int thr_id) try {
     Matrix<BaseFloat> fea2,lab2,out,err;
     while(!cache_[thr].Empty()) {
       cache_[thr].GetBunch(fea2,lab2);
-      nnet2_[thr]->Propagate(fea2,out);
-      obj_fun2_[thr]->Evaluate(out,lab2,&err);
+      if(NULL != xent_fused) {
+        //softmax fused with the cross entropy
+        const Matrix<BaseFloat>& logits = nnet2_[thr]->PropagateLogits(fea2);
+        xent_fused->EvaluateLogits(logits,lab2,&err);
+      } else {
+        nnet2_[thr]->Propagate(fea2,out);
+        obj_fun2_[thr]->Evaluate(out,lab2,&err);
+      }
 
-      if(!crossval_) {
+      if(!crossval_ && parallel_mode_ == ASYNC_MODE) {
+        nnet2_[thr]->Backpropagate(err);
+        //update the shared weights, no barriers
+        AsyncUpdate(thr);
+         tim_[thr].Start();
+        AsyncTick(thr);
+         tim_[thr].End(); tim_accu_[thr] += tim_[thr].Val();
+      } else if(!crossval_ && parallel_mode_ == AVERAGE_MODE) {
+        nnet2_[thr]->Backpropagate(err);
+        //local SGD step on the own weights
+        nnet2_[thr]->ApplyGradient(*nnet2_[thr], 0, 1);
+        avg_frames_[thr] += fea2.Rows();
+        //average the models
+        if(++local_bunches >= average_bunches_) {
+          local_bunches = 0;
+           tim_[thr].Start();
+          barrier_.Wait();//*********/
+           tim_[thr].End(); tim_accu_[thr] += tim_[thr].Val();
+          AverageModels(thr);
+        }
+      } else if(!crossval_) {
         nnet2_[thr]->Backpropagate(err);
 
          tim_[thr].Start();
@@ -349,12 +711,7 @@ void Platform::Thread(int thr_id) try {
          tim_[thr].End(); tim_accu_[thr] += tim_[thr].Val();
        
         //sum the gradient and bunchsize
-        for(int i=0; i<num_thr_; i++) {
-          if(sync_mask_[i]) {
-            nnet_.AccuGradient(*nnet2_[i],thr,num_thr_);
-            if(thr == 0) nnet_.AccuBunchsize(*nnet2_[i]);
-          }
-        }
+        AccuGradients(thr);
 
          tim_[thr].Start();
         barrier_.Wait();//*********/
@@ -380,19 +737,26 @@ void Platform::Thread(int thr_id) try {
   sync_mask_[thr] = false;
   //increase number of finished threads
   semaphore_endtrain_.Post();
+
+  //async: the other threads update the weights by themselves
+  if(parallel_mode_ == ASYNC_MODE) {
+    AsyncFinish(thr);
+  }
+
+  //average: join the averagings of the other threads,
+  //the last one includes the rest of the local bunches
+  while(parallel_mode_ == AVERAGE_MODE) {
+    barrier_.Wait();//*********/
+    if(AverageModels(thr)) break;
+  }
    
   //synchronize the updates of other threads
-  while(1) {
+  while(parallel_mode_ == SYNC_MODE) {
     barrier_.Wait();//*********/
     if(semaphore_endtrain_.GetValue() == num_thr_) break;
         
     //sum the gradient and bunchsize
-    for(int i=0; i<num_thr_; i++) {
-      if(sync_mask_[i]) {
-        nnet_.AccuGradient(*nnet2_[i],thr,num_thr_);
-        if(thr == 0) nnet_.AccuBunchsize(*nnet2_[i]);
-      }
-    }
+    AccuGradients(thr);
     barrier_.Wait();//*********/
     //update
     nnet_.Update(thr,num_thr_);
@@ -408,7 +772,8 @@ void Platform::Thread(int thr_id) try {
     }
     
     cout_mutex_.Lock();
-    KALDI_COUT << "Barrier waiting times per thread\n"; 
+    KALDI_COUT << (parallel_mode_ == ASYNC_MODE ? "Staleness" : "Barrier") 
+               << " waiting times per thread\n"; 
     std::copy(tim_accu_.begin(),tim_accu_.end(),std::ostream_iterator<double>(KALDI_COUT," "));
     KALDI_COUT << "\n";
     cout_mutex_.Unlock();
@@ -418,9 +783,7 @@ void Platform::Thread(int thr_id) try {
   KALDI_COUT << "[Thread" << thr << " finished]\n";
   cout_mutex_.Unlock();
 
-  if(thr == 0) {
-    semaphore_endtrain2_.Post();
-  }
+  semaphore_endtrain2_.Post();
 } catch (std::exception& rExc) {
   KALDI_CERR << "Exception thrown" << std::endl;
   KALDI_CERR << rExc.what() << std::endl;
@@ -429,6 +792,163 @@ void Platform::Thread(int thr_id) try {
 
 
 
+template<typename _ElemT>
+void Platform::ZeroPart(Matrix<_ElemT>& rM, int thr, int thrN) {
+  int div = static_cast<int>(rM.Rows()) / thrN;
+  int mod = static_cast<int>(rM.Rows()) % thrN;
+  int origin = thr * div + ((mod > thr)? thr : mod);
+  int rows = div + ((mod > thr)? 1 : 0);
+  if(rows > 0) {
+    SubMatrix<_ElemT>(rM, origin, rows, 0, rM.Cols()).Zero();
+  }
+}
+
+
+template<typename _ElemT>
+void Platform::ZeroPart(Vector<_ElemT>& rV, int thr, int thrN) {
+  int div = static_cast<int>(rV.Dim()) / thrN;
+  int mod = static_cast<int>(rV.Dim()) % thrN;
+  int origin = thr * div + ((mod > thr)? thr : mod);
+  int dim = div + ((mod > thr)? 1 : 0);
+  if(dim > 0) {
+    rV.Range(origin, dim).Zero();
+  }
+}
+
+
+void Platform::InitThread(int thr) {
+  //clone transforms
+  nnet_transf2_[thr] = nnet_transf_.Clone(); 
+  //clone networks
+  nnet2_[thr] = nnet_.Clone();
+  //local SGD needs own weights (the cross-validation only reads them)
+  if(parallel_mode_ == AVERAGE_MODE && !crossval_) {
+    nnet2_[thr]->DetachWeights();
+  }
+  //clone objective function objects
+  obj_fun2_[thr] = obj_fun_->Clone();
+
+  //zero the rows of the accumulators the thread sums
+  //and of the new momentum buffers it updates
+  if(!crossval_) {
+    for(int i=0; i<nnet_.Layers(); i++) {
+      if(nnet_.Layer(i).IsUpdatable()) {
+        UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(nnet_.Layer(i));
+        if(comp.FloatAccu()) {
+          ZeroPart(comp.LinearityAccuFloat(), thr, num_thr_);
+        } else {
+          ZeroPart(comp.LinearityAccu(), thr, num_thr_);
+        }
+        if(comp.Momentum() != 0.0 && !momentum_zeroed_) {
+          ZeroPart(comp.LinearityMomentum(), thr, num_thr_);
+          ZeroPart(comp.BiasMomentum(), thr, num_thr_);
+        }
+      }
+    }
+  }
+}
+
+
+bool Platform::AverageModels(int thr) {
+  //frames since the last averaging and the unfinished threads
+  if(thr == 0) {
+    long frames = 0;
+    for(int i=0; i<num_thr_; i++) {
+      frames += avg_frames_[i];
+    }
+    avg_stats_[0] = static_cast<double>(frames);
+    avg_stats_[1] = num_thr_ - semaphore_endtrain_.GetValue();
+    if(NULL != workers_) workers_->Sum(avg_stats_);
+  }
+  barrier_.Wait();//*********/
+  double frames = avg_stats_[0];
+  bool last = (avg_stats_[1] == 0);
+
+  //sum the weights, frame-weighted
+  if(frames > 0) {
+    for(int i=0; i<num_thr_; i++) {
+      nnet_.AccuWeights(*nnet2_[i], static_cast<double>(avg_frames_[i])/frames, thr, num_thr_);
+    }
+  }
+  barrier_.Wait();//*********/
+  avg_frames_[thr] = 0;
+
+  //sum the weighted weights of the processes
+  if(NULL != workers_ && frames > 0) {
+    if(thr == 0) {
+      for(int i=0; i<nnet_.Layers(); i++) {
+        if(nnet_.Layer(i).IsUpdatable()) {
+          UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(nnet_.Layer(i));
+          workers_->Sum(comp.LinearityAccu());
+          workers_->Sum(comp.BiasAccu());
+        }
+      }
+    }
+    barrier_.Wait();//*********/
+  }
+
+  //set the average
+  if(frames > 0) {
+    nnet_.AverageWeights(thr, num_thr_);
+  }
+  barrier_.Wait();//*********/
+
+  //start from the average
+  if(frames > 0) {
+    nnet2_[thr]->CopyWeights(nnet_);
+  }
+  return last;
+}
+
+
+void Platform::AccuGradients(int thr) {
+  std::vector<const Network*> src;
+  for(int i=0; i<num_thr_; i++) {
+    if(sync_mask_[i]) {
+      src.push_back(nnet2_[i]);
+      if(thr == 0) nnet_.AccuBunchsize(*nnet2_[i]);
+    }
+  }
+  nnet_.AccuGradient(src,thr,num_thr_);
+}
+
+
+void Platform::AsyncUpdate(int thr) {
+  //the threads start at different parts of the rows,
+  //so they seldom wait for each other
+  for(int i=0; i<num_thr_; i++) {
+    int part = (thr + i) % num_thr_;
+    part_mutex_[part]->Lock();
+    nnet_.ApplyGradient(*nnet2_[thr], part, num_thr_);
+    part_mutex_[part]->Unlock();
+  }
+}
+
+
+void Platform::AsyncTick(int thr) {
+  pthread_mutex_lock(&clock_mutex_);
+  clock_[thr]++;
+  pthread_cond_broadcast(&clock_cond_);
+  while(clock_[thr] - *std::min_element(clock_.begin(),clock_.end()) > max_staleness_) {
+    pthread_cond_wait(&clock_cond_, &clock_mutex_);
+  }
+  pthread_mutex_unlock(&clock_mutex_);
+}
+
+
+void Platform::AsyncFinish(int thr) {
+  pthread_mutex_lock(&clock_mutex_);
+  //the finished thread does not hold back the others
+  clock_[thr] = std::numeric_limits<long>::max();
+  pthread_cond_broadcast(&clock_cond_);
+  while(*std::min_element(clock_.begin(),clock_.end()) != std::numeric_limits<long>::max()) {
+    pthread_cond_wait(&clock_cond_, &clock_mutex_);
+  }
+  pthread_mutex_unlock(&clock_mutex_);
+}
+
+
+
 }//namespace TNet
 
 #endif
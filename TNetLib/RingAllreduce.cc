@@ -0,0 +1,188 @@
+#include "RingAllreduce.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <sstream>
+
+namespace TNet {
+
+
+  /// Address of the socket of the process
+  static void SocketAddress(const std::string& rPrefix, int rank, sockaddr_un& rAddr)
+  {
+    std::ostringstream os;
+    os << rPrefix << "." << rank;
+    if(os.str().size() >= sizeof(rAddr.sun_path)) {
+      KALDI_ERR << "Socket path too long: " << os.str();
+    }
+    memset(&rAddr, 0, sizeof(rAddr));
+    rAddr.sun_family = AF_UNIX;
+    strcpy(rAddr.sun_path, os.str().c_str());
+  }
+
+
+  RingAllreduce::
+  RingAllreduce(const std::string& rSocketPrefix, int rank, int size)
+   : mRank(rank), mSize(size), mNext(-1), mPrev(-1)
+  {
+    if(mSize < 2 || mRank < 0 || mRank >= mSize) {
+      KALDI_ERR << "Bad process rank/count: " << mRank << "/" << mSize;
+    }
+
+    //listen for the previous process
+    sockaddr_un addr;
+    SocketAddress(rSocketPrefix, mRank, addr);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0) KALDI_ERR << "Cannot create socket";
+    unlink(addr.sun_path);
+    if(bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+      KALDI_ERR << "Cannot listen on: " << addr.sun_path << " " << strerror(errno);
+    }
+
+    //connect to the next process (it may not be listening yet)
+    sockaddr_un next_addr;
+    SocketAddress(rSocketPrefix, (mRank+1) % mSize, next_addr);
+    for(int attempt=0; ; attempt++) {
+      mNext = socket(AF_UNIX, SOCK_STREAM, 0);
+      if(mNext < 0) KALDI_ERR << "Cannot create socket";
+      if(connect(mNext, (sockaddr*)&next_addr, sizeof(next_addr)) == 0) break;
+      close(mNext);
+      if(attempt == 6000) {
+        KALDI_ERR << "Cannot connect to: " << next_addr.sun_path << " " << strerror(errno);
+      }
+      usleep(100000);
+    }
+
+    //accept the previous process
+    mPrev = accept(listener, NULL, NULL);
+    if(mPrev < 0) KALDI_ERR << "Cannot accept on: " << addr.sun_path;
+    close(listener);
+    unlink(addr.sun_path);
+
+    //non-blocking, SendRecv polls both directions
+    fcntl(mNext, F_SETFL, fcntl(mNext, F_GETFL) | O_NONBLOCK);
+    fcntl(mPrev, F_SETFL, fcntl(mPrev, F_GETFL) | O_NONBLOCK);
+  }
+
+
+  RingAllreduce::
+  ~RingAllreduce()
+  {
+    if(mNext >= 0) close(mNext);
+    if(mPrev >= 0) close(mPrev);
+  }
+
+
+  void
+  RingAllreduce::
+  Part(size_t rows, int part, size_t& rOrigin, size_t& rRows) const
+  {
+    size_t div = rows / mSize;
+    size_t mod = rows % mSize;
+    rOrigin = part * div + (((int)mod > part)? part : mod);
+    rRows = div + (((int)mod > part)? 1 : 0);
+  }
+
+
+  void
+  RingAllreduce::
+  Pack(const double* pData, size_t rows, size_t cols, size_t stride, 
+       std::vector<double>& rBuf) const
+  {
+    rBuf.resize(rows*cols + 1);
+    for(size_t r=0; r<rows; r++) {
+      memcpy(&rBuf[r*cols], pData + r*stride, cols*sizeof(double));
+    }
+  }
+
+
+  void
+  RingAllreduce::
+  Sum(double* pData, size_t rows, size_t cols, size_t stride)
+  {
+    //reduce-scatter: in step s, part (rank-s) goes to the next process,
+    //part (rank-s-1) comes from the previous one and is summed,
+    //finally the process holds the sum of the part (rank+1)
+    for(int s=0; s<mSize-1; s++) {
+      size_t send_org, send_rows, recv_org, recv_rows;
+      Part(rows, (mRank - s + mSize) % mSize, send_org, send_rows);
+      Part(rows, (mRank - s - 1 + mSize) % mSize, recv_org, recv_rows);
+      Pack(pData + send_org*stride, send_rows, cols, stride, mSendBuf);
+      mBuf.resize(recv_rows*cols + 1);
+      SendRecv(&mSendBuf[0], send_rows*cols*sizeof(double),
+               &mBuf[0], recv_rows*cols*sizeof(double));
+      for(size_t r=0; r<recv_rows; r++) {
+        double* p_dst = pData + (recv_org+r)*stride;
+        const double* p_src = &mBuf[r*cols];
+        for(size_t c=0; c<cols; c++) {
+          p_dst[c] += p_src[c];
+        }
+      }
+    }
+    //allgather: in step s, the summed part (rank+1-s) goes to the next process,
+    //part (rank-s) comes from the previous one
+    for(int s=0; s<mSize-1; s++) {
+      size_t send_org, send_rows, recv_org, recv_rows;
+      Part(rows, (mRank + 1 - s + mSize) % mSize, send_org, send_rows);
+      Part(rows, (mRank - s + mSize) % mSize, recv_org, recv_rows);
+      Pack(pData + send_org*stride, send_rows, cols, stride, mSendBuf);
+      mBuf.resize(recv_rows*cols + 1);
+      SendRecv(&mSendBuf[0], send_rows*cols*sizeof(double),
+               &mBuf[0], recv_rows*cols*sizeof(double));
+      for(size_t r=0; r<recv_rows; r++) {
+        memcpy(pData + (recv_org+r)*stride, &mBuf[r*cols], cols*sizeof(double));
+      }
+    }
+  }
+
+
+  void
+  RingAllreduce::
+  SendRecv(const void* pSend, size_t sendLen, void* pRecv, size_t recvLen)
+  {
+    const char* p_send = static_cast<const char*>(pSend);
+    char* p_recv = static_cast<char*>(pRecv);
+    size_t sent = 0, received = 0;
+    while(sent < sendLen || received < recvLen) {
+      pollfd fds[2];
+      int n = 0;
+      if(sent < sendLen) {
+        fds[n].fd = mNext; fds[n].events = POLLOUT; fds[n].revents = 0; n++;
+      }
+      if(received < recvLen) {
+        fds[n].fd = mPrev; fds[n].events = POLLIN; fds[n].revents = 0; n++;
+      }
+      if(poll(fds, n, -1) < 0) {
+        if(errno == EINTR) continue;
+        KALDI_ERR << "Error on poll: " << strerror(errno);
+      }
+      for(int i=0; i<n; i++) {
+        if(fds[i].revents == 0) continue;
+        if(fds[i].fd == mNext) {
+          ssize_t ret = send(mNext, p_send + sent, sendLen - sent, MSG_NOSIGNAL);
+          if(ret < 0 && errno != EAGAIN && errno != EINTR) {
+            KALDI_ERR << "Cannot send to the next process: " << strerror(errno);
+          }
+          if(ret > 0) sent += ret;
+        } else {
+          ssize_t ret = read(mPrev, p_recv + received, recvLen - received);
+          if(ret == 0) {
+            KALDI_ERR << "The previous process closed the connection";
+          }
+          if(ret < 0 && errno != EAGAIN && errno != EINTR) {
+            KALDI_ERR << "Cannot receive from the previous process: " << strerror(errno);
+          }
+          if(ret > 0) received += ret;
+        }
+      }
+    }
+  }
+
+
+} //namespace TNet
@@ -0,0 +1,67 @@
+#ifndef _RING_ALLREDUCE_H_
+#define _RING_ALLREDUCE_H_
+
+#include "Matrix.h"
+#include "Vector.h"
+
+#include <string>
+#include <vector>
+
+namespace TNet {
+
+  /**
+   * Sum of matrices over the training processes (ring-allreduce),
+   * the processes are connected to a ring by Unix domain sockets,
+   * process r listens on "<prefix>.r" and sends to process r+1.
+   *
+   * The rows are split to Size() parts as the threads split them
+   * in AccuGradient/Update: in the reduce-scatter each process
+   * sums one part, in the allgather the summed parts go around the ring.
+   * Each process sends 2*(Size()-1)/Size() of the data.
+   */
+  class RingAllreduce {
+    public:
+      /// Connect to the ring (waits for the neighbours)
+      RingAllreduce(const std::string& rSocketPrefix, int rank, int size);
+      ~RingAllreduce();
+
+      int Rank() const
+      { return mRank; }
+      int Size() const
+      { return mSize; }
+
+      /// Sum the matrix over the processes (in place)
+      void Sum(Matrix<double>& rM)
+      { Sum(rM.pData(), rM.Rows(), rM.Cols(), rM.Stride()); }
+      /// Sum the vector over the processes (in place)
+      void Sum(Vector<double>& rV)
+      { Sum(rV.pData(), rV.Dim(), 1, 1); }
+
+    private:
+      /// Sum the rows over the processes, the padding of the rows 
+      /// (stride-cols) is neither sent nor summed
+      void Sum(double* pData, size_t rows, size_t cols, size_t stride);
+      /// Copy the rows without the padding to rBuf
+      void Pack(const double* pData, size_t rows, size_t cols, size_t stride, 
+                std::vector<double>& rBuf) const;
+      /// Send to the next process while receiving from the previous one
+      void SendRecv(const void* pSend, size_t sendLen, void* pRecv, size_t recvLen);
+      /// Rows of the part (as in AccuGradient)
+      void Part(size_t rows, int part, size_t& rOrigin, size_t& rRows) const;
+
+      /// the socket cannot be copied
+      RingAllreduce(const RingAllreduce&);
+      RingAllreduce& operator=(const RingAllreduce&);
+
+    private:
+      int mRank;
+      int mSize;
+      int mNext;  ///< socket to the next process
+      int mPrev;  ///< socket from the previous process
+      std::vector<double> mBuf;     ///< received part
+      std::vector<double> mSendBuf; ///< packed part to send
+  };
+
+} //namespace TNet
+
+#endif
@@ -96,24 +96,31 @@ ReadFromStream(std::istream& rIn)
               << " Intances:" << mNInstances;
   }
     
-  //matrix is stored transposed as SNet does
-  BfMatrix transpose;
-  rIn >> transpose;
-  mLinearity = BfMatrix(transpose, TRANS);
+  //matrix is stored transposed as SNet does,
+  //the binary records of a mapped model are used in place (read-only)
+  if(NULL != (mpMappedLinearity = MapTransposed<BaseFloat>(rIn))) {
+    mpLinearity = mpMappedLinearity;
+  } else {
+    ReadTransposed(rIn, mLinearity);
+  }
   //biases stored normally
-  rIn >> mBias;
+  if(NULL != (mpMappedBias = MapVector<BaseFloat>(rIn))) {
+    mpBias = mpMappedBias;
+  } else {
+    rIn >> mBias;
+  }
 
-  if(transpose.Cols()*transpose.Rows() == 0) {
+  if(mpLinearity->Cols()*mpLinearity->Rows() == 0) {
     KALDI_ERR << "Missing linearity matrix in network file";
   }
-  if(mBias.Dim() == 0) {
+  if(mpBias->Dim() == 0) {
     KALDI_ERR << "Missing bias vector in network file";
   }
 
 
-  if(mLinearity.Cols() != (GetNOutputs() / mNInstances) || 
-     mLinearity.Rows() != (GetNInputs() / mNInstances) ||
-     mBias.Dim() != (GetNOutputs() / mNInstances)
+  if(mpLinearity->Cols() != (GetNOutputs() / mNInstances) || 
+     mpLinearity->Rows() != (GetNInputs() / mNInstances) ||
+     mpBias->Dim() != (GetNOutputs() / mNInstances)
   ){
     KALDI_ERR << "Wrong dimensionalities of matrix/vector in network file\n"
               << "Inputs:" << GetNInputs()
@@ -121,14 +128,14 @@ ReadFromStream(std::istream& rIn)
               << "\n"
               << "N-Instances:" << mNInstances
               << "\n"
-              << "linearityCols:" << mLinearity.Cols() << "(" << mLinearity.Cols()*mNInstances << ")"
-              << " linearityRows:" << mLinearity.Rows() << "(" << mLinearity.Rows()*mNInstances << ")"
-              << " biasDims:" << mBias.Dim() << "(" << mBias.Dim()*mNInstances << ")"
+              << "linearityCols:" << mpLinearity->Cols() << "(" << mpLinearity->Cols()*mNInstances << ")"
+              << " linearityRows:" << mpLinearity->Rows() << "(" << mpLinearity->Rows()*mNInstances << ")"
+              << " biasDims:" << mpBias->Dim() << "(" << mpBias->Dim()*mNInstances << ")"
               << "\n";
   }
 
-  mLinearityCorrection.Init(mLinearity.Rows(),mLinearity.Cols());
-  mBiasCorrection.Init(mBias.Dim());
+  mLinearityCorrection.Init(mpLinearity->Rows(),mpLinearity->Cols());
+  mBiasCorrection.Init(mpBias->Dim());
 }
 
  
@@ -138,10 +145,9 @@ WriteToStream(std::ostream& rOut)
 {
   rOut << mNInstances << std::endl;
   //matrix is stored transposed as SNet does
-  BfMatrix transpose(mLinearity, TRANS);
-  rOut << transpose;
+  WriteTransposed(rOut, *mpLinearity);
   //biases stored normally
-  rOut << mBias;
+  rOut << *mpBias;
   rOut << std::endl;
 }
 
@@ -171,17 +177,35 @@ Gradient()
 
 void 
 SharedLinearity::
-AccuGradient(const UpdatableComponent& src, int thr, int thrN)
+AccuGradient(const std::vector<const UpdatableComponent*>& src, int thr, int thrN)
 {
-  //cast the argument
-  const SharedLinearity& src_comp = dynamic_cast<const SharedLinearity&>(src);
-
   //allocate accumulators when needed
-  if(mLinearityCorrectionAccu.MSize() == 0) {
-    mLinearityCorrectionAccu.Init(mpLinearity->Rows(),mpLinearity->Cols());
+  if(mFloatAccu) {
+    LinearityAccuFloat();
+  } else {
+    LinearityAccu();
   }
-  if(mBiasCorrectionAccu.MSize() == 0) {
-    mBiasCorrectionAccu.Init(mpBias->Dim());
+  BiasAccu();
+
+  //cast the arguments
+  std::vector<const Matrix<BaseFloat>*> src_mat(src.size());
+  for(size_t s=0; s<src.size(); s++) {
+    src_mat[s] = &dynamic_cast<const SharedLinearity&>(*src[s]).mLinearityCorrection;
+  }
+
+  //the thread sums its part of the bias correction
+  int bdiv = static_cast<int>(mBiasCorrection.Dim()) / thrN;
+  int bmod = static_cast<int>(mBiasCorrection.Dim()) % thrN;
+
+  int borigin = thr * bdiv + ((bmod > thr)? thr : bmod);
+  int bdim = bdiv + ((bmod > thr)? 1 : 0);
+
+  for(size_t s=0; s<src.size(); s++) {
+    const BaseFloat* p_src = dynamic_cast<const SharedLinearity&>(*src[s]).mBiasCorrection.pData() + borigin;
+    double* p_tgt = mBiasCorrectionAccu.pData() + borigin;
+    for(int i=0; i<bdim; i++) {
+      p_tgt[i] += p_src[i];
+    }
   }
  
 
@@ -205,63 +229,256 @@ AccuGradient(const UpdatableComponent& src, int thr, int thrN)
 
   //KALDI_COUT << "[S" << thr << "," << origin << "," << rows << "]" << std::flush;
 
-  //create the matrix windows
+  //sum the rows of all the sources in one pass
+  if(mFloatAccu) {
+    SubMatrix<BaseFloat> tgt_mat (
+      mLinearityCorrectionAccuFloat, 
+      origin, rows, 
+      0, mLinearityCorrection.Cols()
+    );
+    AddRowsKahan(tgt_mat,src_mat,origin);
+  } else {
+    SubMatrix<double> tgt_mat (
+      mLinearityCorrectionAccu, 
+      origin, rows, 
+      0, mLinearityCorrection.Cols()
+    );
+    AddRows(tgt_mat,src_mat,origin);
+  }
+}
+
+
+template<typename _ElemT>
+void
+SharedLinearity::
+UpdateRows(const Matrix<_ElemT>& rGrad, SubMatrix<BaseFloat>& rTgt, int origin, BaseFloat rate)
+{
+  //the momentum step is normalized by the gain 1/(1-mmt)
+  //as in the CUDA components
+  if(mMomentum != 0.0) {
+    assert(mLinearityMomentum.Rows() == mLinearity.Rows());
+    for(size_t r=0; r<rTgt.Rows(); r++) {
+      MomentumStep(rTgt.pRowData(r), mLinearityMomentum.pRowData(origin+r), 
+                   rGrad.pRowData(r), rTgt.Cols(), rate*(1.0f-mMomentum));
+    }
+  } else {
+    AddScaled(rTgt, rGrad, -rate);
+  }
+}
+
+
+void 
+SharedLinearity::
+Update(int thr, int thrN) 
+{
+  CheckWritable(__func__);
+  //the thread updates its part of the bias
+  int bdiv = static_cast<int>(mBias.Dim()) / thrN;
+  int bmod = static_cast<int>(mBias.Dim()) % thrN;
+
+  int borigin = thr * bdiv + ((bmod > thr)? thr : bmod);
+  int bdim = bdiv + ((bmod > thr)? 1 : 0);
+
+  if(bdim > 0) {
+    SubVector<double> src_vec(mBiasCorrectionAccu, borigin, bdim);
+    SubVector<BaseFloat> tgt_vec(mBias, borigin, bdim);
+    if(mMomentum != 0.0) {
+      assert(mBiasMomentum.Dim() == mBias.Dim());
+      MomentumStep(tgt_vec.pData(), mBiasMomentum.pData()+borigin, src_vec.pData(), bdim,
+                   mLearningRate/static_cast<BaseFloat>(mNInstances)*(1.0f-mMomentum));
+    } else {
+      AddScaled(tgt_vec, src_vec, -mLearningRate/static_cast<BaseFloat>(mNInstances));
+    }
+    src_vec.Zero();
+  }
+
+  //need to find out which rows to sum...
+  int div = mLinearity.Rows() / thrN;
+  int mod = mLinearity.Rows() % thrN;
+
+  int origin = thr * div + ((mod > thr)? thr : mod);
+  int rows = div + ((mod > thr)? 1 : 0);
+
+  //we may have more threads than lines in a matrix
+  if(rows == 0) return;
+
+  //KALDI_COUT << "[P" << thr << "," << origin << "," << rows << "]" << std::flush;
+
+  //get the matrix window
+  SubMatrix<BaseFloat> tgt_mat (
+    mLinearity, 
+    origin, rows, 
+    0, mLinearityCorrection.Cols()
+  );
+
+  //TODO perform L2 regularization
+  //tgt_mat.AddScaled(tgt_mat, -mWeightcost * num_frames);
+
+  //update weights by the accumulated gradient, reset the accumulator
+  if(mFloatAccu) {
+    SubMatrix<BaseFloat> src_mat (
+      mLinearityCorrectionAccuFloat, 
+      origin, rows, 
+      0, mLinearityCorrection.Cols()
+    );
+    UpdateRows(src_mat, tgt_mat, origin, mLearningRate/static_cast<BaseFloat>(mNInstances));
+    src_mat.Zero();
+  } else {
+    SubMatrix<double> src_mat (
+      mLinearityCorrectionAccu, 
+      origin, rows, 
+      0, mLinearityCorrection.Cols()
+    );
+    UpdateRows(src_mat, tgt_mat, origin, mLearningRate/static_cast<BaseFloat>(mNInstances));
+    src_mat.Zero();
+  }
+}
+
+
+void 
+SharedLinearity::
+ApplyGradient(const UpdatableComponent& src, int thr, int thrN) 
+{
+  CheckWritable(__func__);
+  //cast the argument
+  const SharedLinearity& src_comp = dynamic_cast<const SharedLinearity&>(src);
+
+  //need to find out which rows to update...
+  int div = static_cast<int>(mLinearity.Rows()) / thrN;
+  int mod = static_cast<int>(mLinearity.Rows()) % thrN;
+
+  int origin = thr * div + ((mod > thr)? thr : mod);
+  int rows = div + ((mod > thr)? 1 : 0);
+
+  //we may have more parts than lines in a matrix
+  if(rows == 0) return;
+
+  //get the matrix windows
   const SubMatrix<BaseFloat> src_mat (
     src_comp.mLinearityCorrection, 
     origin, rows, 
-    0, mLinearityCorrection.Cols()
+    0, mLinearity.Cols()
+  );
+  SubMatrix<BaseFloat> tgt_mat (
+    mLinearity, 
+    origin, rows, 
+    0, mLinearity.Cols()
+  );
+
+  //update weights
+  tgt_mat.AddScaled(-mLearningRate/static_cast<BaseFloat>(mNInstances), src_mat);
+
+  //first part always updates bias
+  if(thr == 0) {
+    mBias.AddScaled(-mLearningRate/static_cast<BaseFloat>(mNInstances), src_comp.mBiasCorrection);
+  }
+}
+
+
+void
+SharedLinearity::
+DetachWeights()
+{
+  //copy the weights we were pointing to
+  if(mpLinearity != &mLinearity) {
+    mLinearity = *mpLinearity;
+    mpLinearity = &mLinearity;
+  }
+  if(mpBias != &mBias) {
+    mBias = *mpBias;
+    mpBias = &mBias;
+  }
+}
+
+
+void
+SharedLinearity::
+CheckWritable(const char* pFnc) const
+{
+  if(mpLinearity == mpMappedLinearity || mpBias == mpMappedBias) {
+    KALDI_ERR << pFnc << ": the weights of " << GetName() 
+              << " are mapped read-only from the model file (MapNetwork), "
+              << "load the model by ReadNetwork to train it";
+  }
+}
+
+
+void
+SharedLinearity::
+AccuWeights(const UpdatableComponent& src, double scale, int thr, int thrN)
+{
+  CheckWritable(__func__);
+  //cast the argument
+  const SharedLinearity& src_comp = dynamic_cast<const SharedLinearity&>(src);
+
+  //allocate accumulators when needed
+  LinearityAccu();
+  BiasAccu();
+
+  //need to find out which rows to sum...
+  int div = static_cast<int>(mLinearity.Rows()) / thrN;
+  int mod = static_cast<int>(mLinearity.Rows()) % thrN;
+
+  int origin = thr * div + ((mod > thr)? thr : mod);
+  int rows = div + ((mod > thr)? 1 : 0);
+
+  //we may have more threads than lines in a matrix
+  if(rows == 0) return;
+
+  //create the matrix windows
+  const SubMatrix<BaseFloat> src_mat (
+    *src_comp.mpLinearity, 
+    origin, rows, 
+    0, mLinearity.Cols()
   );
   SubMatrix<double> tgt_mat (
     mLinearityCorrectionAccu, 
     origin, rows, 
-    0, mLinearityCorrection.Cols()
+    0, mLinearity.Cols()
   );
-  //sum the rows
-  Add(tgt_mat,src_mat);
+  //sum the scaled rows
+  AddScaled(tgt_mat, src_mat, scale);
 
-  //first thread will always sum the bias correction and adds frame count
+  //first thread will always sum the bias
   if(thr == 0) {
-    //KALDI_COUT << "[BS" << thr << "]" << std::flush;
-    Add(mBiasCorrectionAccu,src_comp.mBiasCorrection);
+    AddScaled(mBiasCorrectionAccu, *src_comp.mpBias, scale);
   }
 }
 
 
-void 
+void
 SharedLinearity::
-Update(int thr, int thrN) 
+AverageWeights(int thr, int thrN)
 {
-  //need to find out which rows to sum...
-  int div = mLinearity.Rows() / thrN;
-  int mod = mLinearity.Rows() % thrN;
+  CheckWritable(__func__);
+  //need to find out which rows to set...
+  int div = static_cast<int>(mLinearity.Rows()) / thrN;
+  int mod = static_cast<int>(mLinearity.Rows()) % thrN;
 
   int origin = thr * div + ((mod > thr)? thr : mod);
   int rows = div + ((mod > thr)? 1 : 0);
 
-  //KALDI_COUT << "[P" << thr << "," << origin << "," << rows << "]" << std::flush;
+  //we may have more threads than lines in a matrix
+  if(rows == 0) return;
 
   //get the matrix windows
   SubMatrix<double> src_mat (
     mLinearityCorrectionAccu, 
     origin, rows, 
-    0, mLinearityCorrection.Cols()
+    0, mLinearity.Cols()
   );
   SubMatrix<BaseFloat> tgt_mat (
     mLinearity, 
     origin, rows, 
-    0, mLinearityCorrection.Cols()
+    0, mLinearity.Cols()
   );
 
-  //TODO perform L2 regularization
-  //tgt_mat.AddScaled(tgt_mat, -mWeightcost * num_frames);
-
-  //update weights
-  AddScaled(tgt_mat, src_mat, -mLearningRate/static_cast<BaseFloat>(mNInstances));
+  //set the averaged weights
+  tgt_mat.Copy(src_mat);
 
-  //first thread always update bias
+  //first thread always sets bias
   if(thr == 0) {
-    //KALDI_COUT << "[" << thr << "BP]" << std::flush;
-    AddScaled(mBias, mBiasCorrectionAccu, -mLearningRate/static_cast<BaseFloat>(mNInstances));
+    mBias.Copy(mBiasCorrectionAccu);
   }
 
   //reset the accumulators
@@ -271,5 +488,75 @@ Update(int thr, int thrN)
   }
 }
 
+
+void
+SharedLinearity::
+CopyWeights(const UpdatableComponent& src)
+{
+  CheckWritable(__func__);
+  //cast the argument
+  const SharedLinearity& src_comp = dynamic_cast<const SharedLinearity&>(src);
+
+  //the weights must be detached
+  assert(mpLinearity == &mLinearity && mpBias == &mBias);
+  mLinearity.Copy(*src_comp.mpLinearity);
+  mBias.Copy(*src_comp.mpBias);
+}
+
  
+Matrix<double>&
+SharedLinearity::
+LinearityAccu(bool clear)
+{
+  if(mLinearityCorrectionAccu.MSize() == 0) {
+    mLinearityCorrectionAccu.Init(mpLinearity->Rows(),mpLinearity->Cols(),clear);
+  }
+  return mLinearityCorrectionAccu;
+}
+
+
+Vector<double>&
+SharedLinearity::
+BiasAccu()
+{
+  if(mBiasCorrectionAccu.MSize() == 0) {
+    mBiasCorrectionAccu.Init(mpBias->Dim());
+  }
+  return mBiasCorrectionAccu;
+}
+
+
+Matrix<BaseFloat>&
+SharedLinearity::
+LinearityAccuFloat(bool clear)
+{
+  if(mLinearityCorrectionAccuFloat.MSize() == 0) {
+    mLinearityCorrectionAccuFloat.Init(mpLinearity->Rows(),mpLinearity->Cols(),clear);
+  }
+  return mLinearityCorrectionAccuFloat;
+}
+
+
+Matrix<BaseFloat>&
+SharedLinearity::
+LinearityMomentum(bool clear)
+{
+  if(mLinearityMomentum.MSize() == 0) {
+    mLinearityMomentum.Init(mpLinearity->Rows(),mpLinearity->Cols(),clear);
+  }
+  return mLinearityMomentum;
+}
+
+
+Vector<BaseFloat>&
+SharedLinearity::
+BiasMomentum(bool clear)
+{
+  if(mBiasMomentum.MSize() == 0) {
+    mBiasMomentum.Init(mpBias->Dim(),clear);
+  }
+  return mBiasMomentum;
+}
+
+
 } //namespace
@@ -33,22 +33,51 @@ class SharedLinearity : public UpdatableComponent
   /// calculate gradient
   void Gradient(); 
   /// accumulate gradient from other components
-  void AccuGradient(const UpdatableComponent& src, int thr, int thrN);
+  void AccuGradient(const std::vector<const UpdatableComponent*>& src, int thr, int thrN);
   /// update weights, reset the accumulator
   void Update(int thr, int thrN);
+  /// update the weights by the gradient of src directly
+  void ApplyGradient(const UpdatableComponent& src, int thr, int thrN);
+
+  /// model averaging (see UpdatableComponent)
+  void DetachWeights();
+  void AccuWeights(const UpdatableComponent& src, double scale, int thr, int thrN);
+  void AverageWeights(int thr, int thrN);
+  void CopyWeights(const UpdatableComponent& src);
+
+  Matrix<double>& LinearityAccu(bool clear = true);
+  Vector<double>& BiasAccu();
+  Matrix<BaseFloat>& LinearityAccuFloat(bool clear = true);
+  Matrix<BaseFloat>& LinearityMomentum(bool clear = true);
+  Vector<BaseFloat>& BiasMomentum(bool clear = true);
+
+ private:
+  /// update the rows of the weights by the accumulated gradient
+  template<typename _ElemT>
+  void UpdateRows(const Matrix<_ElemT>& rGrad, SubMatrix<BaseFloat>& rTgt, int origin, BaseFloat rate);
+  /// the weights mapped from a model file are read-only (Network::MapNetwork)
+  void CheckWritable(const char* pFnc) const;
 
 protected:
   Matrix<BaseFloat> mLinearity;  ///< Matrix with neuron weights
   Vector<BaseFloat> mBias;       ///< Vector with biases
 
-  Matrix<BaseFloat>* mpLinearity;
-  Vector<BaseFloat>* mpBias;
+  const Matrix<BaseFloat>* mpLinearity;
+  const Vector<BaseFloat>* mpBias;
+
+  const SubMatrix<BaseFloat>* mpMappedLinearity; ///< weights used in place from a mapped model (read-only)
+  const SubVector<BaseFloat>* mpMappedBias;      ///< ...
 
   Matrix<BaseFloat> mLinearityCorrection; ///< Matrix for linearity updates
   Vector<BaseFloat> mBiasCorrection;      ///< Vector for bias updates
 
   Matrix<double> mLinearityCorrectionAccu; ///< Accumulator for linearity updates
   Vector<double> mBiasCorrectionAccu;      ///< Accumulator for bias updates
+
+  Matrix<BaseFloat> mLinearityCorrectionAccuFloat; ///< single-precision accumulator (FloatAccu)
+
+  Matrix<BaseFloat> mLinearityMomentum; ///< velocity of the linearity (momentum)
+  Vector<BaseFloat> mBiasMomentum;      ///< velocity of the bias (momentum)
   
   int mNInstances;
 };
@@ -64,6 +93,7 @@ SharedLinearity::
 SharedLinearity(size_t nInputs, size_t nOutputs, Component *pPred)
   : UpdatableComponent(nInputs, nOutputs, pPred),
     mpLinearity(&mLinearity), mpBias(&mBias), 
+    mpMappedLinearity(NULL), mpMappedBias(NULL),
     mNInstances(0)
 { }
 
@@ -71,7 +101,10 @@ SharedLinearity(size_t nInputs, size_t nOutputs, Component *pPred)
 inline
 SharedLinearity::
 ~SharedLinearity()
-{ }
+{ 
+  delete mpMappedLinearity;
+  delete mpMappedBias;
+}
 
 
 inline
@@ -89,6 +122,9 @@ Clone() const
   ptr->mNInstances = mNInstances;
 
   ptr->mLearningRate = mLearningRate;
+  ptr->mMomentum = mMomentum;
+  ptr->mNesterov = mNesterov;
+  ptr->mFloatAccu = mFloatAccu;
 
 
   return ptr;
@@ -0,0 +1,144 @@
+#include "StreamingForward.h"
+
+#include <cstring>
+
+namespace TNet {
+
+
+  StreamingForward::
+  StreamingForward(Network& rNnet, size_t chunk)
+   : mrNnet(rNnet), mChunk(chunk), mLeft(0), mRight(0),
+     mFrames(0), mStarted(false), mPending(0)
+  {
+    if(mChunk < 1) KALDI_ERR << "Chunk must have at least one frame";
+    mrNnet.GetContext(mLeft, mRight);
+  }
+
+
+  StreamingForward::
+  StreamingForward(Network& rNnet, size_t chunk, size_t left, size_t right)
+   : mrNnet(rNnet), mChunk(chunk), mLeft(left), mRight(right),
+     mFrames(0), mStarted(false), mPending(0)
+  {
+    if(mChunk < 1) KALDI_ERR << "Chunk must have at least one frame";
+  }
+
+
+  void
+  StreamingForward::
+  Push(const Matrix<BaseFloat>& rFrames)
+  {
+    if(rFrames.Rows() == 0) return;
+    if(mStarted && rFrames.Cols() != mWindow.Cols()) {
+      KALDI_ERR << "Feature dimension mismatch, stream: " << mWindow.Cols()
+                << " frames: " << rFrames.Cols();
+    }
+    if(!mStarted) {
+      //the first frame of the utterance, pad the left context
+      if(mWindow.Cols() != rFrames.Cols()) {
+        mWindow.Init(mLeft+mChunk+mRight, rFrames.Cols());
+      }
+      mStarted = true;
+      Append(rFrames.pRowData(0), rFrames.Cols(), mLeft);
+    }
+    for(size_t r=0; r<rFrames.Rows(); r++) {
+      Append(rFrames.pRowData(r), rFrames.Cols(), 1);
+    }
+  }
+
+
+  void
+  StreamingForward::
+  Finish()
+  {
+    if(!mStarted) return;
+    //pad the right context by the last frame
+    if(mRight > 0) {
+      //copy the frame, the window moves when the chunk gets complete
+      Vector<BaseFloat> last(mWindow.Cols());
+      memcpy(last.pData(), mWindow.pRowData(mFrames-1), mWindow.Cols()*sizeof(BaseFloat));
+      Append(last.pData(), last.Dim(), mRight);
+    }
+    //forward the incomplete chunk
+    if(mFrames > mLeft + mRight) {
+      ForwardWindow(mFrames);
+    }
+    mFrames = 0;
+    mStarted = false;
+  }
+
+
+  bool
+  StreamingForward::
+  Pull(Matrix<BaseFloat>& rOut)
+  {
+    if(mPending == 0) return false;
+    rOut.Init(mPending, mOutput.Cols());
+    rOut.Copy(mOutput.Range(0, mPending, 0, mOutput.Cols()));
+    mPending = 0;
+    return true;
+  }
+
+
+  void
+  StreamingForward::
+  Reset()
+  {
+    mFrames = 0;
+    mStarted = false;
+    mPending = 0;
+  }
+
+
+  void
+  StreamingForward::
+  Append(const BaseFloat* pFrame, size_t cols, size_t rows)
+  {
+    for(size_t r=0; r<rows; r++) {
+      memcpy(mWindow.pRowData(mFrames), pFrame, cols*sizeof(BaseFloat));
+      mFrames++;
+      //the window is full, forward the chunk
+      if(mFrames == mWindow.Rows()) {
+        ForwardWindow(mFrames);
+      }
+    }
+  }
+
+
+  void
+  StreamingForward::
+  ForwardWindow(size_t rows)
+  {
+    assert(rows > mLeft + mRight && rows <= mWindow.Rows());
+    size_t outputs = rows - mLeft - mRight;
+
+    mrNnet.Feedforward(mWindow.Range(0, rows, 0, mWindow.Cols()), mNnetOut, mLeft, mRight);
+
+    //append the outputs, grow the buffer by chunks
+    if(mPending + outputs > mOutput.Rows() || mOutput.Cols() != mNnetOut.Cols()) {
+      size_t capacity = mOutput.Rows() + mChunk;
+      if(capacity < mPending + outputs) capacity = mPending + outputs;
+      if(mPending > 0) {
+        Matrix<BaseFloat> pending(mOutput.Range(0, mPending, 0, mOutput.Cols()));
+        mOutput.Init(capacity, mNnetOut.Cols());
+        mOutput.Range(0, mPending, 0, mOutput.Cols()).Copy(pending);
+      } else {
+        mOutput.Init(capacity, mNnetOut.Cols());
+      }
+    }
+    mOutput.Range(mPending, outputs, 0, mOutput.Cols()).Copy(
+      mNnetOut.Range(mLeft, outputs, 0, mNnetOut.Cols())
+    );
+    mPending += outputs;
+
+    //keep the context of the next chunk
+    size_t keep = mLeft + mRight;
+    if(keep > 0) {
+      memmove(mWindow.pRowData(0), mWindow.pRowData(rows-keep),
+              keep*mWindow.Stride()*sizeof(BaseFloat));
+    }
+    mFrames = keep;
+  }
+
+
+} //namespace TNet
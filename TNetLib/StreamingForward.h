@@ -0,0 +1,77 @@
+#ifndef _STREAMING_FORWARD_H_
+#define _STREAMING_FORWARD_H_
+
+#include "Matrix.h"
+#include "Nnet.h"
+
+namespace TNet {
+
+
+  /**
+   * Incremental inference for live input: the frames are pushed
+   * as they come, the outputs can be pulled as soon as their right
+   * context arrived.
+   *
+   * The window keeps the left context, the frames of one chunk and
+   * the right context, the network is forwarded once per chunk.
+   * A small chunk gives low latency, a large one efficient GEMMs.
+   *
+   * The utterance edges are padded by the first/last frame (as <expand>
+   * does on the matrix edges), so with a single <expand> (also one per
+   * <blockarray> block) the output of a whole utterance is the same as Network::Forward() of its frames
+   * (up to the rounding of the GEMMs of a different size).
+   */
+  class StreamingForward {
+    public:
+      /// The context is taken from the <expand> components of the network
+      StreamingForward(Network& rNnet, size_t chunk);
+      /// Explicit left/right context
+      StreamingForward(Network& rNnet, size_t chunk, size_t left, size_t right);
+
+      /// Append the input frames, forwards each complete chunk
+      void Push(const Matrix<BaseFloat>& rFrames);
+      /// End of the utterance, forwards the rest of the frames
+      void Finish();
+      /// Get the outputs computed since the last call,
+      /// returns false if there are none (rOut is not changed then)
+      bool Pull(Matrix<BaseFloat>& rOut);
+      /// Drop the frames and outputs, start a new utterance
+      void Reset();
+
+      /// Number of computed outputs not yet pulled
+      size_t Pending() const
+      { return mPending; }
+
+      /// Left context of the network
+      size_t LeftContext() const
+      { return mLeft; }
+      /// Right context of the network
+      size_t RightContext() const
+      { return mRight; }
+
+    private:
+      /// Append rows copies of the frame (rows>1 only for the padding),
+      /// pFrame must not point to mWindow
+      void Append(const BaseFloat* pFrame, size_t cols, size_t rows);
+      /// Forward the window rows [0,rows),
+      /// keep the outputs of [mLeft,rows-mRight) and the last context frames
+      void ForwardWindow(size_t rows);
+
+    private:
+      Network& mrNnet;
+      size_t mChunk;  ///< output frames per forward
+      size_t mLeft;   ///< left context frames
+      size_t mRight;  ///< right context frames
+
+      Matrix<BaseFloat> mWindow;  ///< context + chunk + context input frames
+      size_t mFrames;             ///< valid rows of mWindow
+      bool mStarted;              ///< the left padding is in mWindow
+
+      Matrix<BaseFloat> mNnetOut; ///< output of the window
+      Matrix<BaseFloat> mOutput;  ///< computed outputs (grows by chunks)
+      size_t mPending;            ///< valid rows of mOutput
+  };
+
+} //namespace TNet
+
+#endif
@@ -6,11 +6,16 @@ namespace TNet {
 class Thread {
  public:
   Thread() 
+   : joinable_(false)
   { }
   virtual ~Thread() 
   { }
 
-  int Start(void* arg);
+  /// Start the thread, with cpu>=0 the thread runs only on that CPU,
+  /// a joinable thread must be waited for by Join() (else it is detached)
+  int Start(void* arg, int cpu = -1, bool joinable = false);
+  /// Wait for the end of the joinable thread
+  void Join();
 
  protected:
   static void* EntryPoint(void*);
@@ -21,23 +26,39 @@ class Thread {
  private:
   pthread_t thread_id_;
   void * arg_;
+  bool joinable_;
 };
 
-int Thread::Start(void * arg) {
+inline int Thread::Start(void * arg, int cpu, bool joinable) {
   Arg(arg); // store user data
+  joinable_ = joinable;
  
   int ret=0;
-  //create thread as detached (don't wait for it)
+  //create thread as detached (don't wait for it) unless it is joined
   pthread_attr_t tattr;
   ret |= pthread_attr_init(&tattr);
-  ret |= pthread_attr_setdetachstate(&tattr,PTHREAD_CREATE_DETACHED);
+  ret |= pthread_attr_setdetachstate(&tattr,
+           joinable ? PTHREAD_CREATE_JOINABLE : PTHREAD_CREATE_DETACHED);
+  //pin the thread (its memory is then allocated on the node of the CPU)
+  if(cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    ret |= pthread_attr_setaffinity_np(&tattr, sizeof(cpus), &cpus);
+  }
   ret |= pthread_create(&thread_id_, &tattr, &Thread::EntryPoint, this);
   if(ret != 0) KALDI_ERR << "Failed to create thread";
   return ret;
 }
 
+inline void Thread::Join() {
+  assert(joinable_);
+  if(pthread_join(thread_id_, NULL) != 0) KALDI_ERR << "Failed to join thread";
+  joinable_ = false;
+}
+
 /*static */
-void* Thread::EntryPoint(void* pthis) try {
+inline void* Thread::EntryPoint(void* pthis) try {
   Thread* pt = (Thread*)pthis;
   pt->Execute(pt->Arg());
   return NULL;
@@ -0,0 +1,122 @@
+#include "ThreadPlacement.h"
+#include "Error.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace TNet {
+
+
+  bool
+  ThreadPlacement::
+  ParseCpuList(const std::string& rList, std::vector<int>& rCpus)
+  {
+    rCpus.clear();
+    std::istringstream is(rList);
+    std::string range;
+    while(std::getline(is, range, ',')) {
+      if(range.empty() || range == "\n") continue;
+      char* end;
+      long first = strtol(range.c_str(), &end, 10);
+      long last = first;
+      if(*end == '-') {
+        const char* beg = end+1;
+        last = strtol(beg, &end, 10);
+        if(end == beg) return false;
+      }
+      if(end == range.c_str() || (*end != '\0' && *end != '\n') || first < 0 || last < first
+         || last >= CPU_SETSIZE) {
+        return false;
+      }
+      for(long cpu=first; cpu<=last; cpu++) {
+        rCpus.push_back(static_cast<int>(cpu));
+      }
+    }
+    return !rCpus.empty();
+  }
+
+
+  void
+  ThreadPlacement::
+  Init(const std::string& rPolicy)
+  {
+    mCpus.clear();
+    mNodes = 1;
+    if(rPolicy.empty() || rPolicy == "none") return;
+
+    //CPUs the process may run on
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      for(int cpu=0; cpu<sysconf(_SC_NPROCESSORS_ONLN) && cpu<CPU_SETSIZE; cpu++) {
+        CPU_SET(cpu, &allowed);
+      }
+    }
+
+    //explicit list
+    if(rPolicy != "compact" && rPolicy != "scatter") {
+      if(!ParseCpuList(rPolicy, mCpus)) {
+        KALDI_ERR << "Bad thread placement: " << rPolicy 
+                  << " (none, compact, scatter or a CPU list 0,2,4-7)";
+      }
+      //a thread cannot be started on the other CPUs
+      for(size_t i=0; i<mCpus.size(); i++) {
+        if(!CPU_ISSET(mCpus[i], &allowed)) {
+          KALDI_ERR << "Bad thread placement: " << rPolicy 
+                    << ", the process may not run on CPU " << mCpus[i];
+        }
+      }
+      return;
+    }
+
+    //CPUs of the NUMA nodes
+    std::vector<std::vector<int> > node_cpus;
+    for(int node=0; ; node++) {
+      std::ostringstream path;
+      path << "/sys/devices/system/node/node" << node << "/cpulist";
+      std::ifstream is(path.str().c_str());
+      if(!is.good()) break;
+      std::string list;
+      std::getline(is, list);
+      std::vector<int> cpus, usable;
+      ParseCpuList(list, cpus);
+      for(size_t i=0; i<cpus.size(); i++) {
+        if(cpus[i] < CPU_SETSIZE && CPU_ISSET(cpus[i], &allowed)) usable.push_back(cpus[i]);
+      }
+      if(!usable.empty()) node_cpus.push_back(usable);
+    }
+    //no NUMA information, single node
+    if(node_cpus.empty()) {
+      node_cpus.resize(1);
+      for(int cpu=0; cpu<CPU_SETSIZE; cpu++) {
+        if(CPU_ISSET(cpu, &allowed)) node_cpus[0].push_back(cpu);
+      }
+    }
+    mNodes = static_cast<int>(node_cpus.size());
+
+    size_t largest = 0;
+    for(size_t n=0; n<node_cpus.size(); n++) {
+      largest = std::max(largest, node_cpus[n].size());
+    }
+    if(rPolicy == "compact") {
+      //node after node
+      for(size_t n=0; n<node_cpus.size(); n++) {
+        mCpus.insert(mCpus.end(), node_cpus[n].begin(), node_cpus[n].end());
+      }
+    } else {
+      //one CPU of each node in turn
+      for(size_t i=0; i<largest; i++) {
+        for(size_t n=0; n<node_cpus.size(); n++) {
+          if(i < node_cpus[n].size()) mCpus.push_back(node_cpus[n][i]);
+        }
+      }
+    }
+  }
+
+
+} //namespace TNet
@@ -0,0 +1,47 @@
+#ifndef _THREAD_PLACEMENT_H_
+#define _THREAD_PLACEMENT_H_
+
+#include <string>
+#include <vector>
+
+namespace TNet {
+
+  /**
+   * Placement of the training threads to the CPUs:
+   *  "none"     the threads are not pinned
+   *  "compact"  fill the CPUs of the first NUMA node, then the next node...
+   *  "scatter"  round-robin over the NUMA nodes
+   *  "0,2,4-7"  explicit list of CPUs, thread i runs on the i-th one
+   *
+   * The NUMA nodes are read from /sys/devices/system/node,
+   * only the CPUs the process may run on are used.
+   * A thread allocates its memory on the node of its CPU (first touch),
+   * so the pinned threads should initialize their own buffers.
+   */
+  class ThreadPlacement {
+    public:
+      ThreadPlacement()
+       : mNodes(1)
+      { }
+      /// Set the placement policy (KALDI_ERR on bad policy)
+      void Init(const std::string& rPolicy);
+
+      /// CPU of the thread, -1 when the threads are not pinned
+      int Cpu(int thr) const
+      { return mCpus.empty() ? -1 : mCpus[thr % mCpus.size()]; }
+
+      /// Number of NUMA nodes found
+      int Nodes() const
+      { return mNodes; }
+
+      /// Parse the CPU list "0,2,4-7", the CPUs must be below CPU_SETSIZE
+      static bool ParseCpuList(const std::string& rList, std::vector<int>& rCpus);
+
+    private:
+      std::vector<int> mCpus; ///< CPUs in the order of the threads
+      int mNodes;
+  };
+
+} //namespace TNet
+
+#endif
@@ -30,11 +30,13 @@
 
 /*** TNet includes */
 #include "Nnet.h"
+#include "FrameBatch.h"
 
 /*** STL includes */
 #include <iostream>
 #include <sstream>
 #include <numeric>
+#include <vector>
 
 
 
@@ -64,7 +66,7 @@ void usage(const char* progname)
 " -T N       Set trace flags to N                            0\n" 
 " -V         Print version information                       Off\n"
 "\n"
-"NATURALREADORDER PRINTCONFIG PRINTVERSION SCRIPT SOURCEMMF TARGETMMF TRACE\n"
+"BATCHFRAMES MAPFEATURES NATURALREADORDER PRINTCONFIG PRINTVERSION SCRIPT SOURCEMMF TARGETMMF TRACE\n"
 "\n"
 "STARTFRMEXT ENDFRMEXT CMEANDIR CMEANMASK VARSCALEDIR VARSCALEMASK VARSCALEFN TARGETKIND DERIVWINDOWS DELTAWINDOW ACCWINDOW THIRDWINDOW\n"
 "\n"
@@ -78,6 +80,59 @@ void usage(const char* progname)
 
 
 
+///////////////////////////////////////////////////////////////////////
+// ACCUMULATION
+//
+
+/// Accumulate the first/second order statistics of the network output
+void AccumulateStats(const Matrix<BaseFloat>& feats_host_out, 
+                     Vector<double>& first, Vector<double>& second,
+                     unsigned long framesN, const std::string& utterance)
+{
+  for(size_t m=0; m<feats_host_out.Rows(); m++) {
+    for(size_t n=0; n<feats_host_out.Cols(); n++) {
+      BaseFloat val = feats_host_out(m,n);
+      first[n] += val; 
+      second[n] += val*val;
+
+      if(isnan(first[n])||isnan(second[n])||
+         isinf(first[n])||isinf(second[n])) 
+      {
+        KALDI_ERR << "nan/inf in accumulators\n"
+                  << "first:" << first << "\n"
+                  << "second:" << second << "\n"
+                  << "frames:" << framesN << "\n"
+                  << "utterance:" << utterance << "\n"
+                  << "feats_host_out: " << feats_host_out << "\n";
+      }
+    }
+  }
+}
+
+
+
+
+/// Forward the batch, accumulate the statistics of its utterances
+/// and clear it
+void AccumulateBatch(Network& network, FrameBatch& batch, 
+                     std::vector<std::string>& utterances,
+                     Vector<double>& first, Vector<double>& second,
+                     unsigned long& framesN)
+{
+  Matrix<BaseFloat> feats_host_out;
+  batch.Forward(network);
+  for(size_t i=0; i<batch.Utterances(); i++) {
+    batch.GetOutput(i, feats_host_out);
+    AccumulateStats(feats_host_out, first, second, framesN, utterances[i]);
+    framesN += batch.InputFrames(i);
+  }
+  batch.Clear();
+  utterances.clear();
+}
+
+
+
+
 ///////////////////////////////////////////////////////////////////////
 // MAIN FUNCTION
 //
@@ -105,10 +160,12 @@ int main(int argc, char *argv[]) try
   const char*                       p_targetmmf; 
 
   int traceFlag;
+  int batch_frames;
 
 
   // variables for feature repository
   bool                              swap_features;
+  bool                              map_features;
   int                               target_kind;
   int                               deriv_order;
   int*                              p_deriv_win_lenghts;
@@ -132,6 +189,7 @@ int main(int argc, char *argv[]) try
   // OPTION RETRIEVAL ........................................................
   // extract the feature parameters
   swap_features = !ui.GetBool(SNAME":NATURALREADORDER", TNet::IsBigEndian());
+  map_features  = ui.GetBool(SNAME":MAPFEATURES", false);
   
   target_kind = ui.GetFeatureParams(&deriv_order, &p_deriv_win_lenghts,
        &start_frm_ext, &end_frm_ext, &cmn_path, &cmn_file, &cmn_mask,
@@ -144,6 +202,8 @@ int main(int argc, char *argv[]) try
 
   p_script            = ui.GetStr(SNAME":SCRIPT",         NULL);
 
+  batch_frames    = static_cast<int>(ui.GetInt(SNAME":BATCHFRAMES", 0));
+
   traceFlag       = ui.GetInt(SNAME":TRACE",               0);
 
 
@@ -173,7 +233,7 @@ int main(int argc, char *argv[]) try
   //read the neural network
   if(NULL != p_source_mmf_file) { 
     if(traceFlag&1) KALDI_LOG << "Reading network: " << p_source_mmf_file;
-    network_cpu.ReadNetwork(p_source_mmf_file);
+    network_cpu.MapNetwork(p_source_mmf_file);
   } else {
     KALDI_ERR << "Source MMF must be specified [-H]";
   }
@@ -187,6 +247,13 @@ int main(int argc, char *argv[]) try
     deriv_order, p_deriv_win_lenghts, 
     cmn_path, cmn_mask, cvn_path, cvn_mask, cvg_file
   );
+  features.MapFeatures(map_features);
+  //the mapped frames are used in place only as they are stored: in the
+  //byte order of the CPU (NATURALREADORDER), not normalized, not padded
+  if(map_features && (swap_features || cmn_path || cvn_path || cvg_file)) {
+    KALDI_WARN << "MAPFEATURES copies the features anyway without NATURALREADORDER "
+               << "or with CMN, CVN or CVG";
+  }
   if(NULL != p_script) {
     features.AddFileList(p_script);
   } else {
@@ -220,47 +287,47 @@ int main(int argc, char *argv[]) try
   //**********************************************************************
   // MAIN LOOP
 
+  //pack the short utterances to batches of at most BATCHFRAMES frames
+  FrameBatch batch(batch_frames, start_frm_ext, end_frm_ext);
+  std::vector<std::string> batch_utts;
+
   for(features.Rewind(); !features.EndOfList(); features.MoveNext()) {
 
-    Matrix<BaseFloat> feats_host,net_out;
+    Matrix<BaseFloat> feats_buf,net_out;
     Matrix<BaseFloat> feats_host_out;
   
-    //get features 
-    features.ReadFullMatrix(feats_host);
-
-    //propagate
-    network_cpu.Feedforward(feats_host,net_out,start_frm_ext,end_frm_ext);
-    //trim the xxx_frm_ext
-    feats_host_out.Init(net_out.Rows()-start_frm_ext-end_frm_ext,net_out.Cols());
-    memcpy(feats_host_out.pData(),net_out.pRowData(start_frm_ext),feats_host_out.MSize());
-
-    //accumulate first/second order statistics
-    for(size_t m=0; m<feats_host_out.Rows(); m++) {
-      for(size_t n=0; n<feats_host_out.Cols(); n++) {
-        BaseFloat val = feats_host_out(m,n);
-        first[n] += val; 
-        second[n] += val*val;
-
-        if(isnan(first[n])||isnan(second[n])||
-           isinf(first[n])||isinf(second[n])) 
-        {
-          KALDI_ERR << "nan/inf in accumulators\n"
-                    << "first:" << first << "\n"
-                    << "second:" << second << "\n"
-                    << "frames:" << framesN << "\n"
-                    << "utterance:" << features.Current().Logical() << "\n"
-                    << "feats_host: " << feats_host << "\n"
-                    << "feats_host_out: " << feats_host_out << "\n";
-        }
+    //get features (a view over the mapped file if MAPFEATURES needs no conversion)
+    const Matrix<BaseFloat>& feats_host = features.ReadFullMatrixView(feats_buf);
+
+    if(batch_frames > 0) {
+      //add to the batch, forward the full batch first
+      if(!batch.Fits(feats_host)) {
+        AccumulateBatch(network_cpu, batch, batch_utts, first, second, framesN);
       }
+      batch.Add(feats_host);
+      batch_utts.push_back(features.Current().Logical());
+    } else {
+      //propagate
+      network_cpu.Feedforward(feats_host,net_out,start_frm_ext,end_frm_ext);
+      //trim the xxx_frm_ext
+      feats_host_out.Init(net_out.Rows()-start_frm_ext-end_frm_ext,net_out.Cols());
+      memcpy(feats_host_out.pData(),net_out.pRowData(start_frm_ext),feats_host_out.MSize());
+
+      //accumulate first/second order statistics
+      AccumulateStats(feats_host_out, first, second, framesN, features.Current().Logical());
+
+      framesN += feats_host.Rows();
     }
-
-    framesN += feats_host.Rows();
     
     //progress 
     if((cnt++ % step) == 0) KALDI_COUT << 100 * cnt / features.QueueSize() << "%, " << std::flush;
   }
 
+  //forward the last batch
+  if(!batch.Empty()) {
+    AccumulateBatch(network_cpu, batch, batch_utts, first, second, framesN);
+  }
+
   //**********************************************************************
   //**********************************************************************
   // ACCUMULATING FINISHED .................................................
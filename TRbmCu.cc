@@ -64,6 +64,7 @@ void usage(const char* progname)
 " Option                                                     Default\n\n"
 " -n f       Set learning rate to f                          0.06\n"
 " -A         Print command line arguments                    Off\n" 
+" -B         Save NN macro files in binary format            Off\n"
 " -C cf      Set config file to cf                           Default\n"
 " -D         Display configuration variables                 Off\n"
 " -H mmf     Load NN macro file                              \n"
@@ -71,7 +72,7 @@ void usage(const char* progname)
 " -T N       Set trace flags to N                            0\n" 
 " -V         Print version information                       Off\n"
 "\n"
-"FEATURETRANSFORM LEARNINGRATE MOMENTUM NATURALREADORDER PRINTCONFIG PRINTVERSION SCRIPT SOURCEMMF TARGETMMF TRACE WEIGHTCOST\n"
+"FEATURETRANSFORM LEARNINGRATE MOMENTUM NATURALREADORDER PRINTCONFIG PRINTVERSION SAVEBINARY SCRIPT SOURCEMMF TARGETMMF TRACE WEIGHTCOST\n"
 "\n"
 "STARTFRMEXT ENDFRMEXT CMEANDIR CMEANMASK VARSCALEDIR VARSCALEMASK VARSCALEFN TARGETKIND DERIVWINDOWS DELTAWINDOW ACCWINDOW THIRDWINDOW\n"
 "\n"
@@ -93,6 +94,7 @@ int main(int argc, char *argv[]) try
 {
   const char* p_option_string =
     " -n r   LEARNINGRATE"
+    " -B n   SAVEBINARY=TRUE"
     " -D n   PRINTCONFIG=TRUE"
     " -H l   SOURCEMMF"
     " -S l   SCRIPT"
@@ -127,6 +129,7 @@ int main(int argc, char *argv[]) try
   long int                          seed;
   
   int                               trace;
+  bool                              save_binary;
 
   // variables for feature repository
   bool                              swap_features;
@@ -179,6 +182,7 @@ int main(int argc, char *argv[]) try
   seed                = ui.GetInt(SNAME":SEED", 0);
 
   trace               = ui.GetInt(SNAME":TRACE", 0);
+  save_binary         = ui.GetBool(SNAME":SAVEBINARY", false);
   if(trace&4) { CuDevice::Instantiate().Verbose(true); }
 
 
@@ -369,7 +373,7 @@ int main(int argc, char *argv[]) try
   //write the network
   if (NULL != p_targetmmf) {
     if(trace&1) KALDI_LOG << "Writing network: " << p_targetmmf;
-    network.WriteNetwork(p_targetmmf);
+    network.WriteNetwork(p_targetmmf, save_binary);
   } else {
     KALDI_ERR << "missing argument --TARGETMMF";
   }
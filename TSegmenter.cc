@@ -71,7 +71,7 @@ void usage(const char* progname)
 " -T N       Set trace flags to N                            0\n" 
 " -V         Print version information                       Off\n"
 "\n"
-"NATURALREADORDER NOSUBDIRS OUTPUTSCRIPT PRINTCONFIG PRINTVERSION SCRIPT TARGETPARAMDIR "/*TARGETPARAMEXT*/" TRACE\n"
+"ARCHIVE HALFPRECISION NATURALREADORDER NOSUBDIRS OUTPUTSCRIPT PRINTCONFIG PRINTVERSION SCRIPT TARGETPARAMDIR "/*TARGETPARAMEXT*/" TRACE\n"
 "\n"
 "STARTFRMEXT ENDFRMEXT CMEANDIR CMEANMASK VARSCALEDIR VARSCALEMASK VARSCALEFN TARGETKIND DERIVWINDOWS DELTAWINDOW ACCWINDOW THIRDWINDOW\n"
 "\n"
@@ -114,6 +114,8 @@ int main(int argc, char *argv[]) try
   const char*                       p_output_script;
   int                               trace;
   bool                              create_subdirs;
+  bool                              archive;
+  bool                              half_precision;
 
   // variables for feature repository
   bool                              swap_features;
@@ -152,6 +154,8 @@ int main(int argc, char *argv[]) try
 //  p_tgt_param_ext     = ui.GetStr(SNAME":TARGETPARAMEXT", NULL);
   p_output_script     = ui.GetStr(SNAME":OUTPUTSCRIPT",   NULL);
   create_subdirs      = !ui.GetBool(SNAME":NOSUBDIRS", false);
+  archive             = ui.GetBool(SNAME":ARCHIVE", false);
+  half_precision      = ui.GetBool(SNAME":HALFPRECISION", false);
   trace               = ui.GetInt(SNAME":TRACE",          00);
 
 
@@ -207,12 +211,42 @@ int main(int argc, char *argv[]) try
   //store short segments of the data
   Matrix<BaseFloat> matrix;
   std::string file_out;
+  //packed archive output, one archive per 1000 segments
+  FeatureArchiveWriter archive_out;
 
   features.Rewind();
   for( ; !features.EndOfList(); features.MoveNext(), cnt++) {
     //read the features
     features.ReadFullMatrix(matrix);
 
+    //store the segment as an archive entry
+    if(archive) {
+      if(!archive_out.IsOpen()) {
+        char ark[64];
+        sprintf(ark,"%06d.ark",static_cast<int>(cnt/1000));
+        file_out = "";
+        if(NULL != p_tgt_param_dir) {
+          (file_out += p_tgt_param_dir) += "/";
+        }
+        file_out += ark;
+        archive_out.Open(file_out, half_precision);
+      }
+      size_t entry = archive_out.Write(features.Current().Logical(), matrix, 
+                                       features.CurrentHeader().mSampleKind,
+                                       features.CurrentHeader().mSamplePeriod);
+      //write the output scriptfile record
+      out_scp << features.Current().Logical() << "=" << file_out << "#" << entry 
+              << "[" << start_frm_ext << "," << matrix.Rows()-end_frm_ext-1 << "]\n";
+      out_scp << std::flush;
+
+      if(archive_out.Entries() == 1000) {
+        archive_out.Close();
+      }
+
+      if((cnt % step) == 0) KALDI_COUT << 100 * cnt / features.QueueSize() << "%, " << std::flush;
+      continue;
+    }
+
     //build the output feature filename
     file_out = "";
     if(NULL != p_tgt_param_dir) {
@@ -222,7 +256,7 @@ int main(int argc, char *argv[]) try
     //create directory structure
     if(create_subdirs) {
       char subd[64];
-      sprintf(subd,"%06d/",cnt/1000);
+      sprintf(subd,"%06d/",static_cast<int>(cnt/1000));
       file_out += subd;
       //create dir
       if(access(file_out.c_str(), R_OK|W_OK|X_OK)) {
@@ -249,6 +283,11 @@ int main(int argc, char *argv[]) try
     if((cnt % step) == 0) KALDI_COUT << 100 * cnt / features.QueueSize() << "%, " << std::flush;
   }
 
+  //finish the last archive
+  if(archive_out.IsOpen()) {
+    archive_out.Close();
+  }
+
   //close output script file
   out_scp.close();
 
@@ -0,0 +1,45 @@
+#!/bin/sh
+# The single-precision gradient accumulator (FLOATACCU=T) against the double
+# one: the same synthetic data, initial network and seed, PARALLELMODE=sync.
+# Prints the time per update step (BUNCHSIZE frames) and the objective
+# of each epoch of both runs.
+#
+# sh BenchFloatAccu.sh <dir of TNet> [threads] [epochs] [hidden]
+
+BIN=${1:-..}
+THREADS=${2:-4}
+EPOCHS=${3:-4}
+HIDDEN=${4:-1024}
+BUNCH=256
+
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/tnet_bench.XXXXXX") || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+./GenData "$DIR" 200 40 "$HIDDEN" 64 || exit 1
+
+for FLOATACCU in F T; do
+  "$BIN"/TNet -S "$DIR"/train.scp -H "$DIR"/nnet.init -I "$DIR"/ref.mlf -m "$DIR"/states \
+    --TARGETMMF="$DIR"/nnet.$FLOATACCU --BUNCHSIZE=$BUNCH --CACHESIZE=16384 \
+    --LEARNINGRATE=0.001 --SEED=7 --EPOCHS="$EPOCHS" --CACHEDATA=T \
+    --THREADS="$THREADS" --FLOATACCU=$FLOATACCU > "$DIR"/log.$FLOATACCU 2>&1 || {
+    cat "$DIR"/log.$FLOATACCU; echo "TNet FLOATACCU=$FLOATACCU failed"; exit 1; }
+done
+
+echo "FLOATACCU against the double accumulator, $THREADS threads, hidden $HIDDEN, bunch $BUNCH"
+for FLOATACCU in F T; do
+  #the time of the whole run over the update steps of all the epochs,
+  #a single epoch is reported only by the final line
+  awk -v name="FLOATACCU=$FLOATACCU" -v bunch=$BUNCH '
+    /^EPOCH [0-9]+ TR/ { split($5, f, ":"); frames += f[2]; split($6, o, ":");
+                         obj = obj sprintf("  epoch %d %s", $2, o[2]) }
+    /^-- TR/ && frames == 0 { split($4, f, ":"); frames = f[2]; split($5, o, ":");
+                              obj = sprintf("  epoch 1 %s", o[2]) }
+    /TNET FINISHED/ { time = $5 }
+    END { printf("%-12s %8.3f ms/step  objective/frame:%s\n", name, 1000.0 * time * bunch / frames, obj) }
+  ' "$DIR"/log.$FLOATACCU
+done
+if cmp -s "$DIR"/nnet.F "$DIR"/nnet.T; then
+  echo "The final networks are identical"
+else
+  echo "The final networks differ (rounding)"
+fi
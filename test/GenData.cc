@@ -0,0 +1,109 @@
+/*
+ * Synthetic training data for the test and benchmark scripts: HTK features
+ * of utterances whose frames are the noisy means of their classes, the MLF
+ * of the classes, the train/cv lists, the class list and an initial network
+ * (dim-hidden-classes, sigmoid, softmax). The same arguments give the same data.
+ *
+ * GenData <dir> [utterances] [dim] [hidden] [classes]
+ */
+
+#include "Test.h"
+
+#include "Features.h"
+#include "Matrix.h"
+#include "Common.h"
+
+#include <vector>
+
+using namespace TNet;
+
+
+/// Random matrix (rows 0: vector) in the text model format, values in [-scale,scale)
+static std::string RandomText(int rows, int cols, float scale)
+{
+  std::ostringstream os;
+  if(rows > 0) os << "m " << rows << " " << cols << "\n";
+  else os << "v " << cols << "\n";
+  for(int r=0; r<std::max(rows,1); r++) {
+    for(int c=0; c<cols; c++) os << scale*TestRand() << " ";
+    os << "\n";
+  }
+  return os.str();
+}
+
+
+int main(int argc, char* argv[])
+{
+  if(argc < 2) {
+    std::cerr << "USAGE: " << argv[0] << " <dir> [utterances] [dim] [hidden] [classes]" << std::endl;
+    return 1;
+  }
+  std::string dir = argv[1];
+  int utterances = argc > 2 ? atoi(argv[2]) : 50;
+  int dim = argc > 3 ? atoi(argv[3]) : 13;
+  int hidden = argc > 4 ? atoi(argv[4]) : 64;
+  int classes = argc > 5 ? atoi(argv[5]) : 5;
+  if(utterances < 2 || dim < 1 || hidden < 1 || classes < 2) {
+    std::cerr << "Invalid sizes" << std::endl;
+    return 1;
+  }
+  std::string cmd = "mkdir -p '" + dir + "/fea'";
+  if(system(cmd.c_str()) != 0) {
+    std::cerr << "Cannot create: " << dir << std::endl;
+    return 1;
+  }
+
+  //the means of the classes
+  Matrix<BaseFloat> mean(classes, dim);
+  for(int k=0; k<classes; k++) {
+    for(int d=0; d<dim; d++) mean(k,d) = TestRand();
+  }
+
+  FeatureRepository repo;
+  repo.Init(!IsBigEndian(), 0, 0, PARAMKIND_ANON, 0, NULL,
+            NULL, NULL, NULL, NULL, NULL);
+  std::ostringstream mlf, train, cv, states;
+  mlf << "#!MLF!#\n";
+  for(int u=0; u<utterances; u++) {
+    char name[32];
+    sprintf(name, "utt%04d", u);
+    //segments of 5-35 frames, 50-300 frames in total
+    int frames = 50 + static_cast<int>(125.0f*(TestRand()+1.0f));
+    Matrix<BaseFloat> fea(frames, dim);
+    mlf << "\"*/" << name << ".lab\"\n";
+    for(int beg=0; beg<frames; ) {
+      int end = std::min(frames, beg + 20 + static_cast<int>(15.0f*TestRand()));
+      int k = std::min(classes-1, static_cast<int>(0.5f*(TestRand()+1.0f)*static_cast<float>(classes)));
+      for(int t=beg; t<end; t++) {
+        for(int d=0; d<dim; d++) fea(t,d) = mean(k,d) + 3.0f*TestRand();
+      }
+      //times in 100ns, frames of 10ms
+      mlf << beg*100000 << " " << end*100000 << " s" << k+1 << "\n";
+      beg = end;
+    }
+    mlf << ".\n";
+    std::string file = dir + "/fea/" + name + ".fea";
+    repo.WriteFeatureMatrix(fea, file, PARAMKIND_USER, 100000);
+    //every fifth utterance for the cross-validation
+    (u % 5 == 4 ? cv : train) << file << "\n";
+  }
+  for(int k=0; k<classes; k++) states << "s" << k+1 << "\n";
+
+  //the weights scaled by the fan-in, the features have variance 3.3
+  float scale_in = 1.0f / std::sqrt(static_cast<float>(dim));
+  float scale_hid = 4.0f / std::sqrt(static_cast<float>(hidden));
+  std::ostringstream nnet;
+  nnet << "<biasedlinearity> " << hidden << " " << dim << "\n"
+       << RandomText(hidden, dim, scale_in) << RandomText(0, hidden, 0.1f)
+       << "<sigmoid> " << hidden << " " << hidden << "\n"
+       << "<biasedlinearity> " << classes << " " << hidden << "\n"
+       << RandomText(classes, hidden, scale_hid) << RandomText(0, classes, 0.1f)
+       << "<softmax> " << classes << " " << classes << "\n";
+
+  TestWriteFile(dir + "/ref.mlf", mlf.str());
+  TestWriteFile(dir + "/train.scp", train.str());
+  TestWriteFile(dir + "/cv.scp", cv.str());
+  TestWriteFile(dir + "/states", states.str());
+  TestWriteFile(dir + "/nnet.init", nnet.str());
+  return 0;
+}
@@ -0,0 +1,135 @@
+/** @file Test.h
+ *  Helpers of the test programs in this directory.
+ *
+ *  Each test program checks one module, it prints the failed checks
+ *  and returns non-zero when any of them failed (see 'make test').
+ */
+
+#ifndef TNET_Test_h
+#define TNET_Test_h
+
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+
+namespace TNet {
+
+  /// Number of the failed checks of the test program
+  static int gTestFailures = 0;
+
+  /// Report the failed check
+  inline void
+  TestFail(const char* pFile, int line, const std::string& rWhat)
+  {
+    std::cerr << pFile << ":" << line << ": check failed: " << rWhat << std::endl;
+    gTestFailures++;
+  }
+
+  /// Print the result of the test program, returns its exit status
+  inline int
+  TestResult(const char* pName)
+  {
+    std::cout << pName << (gTestFailures ? ": FAILED " : ": OK") ;
+    if(gTestFailures) std::cout << gTestFailures << " checks";
+    std::cout << std::endl;
+    return gTestFailures ? 1 : 0;
+  }
+
+  /// Create a temporary directory for the files of the test
+  inline std::string
+  TestTmpDir()
+  {
+    const char* p_tmp = getenv("TMPDIR");
+    std::string dir = std::string(p_tmp ? p_tmp : "/tmp") + "/tnet_test.XXXXXX";
+    if(NULL == mkdtemp(&dir[0])) {
+      std::cerr << "Cannot create temporary directory: " << dir << std::endl;
+      exit(1);
+    }
+    return dir;
+  }
+
+  /// Deterministic pseudo-random number in [-1,1)
+  inline float
+  TestRand()
+  {
+    static unsigned int state = 12345;
+    state = state * 1103515245u + 12345u;
+    return static_cast<float>((state >> 8) & 0xffff) / 32768.0f - 1.0f;
+  }
+
+  /// Random matrix "m rows cols" or vector "v cols" (rows 0) in the text model format
+  inline std::string
+  TestRandomText(size_t rows, size_t cols)
+  {
+    std::ostringstream os;
+    if(rows > 0) os << "m " << rows << " " << cols << "\n";
+    else os << "v " << cols << "\n";
+    for(size_t r=0; r<std::max<size_t>(rows,1); r++) {
+      for(size_t c=0; c<cols; c++) os << TestRand() << " ";
+      os << "\n";
+    }
+    return os.str();
+  }
+
+  /// Write the string to the file
+  inline void
+  TestWriteFile(const std::string& rFile, const std::string& rContent)
+  {
+    std::ofstream os(rFile.c_str(), std::ios::out | std::ios::binary);
+    os << rContent;
+    if(!os.good()) {
+      std::cerr << "Cannot write: " << rFile << std::endl;
+      exit(1);
+    }
+  }
+
+  /// Read the whole file to a string
+  inline std::string
+  TestReadFile(const std::string& rFile)
+  {
+    std::ifstream is(rFile.c_str(), std::ios::in | std::ios::binary);
+    std::ostringstream os;
+    os << is.rdbuf();
+    return os.str();
+  }
+
+  /// Remove the temporary directory of the test
+  inline void
+  TestRmDir(const std::string& rDir)
+  {
+    std::string cmd = "rm -rf '" + rDir + "'";
+    if(system(cmd.c_str()) != 0) {
+      std::cerr << "Cannot remove: " << rDir << std::endl;
+    }
+  }
+
+} //namespace TNet
+
+#define TEST_CHECK(cond) \
+  do { if(!(cond)) TNet::TestFail(__FILE__, __LINE__, #cond); } while(0)
+
+/// |a-b| <= tol, with the values in the message
+#define TEST_CHECK_CLOSE(a, b, tol) \
+  do { \
+    double test_a_ = (a), test_b_ = (b); \
+    if(!(std::fabs(test_a_ - test_b_) <= (tol))) { \
+      std::ostringstream test_os_; \
+      test_os_ << #a " = " << test_a_ << ", " #b " = " << test_b_ << ", tol " << (tol); \
+      TNet::TestFail(__FILE__, __LINE__, test_os_.str()); \
+    } \
+  } while(0)
+
+/// The statement must throw an exception
+#define TEST_CHECK_THROW(statement) \
+  do { \
+    bool test_thrown_ = false; \
+    try { statement; } catch(std::exception&) { test_thrown_ = true; } \
+    if(!test_thrown_) TNet::TestFail(__FILE__, __LINE__, "no exception: " #statement); \
+  } while(0)
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * AddRows and Network::AccuGradient: the gradients of all the clones
+ * summed in one pass, by any number of threads, equal the naive sum
+ * of the gradients of the single clones.
+ */
+
+#include "Test.h"
+
+#include "Nnet.h"
+#include "Matrix.h"
+
+#include <vector>
+
+using namespace TNet;
+
+
+/// Matrix with random values
+static void RandomMatrix(Matrix<BaseFloat>& rM, size_t rows, size_t cols)
+{
+  rM.Init(rows, cols);
+  for(size_t r=0; r<rows; r++) {
+    for(size_t c=0; c<cols; c++) rM(r,c) = TestRand();
+  }
+}
+
+
+/// AddRows against the loop over the sources,
+/// the columns span several blocks of the one-pass sum
+static void CheckAddRows()
+{
+  const size_t rows = 9, cols = 1100, origin = 3;
+  std::vector<Matrix<BaseFloat> > src(4);
+  std::vector<const Matrix<BaseFloat>*> p_src;
+  for(size_t s=0; s<src.size(); s++) {
+    RandomMatrix(src[s], origin+rows+2, cols);
+    p_src.push_back(&src[s]);
+  }
+  Matrix<double> dst(rows, cols), ref(rows, cols);
+  for(size_t r=0; r<rows; r++) {
+    for(size_t c=0; c<cols; c++) dst(r,c) = ref(r,c) = TestRand();
+  }
+
+  AddRows(dst, p_src, origin);
+  for(size_t s=0; s<src.size(); s++) {
+    for(size_t r=0; r<rows; r++) {
+      for(size_t c=0; c<cols; c++) ref(r,c) += src[s](origin+r,c);
+    }
+  }
+  bool same = true;
+  for(size_t r=0; r<rows; r++) {
+    for(size_t c=0; c<cols; c++) same = same && dst(r,c) == ref(r,c);
+  }
+  TEST_CHECK(same);
+}
+
+
+/// Accumulated gradients of the updatable layers
+static void GetAccu(Network& rNet, std::vector<Matrix<double> >& rLin, std::vector<Vector<double> >& rBias)
+{
+  rLin.clear(); rBias.clear();
+  for(int i=0; i<rNet.Layers(); i++) {
+    if(!rNet.Layer(i).IsUpdatable()) continue;
+    UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(rNet.Layer(i));
+    rLin.push_back(comp.LinearityAccu(false));
+    rBias.push_back(comp.BiasAccu());
+  }
+}
+
+
+int main()
+{
+  CheckAddRows();
+
+  std::string dir = TestTmpDir();
+  std::ostringstream os;
+  os << "<biasedlinearity> 7 5\n" << TestRandomText(7, 5) << TestRandomText(0, 7)
+     << "<sigmoid> 7 7\n"
+     << "<sharedlinearity> 6 7\n1\n" << TestRandomText(6, 7) << TestRandomText(0, 6)
+     << "<softmax> 6 6\n";
+  TestWriteFile(dir + "/nnet.txt", os.str());
+  Network net;
+  net.ReadNetwork((dir + "/nnet.txt").c_str());
+
+  //the clones compute their gradients on their bunches
+  const int clones = 3;
+  std::vector<Network*> clone(clones);
+  std::vector<const Network*> p_clone;
+  for(int k=0; k<clones; k++) {
+    clone[k] = net.Clone();
+    Matrix<BaseFloat> in, err, out;
+    RandomMatrix(in, 11, 5);
+    RandomMatrix(err, 11, 6);
+    clone[k]->Propagate(in, out);
+    clone[k]->Backpropagate(err);
+    p_clone.push_back(clone[k]);
+  }
+
+  //the naive sum of the gradients of the single clones,
+  //the accumulators are in the networks which own the weights (not the clones)
+  std::vector<Matrix<double> > ref_lin, lin;
+  std::vector<Vector<double> > ref_bias, bias;
+  for(int k=0; k<clones; k++) {
+    Network single;
+    single.ReadNetwork((dir + "/nnet.txt").c_str());
+    single.AccuGradient(std::vector<const Network*>(1, clone[k]), 0, 1);
+    GetAccu(single, lin, bias);
+    if(k == 0) {
+      ref_lin = lin; ref_bias = bias;
+    } else {
+      for(size_t l=0; l<lin.size(); l++) {
+        ref_lin[l].Add(lin[l]);
+        ref_bias[l].Add(bias[l]);
+      }
+    }
+  }
+  //the weights are stored transposed, inputs x outputs
+  TEST_CHECK(ref_lin.size() == 2 && ref_lin[0].Rows() == 5 && ref_lin[1].Rows() == 7);
+  TEST_CHECK(ref_lin[0](0,0) != 0.0 && ref_bias[1][0] != 0.0);
+
+  //one pass over all the clones by the parts of the threads,
+  //also more threads than the rows
+  const int threads[] = { 1, 2, 3, 10 };
+  for(size_t t=0; t<sizeof(threads)/sizeof(threads[0]); t++) {
+    Network sum;
+    sum.ReadNetwork((dir + "/nnet.txt").c_str());
+    for(int thr=0; thr<threads[t]; thr++) {
+      sum.AccuGradient(p_clone, thr, threads[t]);
+    }
+    GetAccu(sum, lin, bias);
+    TEST_CHECK(lin.size() == 2 && ref_lin.size() == 2);
+    for(size_t l=0; l<lin.size(); l++) {
+      bool same = true;
+      for(size_t r=0; r<lin[l].Rows(); r++) {
+        for(size_t c=0; c<lin[l].Cols(); c++) same = same && lin[l](r,c) == ref_lin[l](r,c);
+      }
+      for(size_t i=0; i<bias[l].Dim(); i++) same = same && bias[l][i] == ref_bias[l][i];
+      TEST_CHECK(same);
+    }
+  }
+
+  for(int k=0; k<clones; k++) delete clone[k];
+  TestRmDir(dir);
+  return TestResult("TestAccuGradient");
+}
@@ -0,0 +1,59 @@
+#!/bin/sh
+# PARALLELMODE=async: the threads update the shared weights without the
+# barriers; the training finishes when the threads have unequal numbers
+# of bunches (the last caches of different sizes, a thread without any
+# data, MAXSTALENESS=0), the weights are trained about as well as by the
+# synchronous update.
+#
+# sh TestAsync.sh <dir of TNet>
+
+BIN=${1:-..}
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/tnet_test.XXXXXX") || exit 1
+trap 'rm -rf "$DIR"' EXIT
+FAILURES=0
+
+check() {
+  if ! eval "$1"; then
+    echo "TestAsync.sh: check failed: $1" >&2
+    FAILURES=$((FAILURES+1))
+  fi
+}
+
+#train $DIR/data to $DIR/nnet.<name>, a deadlock is stopped by the timeout
+train() {
+  NAME=$1; shift
+  timeout 300 "$BIN"/TNet -S "$DIR"/data/train.scp -H "$DIR"/data/nnet.init \
+    --TARGETMMF="$DIR"/nnet.$NAME $COMMON "$@" > "$DIR"/$NAME.log 2>&1
+  check "[ $? -eq 0 ]"
+  check "grep -q 'TNET FINISHED' $DIR/$NAME.log"
+}
+
+#the CV error per frame of the network
+cv_error() {
+  "$BIN"/TNet -c -S "$DIR"/data/cv.scp -H "$1" $COMMON 2>&1 | sed -n 's/^-- CV .*err\/frm:\([^ ]*\) .*/\1/p'
+}
+
+./GenData "$DIR"/data 40 > /dev/null || exit 1
+COMMON="-I $DIR/data/ref.mlf -m $DIR/data/states --BUNCHSIZE=64 --CACHESIZE=1024 --LEARNINGRATE=0.001 --SEED=7 --SAVEBINARY=T"
+
+train sync --THREADS=3 --PARALLELMODE=sync
+train async --THREADS=3 --PARALLELMODE=async
+check "! cmp -s $DIR/nnet.async $DIR/data/nnet.init"
+INIT=$(cv_error "$DIR"/data/nnet.init)
+SYNC=$(cv_error "$DIR"/nnet.sync)
+ASYNC=$(cv_error "$DIR"/nnet.async)
+#a plausible update: better than the initial network, close to the sync one
+check "awk -v a=$ASYNC -v s=$SYNC -v i=$INIT 'BEGIN { exit !(a < i && a < 1.05*s) }'"
+
+#the threads wait for each other in every bunch
+train lockstep --THREADS=4 --PARALLELMODE=async --MAXSTALENESS=0
+
+#more threads than the training utterances, a thread gets no data
+./GenData "$DIR"/data 6 > /dev/null || exit 1
+train idle --THREADS=6 --PARALLELMODE=async --MAXSTALENESS=1
+
+if [ $FAILURES -ne 0 ]; then
+  echo "TestAsync: FAILED $FAILURES checks"
+  exit 1
+fi
+echo "TestAsync: OK"
@@ -0,0 +1,61 @@
+#!/bin/sh
+# PARALLELMODE=average: a single thread averages its own model, so the run
+# equals PARALLELMODE=sync; the cross-validation of several threads scores
+# the shared weights as sync does; three threads averaged every two bunches
+# train a model better than the initial one.
+#
+# sh TestAverage.sh <dir of TNet>
+
+BIN=${1:-..}
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/tnet_test.XXXXXX") || exit 1
+trap 'rm -rf "$DIR"' EXIT
+FAILURES=0
+
+check() {
+  if ! eval "$1"; then
+    echo "TestAverage.sh: check failed: $1" >&2
+    FAILURES=$((FAILURES+1))
+  fi
+}
+
+#train $DIR to $DIR/nnet.<name>
+train() {
+  NAME=$1; shift
+  "$BIN"/TNet -S "$DIR"/train.scp -H "$DIR"/nnet.init \
+    --TARGETMMF="$DIR"/nnet.$NAME $COMMON "$@" > "$DIR"/$NAME.log 2>&1
+  check "[ $? -eq 0 ]"
+}
+
+#the CV line of the network
+cv() {
+  NET=$1; shift
+  "$BIN"/TNet -c -S "$DIR"/cv.scp -H "$NET" $COMMON "$@" 2>&1 | sed -n 's/^-- CV //p'
+}
+
+#the CV error per frame of the network
+cv_error() {
+  cv "$1" | sed -n 's/.*err\/frm:\([^ ]*\) .*/\1/p'
+}
+
+./GenData "$DIR" 30 > /dev/null || exit 1
+COMMON="-I $DIR/ref.mlf -m $DIR/states --BUNCHSIZE=64 --CACHESIZE=1024 --LEARNINGRATE=0.001 --SEED=7 --SAVEBINARY=T"
+
+train sync --THREADS=1 --PARALLELMODE=sync
+train average --THREADS=1 --PARALLELMODE=average
+check "cmp -s $DIR/nnet.sync $DIR/nnet.average"
+
+#the cross-validation neither detaches nor averages the weights
+SYNC=$(cv "$DIR"/nnet.sync --THREADS=3 --PARALLELMODE=sync)
+AVERAGE=$(cv "$DIR"/nnet.sync --THREADS=3 --PARALLELMODE=average)
+check "[ -n \"$SYNC\" ] && [ \"$SYNC\" = \"$AVERAGE\" ]"
+
+train average3 --THREADS=3 --PARALLELMODE=average --AVERAGEBUNCHES=2 --LEARNINGRATE=0.01
+INIT=$(cv_error "$DIR"/nnet.init)
+AVERAGE3=$(cv_error "$DIR"/nnet.average3)
+check "awk -v a=$AVERAGE3 -v i=$INIT 'BEGIN { exit !(a < i) }'"
+
+if [ $FAILURES -ne 0 ]; then
+  echo "TestAverage: FAILED $FAILURES checks"
+  exit 1
+fi
+echo "TestAverage: OK"
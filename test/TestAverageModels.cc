@@ -0,0 +1,124 @@
+/*
+ * Network::AccuWeights and AverageWeights (PARALLELMODE=average): the
+ * averaged model is the frame-weighted mean of the models of the workers,
+ * summed by any number of threads; the accumulators are reset by the
+ * averaging; CopyWeights starts the workers from the mean.
+ */
+
+#include "Test.h"
+
+#include "Nnet.h"
+#include "Matrix.h"
+
+#include <vector>
+
+using namespace TNet;
+
+
+/// All the numbers of the network in the text format (weights and sizes)
+static std::vector<double> Numbers(Network& rNet)
+{
+  std::ostringstream os;
+  rNet.WriteNetwork(os);
+  std::istringstream is(os.str());
+  std::vector<double> numbers;
+  std::string token;
+  while(is >> token) {
+    char* end;
+    double val = strtod(token.c_str(), &end);
+    if(*end == '\0') numbers.push_back(val);
+  }
+  return numbers;
+}
+
+
+/// Matrix with random values
+static void RandomMatrix(Matrix<BaseFloat>& rM, size_t rows, size_t cols)
+{
+  rM.Init(rows, cols);
+  for(size_t r=0; r<rows; r++) {
+    for(size_t c=0; c<cols; c++) rM(r,c) = TestRand();
+  }
+}
+
+
+/// Max difference of the numbers relative to the values above 1,
+/// a large value if the counts differ
+static double MaxDiff(const std::vector<double>& rA, const std::vector<double>& rB)
+{
+  if(rA.size() != rB.size()) return 1e30;
+  double max_diff = 0.0;
+  for(size_t i=0; i<rA.size(); i++) {
+    max_diff = std::max(max_diff, std::fabs(rA[i] - rB[i]) / std::max(1.0, std::fabs(rB[i])));
+  }
+  return max_diff;
+}
+
+
+int main()
+{
+  std::ostringstream os;
+  os << "<biasedlinearity> 7 5\n" << TestRandomText(7, 5) << TestRandomText(0, 7)
+     << "<sigmoid> 7 7\n"
+     << "<sharedlinearity> 6 7\n1\n" << TestRandomText(6, 7) << TestRandomText(0, 6)
+     << "<softmax> 6 6\n";
+  std::istringstream is(os.str());
+  Network net;
+  net.ReadNetwork(is);
+
+  //the workers take local SGD steps on their own weights
+  const int workers = 3;
+  const double frames[workers] = { 64.0, 128.0, 37.0 };
+  const double total = frames[0] + frames[1] + frames[2];
+  std::vector<Network*> worker(workers);
+  std::vector<std::vector<double> > numbers(workers);
+  for(int k=0; k<workers; k++) {
+    worker[k] = net.Clone();
+    worker[k]->DetachWeights();
+    worker[k]->SetLearnRate(0.5f);
+    Matrix<BaseFloat> in, err, out;
+    RandomMatrix(in, 11, 5);
+    RandomMatrix(err, 11, 6);
+    worker[k]->Propagate(in, out);
+    worker[k]->Backpropagate(err);
+    worker[k]->ApplyGradient(*worker[k], 0, 1);
+    numbers[k] = Numbers(*worker[k]);
+  }
+  //the workers differ from the initial model and from each other
+  std::vector<double> init = Numbers(net);
+  TEST_CHECK(MaxDiff(numbers[0], init) > 1e-3 && MaxDiff(numbers[0], numbers[1]) > 1e-3);
+
+  std::vector<double> mean(init.size(), 0.0);
+  for(int k=0; k<workers; k++) {
+    for(size_t i=0; i<mean.size() && i<numbers[k].size(); i++) {
+      mean[i] += frames[k] / total * numbers[k][i];
+    }
+  }
+
+  //the rows summed by the parts of the threads, also more threads than rows
+  const int threads[] = { 1, 4, 9 };
+  for(size_t t=0; t<sizeof(threads)/sizeof(threads[0]); t++) {
+    for(int thr=0; thr<threads[t]; thr++) {
+      for(int k=0; k<workers; k++) {
+        net.AccuWeights(*worker[k], frames[k] / total, thr, threads[t]);
+      }
+    }
+    for(int thr=0; thr<threads[t]; thr++) {
+      net.AverageWeights(thr, threads[t]);
+    }
+    //the text format keeps 6-7 digits
+    TEST_CHECK(MaxDiff(Numbers(net), mean) < 1e-5);
+  }
+
+  //a single worker of all the frames: its model, the mean was not kept
+  net.AccuWeights(*worker[1], 1.0, 0, 1);
+  net.AverageWeights(0, 1);
+  TEST_CHECK(MaxDiff(Numbers(net), numbers[1]) < 1e-6);
+
+  //the workers continue from the average
+  worker[0]->CopyWeights(net);
+  TEST_CHECK(Numbers(*worker[0]) == Numbers(net));
+
+  for(int k=0; k<workers; k++) delete worker[k];
+  return TestResult("TestAverageModels");
+}
@@ -0,0 +1,157 @@
+/*
+ * BlockingQueue: the items of several producers reach several consumers
+ * once each and in the order of each producer, Push() waits while the queue
+ * is full, Pop() waits for the data and returns false when the queue is
+ * closed and empty, a consumer waiting in Pop() is woken by Close().
+ */
+
+#include "Test.h"
+
+#include "BlockingQueue.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace TNet;
+
+
+static const int kProducers = 3;
+static const int kConsumers = 4;
+static const int kItems = 20000;
+
+/// The items of producer p are p*kItems+i
+struct Shared {
+  BlockingQueue<int> queue;
+  std::vector<int> count;     ///< times each item was taken
+  int out_of_order;           ///< items taken after a later one of the producer
+  pthread_mutex_t mutex;
+
+  Shared() : queue(2), count(kProducers*kItems, 0), out_of_order(0)
+  { pthread_mutex_init(&mutex, NULL); }
+  ~Shared()
+  { pthread_mutex_destroy(&mutex); }
+};
+
+static Shared* gpShared;
+
+
+static void* Producer(void* arg)
+{
+  int p = static_cast<int>(reinterpret_cast<intptr_t>(arg));
+  for(int i=0; i<kItems; i++) {
+    gpShared->queue.Push(p*kItems+i);
+  }
+  return NULL;
+}
+
+
+static void* Consumer(void*)
+{
+  //last item of each producer taken by this consumer
+  std::vector<int> last(kProducers, -1);
+  int item;
+  while(gpShared->queue.Pop(item)) {
+    int p = item / kItems;
+    pthread_mutex_lock(&gpShared->mutex);
+    gpShared->count[item]++;
+    if(item <= last[p]) gpShared->out_of_order++;
+    pthread_mutex_unlock(&gpShared->mutex);
+    last[p] = item;
+  }
+  return NULL;
+}
+
+
+/// Several producers and consumers through the queue of capacity 2
+static void CheckProducersConsumers()
+{
+  Shared shared;
+  gpShared = &shared;
+  pthread_t prod[kProducers], cons[kConsumers];
+  for(int c=0; c<kConsumers; c++) pthread_create(&cons[c], NULL, Consumer, NULL);
+  for(intptr_t p=0; p<kProducers; p++) {
+    pthread_create(&prod[p], NULL, Producer, reinterpret_cast<void*>(p));
+  }
+  for(int p=0; p<kProducers; p++) pthread_join(prod[p], NULL);
+  shared.queue.Close();
+  for(int c=0; c<kConsumers; c++) pthread_join(cons[c], NULL);
+
+  int wrong = 0;
+  for(size_t i=0; i<shared.count.size(); i++) {
+    if(shared.count[i] != 1) wrong++;
+  }
+  TEST_CHECK(wrong == 0);
+  TEST_CHECK(shared.out_of_order == 0);
+  TEST_CHECK(shared.queue.Size() == 0);
+}
+
+
+static BlockingQueue<int>* gpQueue;
+static volatile int gPushed;
+
+static void* PushTwo(void*)
+{
+  gpQueue->Push(1);
+  gpQueue->Push(2);
+  gPushed = 2;
+  return NULL;
+}
+
+static void* PopOne(void*)
+{
+  int item;
+  return gpQueue->Pop(item) ? gpQueue : NULL;
+}
+
+
+/// The full queue holds the producer, the closed one releases the consumer
+static void CheckBlocking()
+{
+  BlockingQueue<int> queue(1);
+  gpQueue = &queue;
+  gPushed = 0;
+  pthread_t thr;
+  pthread_create(&thr, NULL, PushTwo, NULL);
+  usleep(100000);
+  //the second item waits for the room
+  TEST_CHECK(gPushed == 0 && queue.Size() == 1);
+  int item = 0;
+  TEST_CHECK(queue.Pop(item) && item == 1);
+  pthread_join(thr, NULL);
+  TEST_CHECK(gPushed == 2);
+  TEST_CHECK(queue.Pop(item) && item == 2);
+
+  //the consumer waits in Pop() until the queue is closed
+  void* ret = &queue;
+  pthread_create(&thr, NULL, PopOne, NULL);
+  usleep(100000);
+  queue.Close();
+  pthread_join(thr, &ret);
+  TEST_CHECK(ret == NULL);
+  TEST_CHECK(!queue.Pop(item));
+  TEST_CHECK_THROW(queue.Push(3));
+}
+
+
+/// The items left in the closed queue are still delivered
+static void CheckCloseDrains()
+{
+  BlockingQueue<int> queue(3);
+  queue.Push(7);
+  queue.Push(8);
+  queue.Close();
+  int item = 0;
+  TEST_CHECK(queue.Pop(item) && item == 7);
+  TEST_CHECK(queue.Pop(item) && item == 8);
+  TEST_CHECK(!queue.Pop(item));
+}
+
+
+int main()
+{
+  CheckProducersConsumers();
+  CheckBlocking();
+  CheckCloseDrains();
+  return TestResult("TestBlockingQueue");
+}
@@ -0,0 +1,98 @@
+/*
+ * Cache: the randomized bunches gather every row of the cache once, the
+ * features stay paired with their targets, the order is a permutation
+ * given by the seed; without Randomize() the rows come in the intake order;
+ * the incomplete bunch of the last cache is discarded.
+ */
+
+#include "Test.h"
+
+#include "Cache.h"
+#include "Matrix.h"
+
+#include <vector>
+
+using namespace TNet;
+
+
+/// Rows of the utterance numbered from 'first': features (id, 2*id, ...), target -id
+static void Utterance(size_t first, size_t rows, Matrix<BaseFloat>& rFea, Matrix<BaseFloat>& rDes)
+{
+  rFea.Init(rows, 3);
+  rDes.Init(rows, 2);
+  for(size_t r=0; r<rows; r++) {
+    BaseFloat id = static_cast<BaseFloat>(first + r);
+    for(size_t c=0; c<rFea.Cols(); c++) rFea(r,c) = id * static_cast<BaseFloat>(c+1);
+    rDes(r,0) = -id;
+    rDes(r,1) = 0.0f;
+  }
+}
+
+
+/// Fills the cache of 'cachesize' rows by utterances of 'utt' rows,
+/// returns the row ids of all its bunches
+static std::vector<int> Bunches(size_t cachesize, size_t bunchsize, size_t utt,
+                                size_t rows, bool randomize, long int seed)
+{
+  Cache cache;
+  cache.Init(cachesize, bunchsize, seed);
+  Matrix<BaseFloat> fea, des, fea_bunch, des_bunch;
+  size_t first = 0;
+  while(!cache.Full() && first < rows) {
+    Utterance(first, std::min(utt, rows-first), fea, des);
+    cache.AddData(fea, des);
+    first += fea.Rows();
+  }
+  if(randomize) cache.Randomize();
+
+  std::vector<int> ids;
+  while(!cache.Empty()) {
+    cache.GetBunch(fea_bunch, des_bunch);
+    TEST_CHECK(fea_bunch.Rows() == bunchsize && des_bunch.Rows() == bunchsize);
+    for(size_t r=0; r<fea_bunch.Rows(); r++) {
+      BaseFloat id = -des_bunch(r,0);
+      //the features of the row came with its target
+      TEST_CHECK(fea_bunch(r,0) == id && fea_bunch(r,2) == 3.0f*id);
+      ids.push_back(static_cast<int>(id));
+    }
+  }
+  return ids;
+}
+
+
+int main()
+{
+  //full cache, utterances across the cache end
+  std::vector<int> ids = Bunches(96, 16, 25, 1000, true, 3);
+  TEST_CHECK(ids.size() == 96);
+  std::vector<int> sorted(ids);
+  std::sort(sorted.begin(), sorted.end());
+  bool permutation = true, identity = true;
+  for(size_t i=0; i<sorted.size(); i++) {
+    if(sorted[i] != static_cast<int>(i)) permutation = false;
+    if(ids[i] != static_cast<int>(i)) identity = false;
+  }
+  TEST_CHECK(permutation);
+  TEST_CHECK(!identity);
+  //the same seed, the same order, another one differs
+  TEST_CHECK(Bunches(96, 16, 25, 1000, true, 3) == ids);
+  TEST_CHECK(Bunches(96, 16, 25, 1000, true, 4) != ids);
+
+  //not randomized, the intake order
+  ids = Bunches(96, 16, 25, 1000, false, 3);
+  identity = (ids.size() == 96);
+  for(size_t i=0; i<ids.size(); i++) {
+    if(ids[i] != static_cast<int>(i)) identity = false;
+  }
+  TEST_CHECK(identity);
+
+  //the last cache of 70 rows gives 4 bunches, 6 rows are discarded
+  ids = Bunches(96, 16, 25, 70, true, 5);
+  TEST_CHECK(ids.size() == 64);
+  sorted = ids;
+  std::sort(sorted.begin(), sorted.end());
+  TEST_CHECK(std::unique(sorted.begin(), sorted.end()) == sorted.end());
+  TEST_CHECK(sorted.front() >= 0 && sorted.back() < 70);
+
+  return TestResult("TestCache");
+}
@@ -0,0 +1,71 @@
+#!/bin/sh
+# EPOCHS with CVSCRIPT (newbob): a diverged epoch is rejected, the weights
+# and the momentum are rolled back, so the next epoch trains as a fresh run
+# from the initial network; re-scoring the final network gives its last
+# CV error; the cached data give the same network as the read data;
+# of two training processes the process 0 cross-validates and both
+# accept or reject the epochs alike.
+#
+# sh TestEpochs.sh <dir of TNet>
+
+BIN=${1:-..}
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/tnet_test.XXXXXX") || exit 1
+trap 'rm -rf "$DIR"' EXIT
+FAILURES=0
+
+check() {
+  if ! eval "$1"; then
+    echo "TestEpochs.sh: check failed: $1" >&2
+    FAILURES=$((FAILURES+1))
+  fi
+}
+
+./GenData "$DIR" 40 || exit 1
+COMMON="-I $DIR/ref.mlf -m $DIR/states --BUNCHSIZE=64 --CACHESIZE=2048 --THREADS=2 --MOMENTUM=0.5 --SAVEBINARY=T"
+
+#epoch 1 diverges (LEARNINGRATE=2) and is rejected, epoch 2 (seed 8)
+#trains by the halved rate 2/2048 from the initial weights
+"$BIN"/TNet -S "$DIR"/train.scp -H "$DIR"/nnet.init --TARGETMMF="$DIR"/nnet.newbob $COMMON \
+  --SEED=7 --EPOCHS=2 --CVSCRIPT="$DIR"/cv.scp --LEARNINGRATE=2 \
+  --HALVINGFACTOR=0.00048828125 --ENDHALVING=-1 > "$DIR"/newbob.log 2>&1
+check "[ $? -eq 0 ]"
+check "grep -q '^EPOCH 1 rejected' $DIR/newbob.log"
+check "grep -q '^EPOCH 2 accepted' $DIR/newbob.log"
+
+#the single epoch from the initial weights
+"$BIN"/TNet -S "$DIR"/train.scp -H "$DIR"/nnet.init --TARGETMMF="$DIR"/nnet.single $COMMON \
+  --SEED=8 --LEARNINGRATE=0.0009765625 > "$DIR"/single.log 2>&1
+check "[ $? -eq 0 ]"
+check "cmp -s $DIR/nnet.newbob $DIR/nnet.single"
+
+#the final network scores the CV data as its epoch did (not randomized)
+"$BIN"/TNet -c -S "$DIR"/cv.scp -H "$DIR"/nnet.newbob $COMMON --RANDOMIZE=F > "$DIR"/cv.log 2>&1
+check "[ $? -eq 0 ]"
+check "[ \"\$(sed -n 's/^EPOCH 2 CV //p' $DIR/newbob.log)\" = \"\$(sed -n 's/^-- CV //p' $DIR/cv.log)\" ]"
+
+#the same schedule on the data cached in RAM
+"$BIN"/TNet -S "$DIR"/train.scp -H "$DIR"/nnet.init --TARGETMMF="$DIR"/nnet.cached $COMMON \
+  --SEED=7 --EPOCHS=2 --CVSCRIPT="$DIR"/cv.scp --LEARNINGRATE=2 \
+  --HALVINGFACTOR=0.00048828125 --ENDHALVING=-1 --CACHEDATA=T > "$DIR"/cached.log 2>&1
+check "[ $? -eq 0 ]"
+check "cmp -s $DIR/nnet.newbob $DIR/nnet.cached"
+
+#two processes averaging their models, the same schedule
+for RANK in 0 1; do
+  "$BIN"/TNet -S "$DIR"/train.scp -H "$DIR"/nnet.init --TARGETMMF="$DIR"/nnet.workers $COMMON \
+    --SEED=7 --EPOCHS=2 --CVSCRIPT="$DIR"/cv.scp --LEARNINGRATE=2 \
+    --HALVINGFACTOR=0.00048828125 --ENDHALVING=-1 --PARALLELMODE=average \
+    --WORKERS=2 --WORKERRANK=$RANK --WORKERSOCKET="$DIR"/ring > "$DIR"/worker$RANK.log 2>&1 &
+done
+wait
+check "grep -q 'TNET FINISHED' $DIR/worker0.log && grep -q 'TNET FINISHED' $DIR/worker1.log"
+check "[ -s $DIR/nnet.workers ]"
+check "grep -q '^EPOCH 2 CV' $DIR/worker0.log && ! grep -q '^EPOCH [0-9]* CV' $DIR/worker1.log"
+check "grep -q '^EPOCH 1 rejected' $DIR/worker0.log"
+check "[ \"\$(grep '^EPOCH [0-9]* [ar]' $DIR/worker0.log)\" = \"\$(grep '^EPOCH [0-9]* [ar]' $DIR/worker1.log)\" ]"
+
+if [ $FAILURES -ne 0 ]; then
+  echo "TestEpochs: FAILED $FAILURES checks"
+  exit 1
+fi
+echo "TestEpochs: OK"
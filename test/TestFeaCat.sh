@@ -0,0 +1,64 @@
+#!/bin/sh
+# TFeaCat THREADS: the pipeline of the forward threads writes the files
+# of the single-threaded run, byte for byte and in the order of the list,
+# also with BATCHFRAMES (the utterances forwarded in the frame batches),
+# and for the tickets of more batches than the pipeline holds.
+#
+# sh TestFeaCat.sh <dir of TNet>
+
+BIN=${1:-..}
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/tnet_test.XXXXXX") || exit 1
+trap 'rm -rf "$DIR"' EXIT
+FAILURES=0
+
+check() {
+  if ! eval "$1"; then
+    echo "TestFeaCat.sh: check failed: $1" >&2
+    FAILURES=$((FAILURES+1))
+  fi
+}
+
+#run TFeaCat to the directory $DIR/<name>, TRACE=2 lists the written files
+feacat() {
+  NAME=$1; shift
+  mkdir -p "$DIR"/$NAME
+  "$BIN"/TFeaCat -H "$DIR"/nnet.init -S "$DIR"/train.scp -l "$DIR"/$NAME -y out -T 2 "$@" \
+    > "$DIR"/$NAME.log 2>&1
+  check "[ $? -eq 0 ]"
+  sed -n 's|^Written: .*/||p' "$DIR"/$NAME.log > "$DIR"/$NAME.order
+}
+
+#the files are identical to those of 'ref', written in the same order
+same() {
+  check "[ \$(wc -l < $DIR/$1.order) -eq \$(wc -l < $DIR/train.scp) ]"
+  check "cmp -s $DIR/$1.order $DIR/$2.order"
+  for f in $(cat "$DIR"/$1.order); do
+    check "cmp -s $DIR/$1/$f $DIR/$2/$f"
+  done
+}
+
+./GenData "$DIR" 40 || exit 1
+sed 's|.*/||; s|\.fea$|.out|' "$DIR"/train.scp > "$DIR"/list.order
+
+feacat single --THREADS=1
+check "cmp -s $DIR/single.order $DIR/list.order"
+feacat threads --THREADS=3
+same threads single
+
+#the frame batches of several utterances and of single ones (fewer frames
+#than an utterance); the GEMMs of the batches round otherwise than those
+#of the single utterances, the threads give the single-threaded batches
+for FRAMES in 1000 10; do
+  feacat batch$FRAMES --THREADS=1 --BATCHFRAMES=$FRAMES
+  check "cmp -s $DIR/batch$FRAMES.order $DIR/list.order"
+  feacat batch${FRAMES}_threads --THREADS=3 --BATCHFRAMES=$FRAMES
+  same batch${FRAMES}_threads batch$FRAMES
+done
+#the batch of a single utterance is forwarded as the utterance alone
+same batch10_threads single
+
+if [ $FAILURES -ne 0 ]; then
+  echo "TestFeaCat: FAILED $FAILURES checks"
+  exit 1
+fi
+echo "TestFeaCat: OK"
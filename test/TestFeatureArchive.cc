@@ -0,0 +1,172 @@
+/*
+ * Round-trip of the packed feature archive (FeatureArchiveWriter,
+ * FeatureRepository), the addressing of the entries by number and name,
+ * and the HTK files with '#' in their names.
+ */
+
+#include "Test.h"
+
+#include "Features.h"
+#include "Matrix.h"
+#include "Common.h"
+
+using namespace TNet;
+
+
+/// Matrix with distinct values
+static void FillMatrix(Matrix<BaseFloat>& rM, size_t rows, size_t cols, float offset)
+{
+  rM.Init(rows, cols);
+  for(size_t r=0; r<rows; r++) {
+    for(size_t c=0; c<cols; c++) {
+      rM(r,c) = offset + 0.25f*static_cast<float>(r) - 0.125f*static_cast<float>(c);
+    }
+  }
+}
+
+
+/// Max relative difference of the rows [from, from+rM.Rows()) of rRef
+static double MaxRelDiff(const Matrix<BaseFloat>& rM, const Matrix<BaseFloat>& rRef, size_t from = 0)
+{
+  if(rM.Cols() != rRef.Cols() || from + rM.Rows() > rRef.Rows()) return 1e30;
+  double max_diff = 0.0;
+  for(size_t r=0; r<rM.Rows(); r++) {
+    for(size_t c=0; c<rM.Cols(); c++) {
+      double ref = rRef(from+r,c);
+      double diff = std::fabs(rM(r,c) - ref) / std::max(1.0, std::fabs(ref));
+      if(diff > max_diff) max_diff = diff;
+    }
+  }
+  return max_diff;
+}
+
+
+/// Repository reading the USER features as they are stored
+static void InitRepository(FeatureRepository& rRepo, bool map)
+{
+  rRepo.Init(!IsBigEndian(), 0, 0, PARAMKIND_ANON, 0, NULL,
+             NULL, NULL, NULL, NULL, NULL);
+  rRepo.MapFeatures(map);
+}
+
+
+/// Read the single file of the list
+static void ReadOne(const std::string& rFile, Matrix<BaseFloat>& rM, bool map)
+{
+  FeatureRepository repo;
+  InitRepository(repo, map);
+  repo.AddFile(rFile);
+  repo.Rewind();
+  repo.ReadFullMatrix(rM);
+}
+
+
+int main()
+{
+  std::string dir = TestTmpDir();
+
+  Matrix<BaseFloat> m0, m1, m2, m3;
+  FillMatrix(m0, 7, 5, 1.0f);
+  FillMatrix(m1, 4, 5, -3.0f);
+  FillMatrix(m2, 3, 2, 10.0f);
+  FillMatrix(m3, 6, 3, 0.5f);
+
+  //HTK files, "b" exists, so "b#2" is looked up as an archive first
+  {
+    FeatureRepository repo;
+    InitRepository(repo, false);
+    repo.WriteFeatureMatrix(m2, dir + "/utt#1.fea", PARAMKIND_USER, 100000);
+    repo.WriteFeatureMatrix(m3, dir + "/b#2", PARAMKIND_USER, 100000);
+    repo.WriteFeatureMatrix(m1, dir + "/b", PARAMKIND_USER, 100000);
+  }
+
+  //archives, the name of the first entry looks like a number
+  {
+    FeatureArchiveWriter ark;
+    ark.Open(dir + "/a.ark");
+    TEST_CHECK(ark.Write("12", m0, PARAMKIND_USER, 100000) == 0);
+    TEST_CHECK(ark.Write("x", m1, PARAMKIND_USER, 100000) == 1);
+    ark.Close();
+
+    FeatureArchiveWriter half;
+    half.Open(dir + "/h.ark", true);
+    half.Write("h", m0, PARAMKIND_USER, 100000);
+    half.Close();
+  }
+
+  for(int map=0; map<2; map++) {
+    Matrix<BaseFloat> m;
+
+    ReadOne(dir + "/a.ark#0", m, map);
+    TEST_CHECK(MaxRelDiff(m, m0) == 0.0);
+    ReadOne(dir + "/a.ark#1", m, map);
+    TEST_CHECK(MaxRelDiff(m, m1) == 0.0);
+    //by name, not the entry number 12
+    ReadOne(dir + "/a.ark#:12", m, map);
+    TEST_CHECK(MaxRelDiff(m, m0) == 0.0);
+    ReadOne(dir + "/a.ark#:x[1,2]", m, map);
+    TEST_CHECK(m.Rows() == 2 && MaxRelDiff(m, m1, 1) == 0.0);
+    //half precision, 11 significant bits
+    ReadOne(dir + "/h.ark#0", m, map);
+    TEST_CHECK(MaxRelDiff(m, m0) < 1.0/1024);
+
+    //'#' in the names of HTK files
+    ReadOne(dir + "/utt#1.fea", m, map);
+    TEST_CHECK(MaxRelDiff(m, m2) == 0.0);
+    ReadOne(dir + "/b#2[1,4]", m, map);
+    TEST_CHECK(m.Rows() == 4 && MaxRelDiff(m, m3, 1) == 0.0);
+
+    //missing or ambiguous entries
+    TEST_CHECK_THROW(ReadOne(dir + "/a.ark#2", m, map));
+    TEST_CHECK_THROW(ReadOne(dir + "/a.ark#x", m, map));
+    TEST_CHECK_THROW(ReadOne(dir + "/a.ark#:y", m, map));
+  }
+
+  //an empty entry
+  {
+    FeatureArchiveWriter ark;
+    ark.Open(dir + "/e.ark", true);
+    Matrix<BaseFloat> empty;
+    ark.Write("e", empty, PARAMKIND_USER, 100000);
+    ark.Write("m", m0, PARAMKIND_USER, 100000);
+    ark.Close();
+    Matrix<BaseFloat> m;
+    ReadOne(dir + "/e.ark#:m", m, false);
+    TEST_CHECK(MaxRelDiff(m, m0) < 1.0/1024);
+  }
+
+  //the archive left open is closed by the destructor, its errors are not thrown
+  if(FILE* fp = fopen("/dev/full", "wb")) {
+    fclose(fp);
+    bool thrown = false;
+    try {
+      FeatureArchiveWriter ark;
+      ark.Open("/dev/full");
+      ark.Write("x", m1, PARAMKIND_USER, 100000);
+    } catch(std::exception&) {
+      thrown = true;
+    }
+    TEST_CHECK(!thrown);
+  }
+
+  //several entries of one archive in a list
+  {
+    FeatureRepository repo;
+    InitRepository(repo, true);
+    repo.AddFile(dir + "/a.ark#1");
+    repo.AddFile(dir + "/a.ark#0");
+    repo.AddFile(dir + "/b#2");
+    repo.AddFile(dir + "/a.ark#:x");
+    Matrix<BaseFloat> m;
+    const Matrix<BaseFloat>* ref[] = { &m1, &m0, &m3, &m1 };
+    int i = 0;
+    for(repo.Rewind(); !repo.EndOfList(); repo.MoveNext(), i++) {
+      repo.ReadFullMatrix(m);
+      TEST_CHECK(MaxRelDiff(m, *ref[i]) == 0.0);
+    }
+    TEST_CHECK(i == 4);
+  }
+
+  TestRmDir(dir);
+  return TestResult("TestFeatureArchive");
+}
@@ -0,0 +1,98 @@
+/*
+ * FeatureRepository::ReadFullMatrixView: the view over the mapped file
+ * equals ReadFullMatrix, also for frame ranges; with context extension
+ * beyond the ends of the file or without mapping the features are read
+ * to the buffer.
+ */
+
+#include "Test.h"
+
+#include "Features.h"
+#include "Matrix.h"
+#include "Common.h"
+
+using namespace TNet;
+
+
+/// Repository reading the USER features in the byte order of the CPU,
+/// extended by the context
+static void InitRepository(FeatureRepository& rRepo, int ext, bool map)
+{
+  rRepo.Init(false, ext, ext, PARAMKIND_ANON, 0, NULL,
+             NULL, NULL, NULL, NULL, NULL);
+  rRepo.MapFeatures(map);
+}
+
+
+/// True if the matrices are equal
+static bool Same(const Matrix<BaseFloat>& rA, const Matrix<BaseFloat>& rB)
+{
+  if(rA.Rows() != rB.Rows() || rA.Cols() != rB.Cols()) return false;
+  for(size_t r=0; r<rA.Rows(); r++) {
+    for(size_t c=0; c<rA.Cols(); c++) {
+      if(rA(r,c) != rB(r,c)) return false;
+    }
+  }
+  return true;
+}
+
+
+/// Read the file by both methods, 'view' tells if the view is expected
+static void CheckFile(const std::string& rFile, int ext, bool map, bool view)
+{
+  Matrix<BaseFloat> ref, buf;
+  {
+    FeatureRepository repo;
+    InitRepository(repo, ext, false);
+    repo.AddFile(rFile);
+    repo.Rewind();
+    repo.ReadFullMatrix(ref);
+  }
+  FeatureRepository repo;
+  InitRepository(repo, ext, map);
+  repo.AddFile(rFile);
+  repo.Rewind();
+  const Matrix<BaseFloat>& m = repo.ReadFullMatrixView(buf);
+  TEST_CHECK((&m != &buf) == view);
+  TEST_CHECK(ref.Rows() > 0 && Same(m, ref));
+}
+
+
+int main()
+{
+  std::string dir = TestTmpDir();
+  Matrix<BaseFloat> m(9, 5);
+  for(size_t r=0; r<m.Rows(); r++) {
+    for(size_t c=0; c<m.Cols(); c++) m(r,c) = TestRand();
+  }
+  {
+    FeatureRepository repo;
+    InitRepository(repo, 0, false);
+    //native byte order, as written with NATURALREADORDER
+    repo.WriteFeatureMatrix(m, dir + "/u.fea", PARAMKIND_USER, 100000);
+  }
+
+  CheckFile(dir + "/u.fea", 0, true, true);
+  CheckFile(dir + "/u.fea[2,6]", 0, true, true);
+  //the context inside the file is a part of the view,
+  //the padding at the ends of the file needs a copy
+  CheckFile(dir + "/u.fea[2,6]", 2, true, true);
+  CheckFile(dir + "/u.fea", 2, true, false);
+  CheckFile(dir + "/u.fea[0,6]", 2, true, false);
+  CheckFile(dir + "/u.fea", 0, false, false);
+  //the bytes of the other order need a copy
+  {
+    Matrix<BaseFloat> buf;
+    FeatureRepository repo;
+    repo.Init(true, 0, 0, PARAMKIND_ANON, 0, NULL, NULL, NULL, NULL, NULL, NULL);
+    repo.MapFeatures(true);
+    repo.WriteFeatureMatrix(m, dir + "/s.fea", PARAMKIND_USER, 100000);
+    repo.AddFile(dir + "/s.fea");
+    repo.Rewind();
+    const Matrix<BaseFloat>& s = repo.ReadFullMatrixView(buf);
+    TEST_CHECK(&s == &buf && Same(s, m));
+  }
+
+  TestRmDir(dir);
+  return TestResult("TestFeatureView");
+}
@@ -0,0 +1,107 @@
+/*
+ * Network::Propagate with <biasedlinearity> fused to the following
+ * <sigmoid>/<tanh> (per blocks of rows, the activation in place) gives
+ * the outputs of the components propagated one by one, also for odd
+ * numbers of rows and for outputs of several blocks; Network::Forward
+ * through the ping-pong buffers gives the outputs of Propagate, also
+ * when the buffers were grown by a longer input before.
+ */
+
+#include "Test.h"
+
+#include "Nnet.h"
+#include "Matrix.h"
+
+using namespace TNet;
+
+
+/// Layers wide enough for the blocks of 256kB to hold fewer rows than the data
+static std::string Model()
+{
+  std::ostringstream os;
+  os << "<biasedlinearity> 512 20\n" << TestRandomText(512, 20) << TestRandomText(0, 512)
+     << "<sigmoid> 512 512\n"
+     << "<biasedlinearity> 300 512\n" << TestRandomText(300, 512) << TestRandomText(0, 300)
+     << "<tanh> 300 300\n"
+     << "<biasedlinearity> 7 300\n" << TestRandomText(7, 300) << TestRandomText(0, 7)
+     << "<softmax> 7 7\n";
+  return os.str();
+}
+
+
+/// Propagate the components one by one, nothing fused
+/// (the inputs of the next layers are the outputs of the previous ones)
+static void PropagateUnfused(Network& rNet, const Matrix<BaseFloat>& rIn, Matrix<BaseFloat>& rOut)
+{
+  rNet.Layer(0).SetInput(rIn);
+  for(int i=0; i<rNet.Layers(); i++) {
+    rNet.Layer(i).Propagate();
+  }
+  rOut = rNet.Layer(rNet.Layers()-1).GetOutput();
+}
+
+
+/// Max difference of the outputs, relative to the values above 1,
+/// a large value if the sizes differ
+static double MaxDiff(const Matrix<BaseFloat>& rA, const Matrix<BaseFloat>& rB)
+{
+  if(rA.Rows() != rB.Rows() || rA.Cols() != rB.Cols()) return 1e30;
+  double max_diff = 0.0;
+  for(size_t r=0; r<rA.Rows(); r++) {
+    for(size_t c=0; c<rA.Cols(); c++) {
+      double diff = std::fabs(static_cast<double>(rA(r,c)) - rB(r,c));
+      max_diff = std::max(max_diff, diff / std::max(1.0, std::fabs(static_cast<double>(rB(r,c)))));
+    }
+  }
+  return max_diff;
+}
+
+
+int main()
+{
+  std::string model = Model();
+  Network net, ref;
+  std::istringstream is(model), is_ref(model);
+  net.ReadNetwork(is);
+  ref.ReadNetwork(is_ref);
+
+  //a row, odd counts, a block of the 512 outputs and a row, several blocks
+  const size_t rows[] = { 1, 7, 129, 301, 1001 };
+  for(size_t u=0; u<sizeof(rows)/sizeof(rows[0]); u++) {
+    Matrix<BaseFloat> in(rows[u], 20), out, out_ref;
+    for(size_t r=0; r<in.Rows(); r++) {
+      for(size_t c=0; c<in.Cols(); c++) in(r,c) = 2.0f*TestRand();
+    }
+    PropagateUnfused(ref, in, out_ref);
+    net.Propagate(in, out);
+    //the same up to the rounding of the GEMMs of other sizes
+    //(the pre-activations are up to ~10, a few of their ulps)
+    TEST_CHECK(MaxDiff(out, out_ref) < 1e-5);
+
+    //the hidden outputs of the fused pairs are those of the activations
+    TEST_CHECK(MaxDiff(net.Layer(1).GetOutput(), ref.Layer(1).GetOutput()) < 1e-5);
+    TEST_CHECK(MaxDiff(net.Layer(3).GetOutput(), ref.Layer(3).GetOutput()) < 1e-5);
+
+    //the input of the softmax
+    Matrix<BaseFloat> logits(net.PropagateLogits(in));
+    TEST_CHECK(MaxDiff(logits, ref.Layer(4).GetOutput()) < 1e-5);
+
+    //the inference pass does the same blocks
+    Matrix<BaseFloat> fwd;
+    net.Forward(in, fwd);
+    TEST_CHECK(MaxDiff(fwd, out) == 0.0);
+  }
+
+  //the buffers of the longest input hold the shorter ones
+  for(size_t u=0; u<sizeof(rows)/sizeof(rows[0]); u++) {
+    Matrix<BaseFloat> in(rows[u] + 2, 20), out, fwd;
+    for(size_t r=0; r<in.Rows(); r++) {
+      for(size_t c=0; c<in.Cols(); c++) in(r,c) = 2.0f*TestRand();
+    }
+    ref.Propagate(in, out);
+    net.Forward(in, fwd);
+    TEST_CHECK(MaxDiff(fwd, out) == 0.0);
+  }
+
+  return TestResult("TestFusedForward");
+}
@@ -0,0 +1,107 @@
+/*
+ * KahanAdd and AddRowsKahan: the compensated sum of many single-precision
+ * terms is within the rounding of the exact sum, where the naive sum
+ * in the same precision is not.
+ */
+
+#include "Test.h"
+
+#include "Matrix.h"
+
+#include <limits>
+#include <vector>
+
+using namespace TNet;
+
+
+/// Positive terms of mixed magnitude, the sum has no cancellation
+static BaseFloat Term()
+{
+  return (1.5f + TestRand()) * (TestRand() > 0.0f ? 1.0f : 1e-3f);
+}
+
+
+/// KahanAdd of the fixed and of the run-time length, over many sources
+template<size_t _N>
+static void CheckKahanAdd(size_t n)
+{
+  const size_t sources = 2000;
+  std::vector<BaseFloat> dst(n), comp(n, 0.0f), naive(n), src(n);
+  std::vector<long double> ref(n);
+  for(size_t j=0; j<n; j++) {
+    dst[j] = naive[j] = Term();
+    ref[j] = dst[j];
+  }
+  for(size_t s=0; s<sources; s++) {
+    for(size_t j=0; j<n; j++) {
+      src[j] = Term();
+      naive[j] += src[j];
+      ref[j] += src[j];
+    }
+    KahanAdd<BaseFloat, _N>(&dst[0], &comp[0], &src[0], n);
+  }
+  //the error of the last addition
+  for(size_t j=0; j<n; j++) dst[j] -= comp[j];
+
+  const long double eps = std::numeric_limits<BaseFloat>::epsilon();
+  long double err = 0.0, naive_err = 0.0;
+  for(size_t j=0; j<n; j++) {
+    long double e = std::fabs(dst[j] - ref[j]) / ref[j];
+    err = std::max(err, e);
+    naive_err = std::max(naive_err, std::fabs(naive[j] - ref[j]) / ref[j]);
+  }
+  //an ulp of the sum, the naive one is off by many
+  TEST_CHECK(err <= eps);
+  TEST_CHECK(naive_err > 4 * eps);
+}
+
+
+/// AddRowsKahan against the sum in long double, the columns span two blocks,
+/// the rows of the sources start at 'origin'
+static void CheckAddRowsKahan()
+{
+  const size_t rows = 5, cols = 1100, origin = 2, sources = 300;
+  std::vector<Matrix<BaseFloat> > src(sources);
+  std::vector<const Matrix<BaseFloat>*> p_src;
+  for(size_t s=0; s<sources; s++) {
+    src[s].Init(origin+rows+1, cols);
+    for(size_t r=0; r<src[s].Rows(); r++) {
+      for(size_t c=0; c<cols; c++) src[s](r,c) = Term();
+    }
+    p_src.push_back(&src[s]);
+  }
+  Matrix<BaseFloat> dst(rows, cols), naive(rows, cols);
+  std::vector<long double> ref(rows*cols);
+  for(size_t r=0; r<rows; r++) {
+    for(size_t c=0; c<cols; c++) {
+      dst(r,c) = naive(r,c) = Term();
+      ref[r*cols+c] = dst(r,c);
+      for(size_t s=0; s<sources; s++) {
+        naive(r,c) += src[s](origin+r,c);
+        ref[r*cols+c] += src[s](origin+r,c);
+      }
+    }
+  }
+
+  AddRowsKahan(dst, p_src, origin);
+  const long double eps = std::numeric_limits<BaseFloat>::epsilon();
+  long double err = 0.0, naive_err = 0.0;
+  for(size_t r=0; r<rows; r++) {
+    for(size_t c=0; c<cols; c++) {
+      long double sum = ref[r*cols+c];
+      err = std::max(err, std::fabs(dst(r,c) - sum) / sum);
+      naive_err = std::max(naive_err, std::fabs(naive(r,c) - sum) / sum);
+    }
+  }
+  TEST_CHECK(err <= eps);
+  TEST_CHECK(naive_err > 4 * eps);
+}
+
+
+int main()
+{
+  CheckKahanAdd<0>(37);
+  CheckKahanAdd<8>(8);
+  CheckAddRowsKahan();
+  return TestResult("TestKahanSum");
+}
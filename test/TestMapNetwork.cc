@@ -0,0 +1,93 @@
+/*
+ * Network::MapNetwork: a binary model used in place gives the outputs
+ * of the model read by ReadNetwork, and its weights cannot be trained.
+ */
+
+#include "Test.h"
+
+#include "Nnet.h"
+#include "Matrix.h"
+
+using namespace TNet;
+
+
+/// Forward the same input by both networks, true if the outputs are equal
+static bool SameOutput(Network& rA, Network& rB)
+{
+  Matrix<BaseFloat> in(30, 6), out_a, out_b;
+  for(size_t r=0; r<in.Rows(); r++) {
+    for(size_t c=0; c<in.Cols(); c++) {
+      in(r,c) = 2.0f*TestRand();
+    }
+  }
+  rA.Forward(in, out_a);
+  rB.Forward(in, out_b);
+  if(out_a.Rows() != out_b.Rows() || out_a.Cols() != out_b.Cols()) return false;
+  for(size_t r=0; r<out_a.Rows(); r++) {
+    for(size_t c=0; c<out_a.Cols(); c++) {
+      if(out_a(r,c) != out_b(r,c)) return false;
+    }
+  }
+  return true;
+}
+
+
+int main()
+{
+  std::string dir = TestTmpDir();
+  std::ostringstream os;
+  os << "<biasedlinearity> 8 6\n" << TestRandomText(8, 6) << TestRandomText(0, 8)
+     << "<sigmoid> 8 8\n"
+     << "<sharedlinearity> 4 8\n2\n" << TestRandomText(2, 4) << TestRandomText(0, 2)
+     << "<softmax> 4 4\n";
+  TestWriteFile(dir + "/nnet.txt", os.str());
+
+  Network net_txt;
+  net_txt.ReadNetwork((dir + "/nnet.txt").c_str());
+  net_txt.WriteNetwork((dir + "/nnet.bin").c_str(), true);
+
+  //the text model cannot be mapped, it is read
+  Network net_txt_map;
+  net_txt_map.MapNetwork((dir + "/nnet.txt").c_str());
+  TEST_CHECK(SameOutput(net_txt, net_txt_map));
+
+  Network net_map;
+  net_map.MapNetwork((dir + "/nnet.bin").c_str());
+  TEST_CHECK(net_map.Layers() == net_txt.Layers());
+  TEST_CHECK(SameOutput(net_txt, net_map));
+
+  //the mapped weights are read-only
+  for(int i=0; i<net_map.Layers(); i++) {
+    if(!net_map.Layer(i).IsUpdatable()) continue;
+    UpdatableComponent& mapped = dynamic_cast<UpdatableComponent&>(net_map.Layer(i));
+    const UpdatableComponent& read = dynamic_cast<const UpdatableComponent&>(net_txt.Layer(i));
+    mapped.LinearityAccu();
+    mapped.BiasAccu();
+    TEST_CHECK_THROW(mapped.Update(0, 1));
+    TEST_CHECK_THROW(mapped.ApplyGradient(read, 0, 1));
+    TEST_CHECK_THROW(mapped.AccuWeights(read, 1.0, 0, 1));
+    TEST_CHECK_THROW(mapped.AverageWeights(0, 1));
+    TEST_CHECK_THROW(mapped.CopyWeights(read));
+  }
+  //the file is intact
+  Network net_bin;
+  net_bin.ReadNetwork((dir + "/nnet.bin").c_str());
+  TEST_CHECK(SameOutput(net_txt, net_bin));
+
+  //the clones share the mapped weights
+  Network* p_clone = net_map.Clone();
+  TEST_CHECK(SameOutput(net_txt, *p_clone));
+  delete p_clone;
+
+  //detached weights are a copy, they can be updated
+  for(int i=0; i<net_map.Layers(); i++) {
+    if(!net_map.Layer(i).IsUpdatable()) continue;
+    UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(net_map.Layer(i));
+    comp.DetachWeights();
+    comp.CopyWeights(dynamic_cast<const UpdatableComponent&>(net_txt.Layer(i)));
+  }
+  TEST_CHECK(SameOutput(net_txt, net_map));
+
+  TestRmDir(dir);
+  return TestResult("TestMapNetwork");
+}
@@ -0,0 +1,128 @@
+/*
+ * The momentum update of BiasedLinearity/SharedLinearity, split among
+ * the threads, against the formulas in double precision:
+ * v = mmt*v + g, w -= rate*(1-mmt)*v (rate*(1-mmt)*(g+mmt*v) with Nesterov).
+ */
+
+#include "Test.h"
+
+#include "Nnet.h"
+#include "Matrix.h"
+
+#include <vector>
+
+using namespace TNet;
+
+
+/// Weights (rows x cols as stored, inputs x outputs of an instance) and bias 
+/// of the single layer network, from the outputs of the unit vectors and of zero
+static void Probe(Network& rNet, size_t rows, size_t cols,
+                  std::vector<double>& rW, std::vector<double>& rB)
+{
+  size_t in = rNet.GetNInputs();
+  Matrix<BaseFloat> probe(in+1, in), y;
+  for(size_t i=0; i<in; i++) probe(i,i) = 1.0f;
+  rNet.Forward(probe, y);
+  rW.resize(rows*cols); rB.resize(cols);
+  for(size_t o=0; o<cols; o++) {
+    rB[o] = y(in,o);
+    for(size_t i=0; i<rows; i++) rW[i*cols+o] = static_cast<double>(y(i,o)) - y(in,o);
+  }
+}
+
+
+/// Several updates by random gradients, compares the weights to the reference
+static void CheckUpdate(const std::string& rModel, int instances, 
+                        BaseFloat mmt, bool nesterov, bool floatAccu)
+{
+  //the shared weights are updated by the mean gradient of the instances
+  const BaseFloat rate = 0.1f / static_cast<BaseFloat>(instances);
+  const int threads = 2;
+  Network net;
+  net.ReadNetwork(rModel.c_str());
+  net.SetLearnRate(0.1f);
+  net.SetMomentum(mmt, nesterov);
+  net.SetFloatAccu(floatAccu);
+  UpdatableComponent& comp = dynamic_cast<UpdatableComponent&>(net.Layer(0));
+  //allocate the gradient buffers
+  Matrix<BaseFloat> in(2, net.GetNInputs()), out;
+  net.Propagate(in, out);
+  net.Backpropagate(out);
+  if(mmt != 0.0f) {
+    comp.LinearityMomentum();
+    comp.BiasMomentum();
+  }
+
+  std::vector<double> w, b, w_ref, b_ref;
+  size_t rows = comp.LinearityAccu().Rows(), cols = comp.LinearityAccu().Cols();
+  Probe(net, rows, cols, w_ref, b_ref);
+  std::vector<double> v_w(w_ref.size(), 0.0), v_b(b_ref.size(), 0.0);
+  const double step = rate * (1.0 - mmt);
+
+  for(int t=0; t<4; t++) {
+    //the summed gradient in the accumulators
+    Matrix<double>& accu = comp.LinearityAccu();
+    Matrix<BaseFloat>& accu_float = comp.LinearityAccuFloat();
+    Vector<double>& accu_bias = comp.BiasAccu();
+    std::vector<double> g_w(w_ref.size()), g_b(b_ref.size());
+    for(size_t r=0; r<accu.Rows(); r++) {
+      for(size_t c=0; c<accu.Cols(); c++) {
+        float g = TestRand();
+        accu(r,c) = accu_float(r,c) = g;
+        g_w[r*accu.Cols()+c] = g;
+      }
+    }
+    for(size_t i=0; i<accu_bias.Dim(); i++) {
+      accu_bias[i] = g_b[i] = TestRand();
+    }
+    for(int thr=0; thr<threads; thr++) {
+      comp.Update(thr, threads);
+    }
+
+    //the reference
+    for(size_t i=0; i<w_ref.size(); i++) {
+      if(mmt == 0.0f) { w_ref[i] -= rate * g_w[i]; continue; }
+      v_w[i] = mmt * v_w[i] + g_w[i];
+      w_ref[i] -= step * (nesterov ? g_w[i] + mmt * v_w[i] : v_w[i]);
+    }
+    for(size_t i=0; i<b_ref.size(); i++) {
+      if(mmt == 0.0f) { b_ref[i] -= rate * g_b[i]; continue; }
+      v_b[i] = mmt * v_b[i] + g_b[i];
+      b_ref[i] -= step * (nesterov ? g_b[i] + mmt * v_b[i] : v_b[i]);
+    }
+
+    //the accumulator in use is reset
+    TEST_CHECK((floatAccu ? accu_float(0,0) == 0.0f : accu(0,0) == 0.0) && accu_bias[0] == 0.0);
+  }
+
+  Probe(net, rows, cols, w, b);
+  double max_diff = 0.0;
+  for(size_t i=0; i<w.size(); i++) max_diff = std::max(max_diff, std::fabs(w[i] - w_ref[i]));
+  for(size_t i=0; i<b.size(); i++) max_diff = std::max(max_diff, std::fabs(b[i] - b_ref[i]));
+  //float weights, the reference in double
+  TEST_CHECK_CLOSE(max_diff, 0.0, 1e-6);
+}
+
+
+int main()
+{
+  std::string dir = TestTmpDir();
+  std::ostringstream os;
+  os << "<biasedlinearity> 3 5\n" << TestRandomText(3, 5) << TestRandomText(0, 3);
+  TestWriteFile(dir + "/biased.txt", os.str());
+  os.str("");
+  os << "<sharedlinearity> 6 4\n2\n" << TestRandomText(3, 2) << TestRandomText(0, 3);
+  TestWriteFile(dir + "/shared.txt", os.str());
+
+  const char* models[] = { "/biased.txt", "/shared.txt" };
+  for(int m=0; m<2; m++) {
+    for(int float_accu=0; float_accu<2; float_accu++) {
+      CheckUpdate(dir + models[m], m+1, 0.0f, false, float_accu);
+      CheckUpdate(dir + models[m], m+1, 0.9f, false, float_accu);
+      CheckUpdate(dir + models[m], m+1, 0.9f, true, float_accu);
+    }
+  }
+
+  TestRmDir(dir);
+  return TestResult("TestMomentum");
+}
@@ -0,0 +1,102 @@
+/*
+ * Round-trip of the text and binary model formats (Network::ReadNetwork,
+ * WriteNetwork, the binary matrix/vector records of Matrix.tcc/Vector.tcc).
+ */
+
+#include "Test.h"
+
+#include "Nnet.h"
+#include "Matrix.h"
+
+using namespace TNet;
+
+
+/// Text model with all the components which store matrices or vectors
+static std::string ModelText()
+{
+  std::ostringstream os;
+  os << "<expand> 15 5\nv 3\n-1 0 1\n"
+     << "<biasedlinearity> 8 15\n" << TestRandomText(8, 15) << TestRandomText(0, 8)
+     << "<sigmoid> 8 8\n"
+     << "<sharedlinearity> 6 8\n2\n" << TestRandomText(3, 4) << TestRandomText(0, 3)
+     << "<tanh> 6 6\n"
+     << "<blocklinearity> 4 6\n" << TestRandomText(2, 3)
+     << "<bias> 4 4\n" << TestRandomText(0, 4)
+     << "<window> 4 4\n" << TestRandomText(0, 4)
+     << "<blockarray> 4 4\n2\n"
+     << "<block> 1\n<biasedlinearity> 2 2\n" << TestRandomText(2, 2) << TestRandomText(0, 2)
+     << "<endblock>\n"
+     << "<block> 2\n<sigmoid> 2 2\n<endblock>\n"
+     << "<softmax> 4 4\n";
+  return os.str();
+}
+
+
+/// The test input, 20 frames
+static void TestInput(Matrix<BaseFloat>& rIn)
+{
+  rIn.Init(20, 5);
+  for(size_t r=0; r<rIn.Rows(); r++) {
+    for(size_t c=0; c<rIn.Cols(); c++) {
+      rIn(r,c) = 2.0f*TestRand();
+    }
+  }
+}
+
+
+int main()
+{
+  std::string dir = TestTmpDir();
+  TestWriteFile(dir + "/nnet.txt", ModelText());
+
+  Network net_txt;
+  net_txt.ReadNetwork((dir + "/nnet.txt").c_str());
+  TEST_CHECK(net_txt.Layers() == 10);
+  net_txt.WriteNetwork((dir + "/nnet.txt2").c_str(), false);
+  net_txt.WriteNetwork((dir + "/nnet.bin").c_str(), true);
+
+  //binary header, the records are smaller than the text
+  std::string bin = TestReadFile(dir + "/nnet.bin");
+  std::string txt = TestReadFile(dir + "/nnet.txt2");
+  TEST_CHECK(bin.size() > 3 && bin[0] == '\0' && bin[1] == 'B');
+  TEST_CHECK(bin.size() < txt.size());
+  TEST_CHECK(txt.find('\0') == std::string::npos);
+
+  //binary -> network -> text gives the same text
+  Network net_bin;
+  net_bin.ReadNetwork((dir + "/nnet.bin").c_str());
+  TEST_CHECK(net_bin.Layers() == net_txt.Layers());
+  net_bin.WriteNetwork((dir + "/nnet.txt3").c_str(), false);
+  TEST_CHECK(TestReadFile(dir + "/nnet.txt3") == txt);
+
+  //binary -> network -> binary gives the same binary
+  net_bin.WriteNetwork((dir + "/nnet.bin2").c_str(), true);
+  TEST_CHECK(TestReadFile(dir + "/nnet.bin2") == bin);
+
+  //the same outputs, bit by bit
+  Network net_txt2;
+  net_txt2.ReadNetwork((dir + "/nnet.txt2").c_str());
+  Matrix<BaseFloat> in, o1, o2, o3;
+  TestInput(in);
+  net_txt.Forward(in, o1);
+  net_bin.Forward(in, o2);
+  net_txt2.Forward(in, o3);
+  TEST_CHECK(o1.Rows() == in.Rows() && o1.Cols() == 4);
+  TEST_CHECK(o2.Rows() == o1.Rows() && o2.Cols() == o1.Cols());
+  TEST_CHECK(o3.Rows() == o1.Rows() && o3.Cols() == o1.Cols());
+  bool same = true;
+  for(size_t r=0; r<o1.Rows(); r++) {
+    for(size_t c=0; c<o1.Cols(); c++) {
+      same = same && o1(r,c) == o2(r,c) && o1(r,c) == o3(r,c);
+    }
+  }
+  TEST_CHECK(same);
+
+  //a truncated binary model must not load silently
+  TestWriteFile(dir + "/nnet.cut", bin.substr(0, bin.size()/2));
+  Network net_cut;
+  TEST_CHECK_THROW(net_cut.ReadNetwork((dir + "/nnet.cut").c_str()));
+
+  TestRmDir(dir);
+  return TestResult("TestNnetIO");
+}
@@ -0,0 +1,92 @@
+/*
+ * Network::Feedforward of the long inputs: the blocks forwarded by the
+ * workers (BLOCKTHREADS > 1) give the output of the sequential blocks
+ * bit for bit, also on a clone of the network (THREADS of TFeaCat);
+ * with the context of the blocks the output is that of Forward.
+ */
+
+#include "Test.h"
+
+#include "Nnet.h"
+#include "Matrix.h"
+
+using namespace TNet;
+
+
+/// <expand> of the context 2+3
+static std::string Model()
+{
+  std::ostringstream os;
+  os << "<expand> 24 4\nv 6\n-2 -1 0 1 2 3\n"
+     << "<biasedlinearity> 32 24\n" << TestRandomText(32, 24) << TestRandomText(0, 32)
+     << "<sigmoid> 32 32\n"
+     << "<biasedlinearity> 5 32\n" << TestRandomText(5, 32) << TestRandomText(0, 5)
+     << "<softmax> 5 5\n";
+  return os.str();
+}
+
+
+/// True if the matrices are equal
+static bool Same(const Matrix<BaseFloat>& rA, const Matrix<BaseFloat>& rB)
+{
+  if(rA.Rows() != rB.Rows() || rA.Cols() != rB.Cols()) return false;
+  for(size_t r=0; r<rA.Rows(); r++) {
+    for(size_t c=0; c<rA.Cols(); c++) {
+      if(rA(r,c) != rB(r,c)) return false;
+    }
+  }
+  return true;
+}
+
+
+/// Max difference of the outputs, a large value if the sizes differ
+static double MaxDiff(const Matrix<BaseFloat>& rA, const Matrix<BaseFloat>& rB)
+{
+  if(rA.Rows() != rB.Rows() || rA.Cols() != rB.Cols()) return 1e30;
+  double max_diff = 0.0;
+  for(size_t r=0; r<rA.Rows(); r++) {
+    for(size_t c=0; c<rA.Cols(); c++) {
+      max_diff = std::max(max_diff, std::fabs(static_cast<double>(rA(r,c)) - rB(r,c)));
+    }
+  }
+  return max_diff;
+}
+
+
+int main()
+{
+  std::string model = Model();
+  std::istringstream is(model);
+  Network net;
+  net.ReadNetwork(is);
+
+  //just above the length forwarded in one piece, the last block is longer;
+  //blocks of a single frame and the context
+  const size_t rows[] = { 5001, 7777 };
+  const size_t blocks[] = { 700, 1 };
+  for(size_t u=0; u<sizeof(rows)/sizeof(rows[0]); u++) {
+    Matrix<BaseFloat> in(rows[u], 4), whole, seq, par, par_clone;
+    for(size_t r=0; r<in.Rows(); r++) {
+      for(size_t c=0; c<in.Cols(); c++) in(r,c) = 2.0f*TestRand();
+    }
+    net.Forward(in, whole);
+
+    net.SetFeedforward(blocks[u], 1);
+    net.Feedforward(in, seq, 2, 3);
+    net.SetFeedforward(blocks[u], 3);
+    net.Feedforward(in, par, 2, 3);
+    TEST_CHECK(Same(par, seq));
+
+    //the clone of TFeaCat's forward thread gets its own workers
+    Network* clone = net.Clone();
+    clone->SetFeedforward(blocks[u], 2);
+    clone->Feedforward(in, par_clone, 2, 3);
+    TEST_CHECK(Same(par_clone, seq));
+    delete clone;
+
+    //up to the rounding of the GEMMs of other sizes
+    TEST_CHECK(MaxDiff(seq, whole) < 1e-5);
+  }
+
+  return TestResult("TestParallelFeedforward");
+}
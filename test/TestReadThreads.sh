@@ -0,0 +1,39 @@
+#!/bin/sh
+# READTHREADS: several readers, sharing the indexed MLF, deliver the
+# utterances in the order of a single reader, so the trained network
+# is identical, also with the shuffled file order and in the cross-validation.
+#
+# sh TestReadThreads.sh <dir of TNet>
+
+BIN=${1:-..}
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/tnet_test.XXXXXX") || exit 1
+trap 'rm -rf "$DIR"' EXIT
+FAILURES=0
+
+check() {
+  if ! eval "$1"; then
+    echo "TestReadThreads.sh: check failed: $1" >&2
+    FAILURES=$((FAILURES+1))
+  fi
+}
+
+./GenData "$DIR" 40 || exit 1
+COMMON="-I $DIR/ref.mlf -m $DIR/states --BUNCHSIZE=64 --CACHESIZE=2048 --LEARNINGRATE=0.001 --SEED=7 --SAVEBINARY=T"
+
+for RD in 1 3; do
+  "$BIN"/TNet -S "$DIR"/train.scp -H "$DIR"/nnet.init --TARGETMMF="$DIR"/nnet.$RD $COMMON \
+    --READTHREADS=$RD --SHUFFLEFILES=T --QUEUESIZE=2 > "$DIR"/train.$RD.log 2>&1
+  check "[ $? -eq 0 ]"
+  "$BIN"/TNet -c -S "$DIR"/cv.scp -H "$DIR"/nnet.1 $COMMON \
+    --READTHREADS=$RD --RANDOMIZE=F > "$DIR"/cv.$RD.log 2>&1
+  check "[ $? -eq 0 ]"
+done
+check "cmp -s $DIR/nnet.1 $DIR/nnet.3"
+check "[ \"\$(grep '^-- CV' $DIR/cv.1.log)\" = \"\$(grep '^-- CV' $DIR/cv.3.log)\" ]"
+check "grep -q '^-- CV' $DIR/cv.3.log"
+
+if [ $FAILURES -ne 0 ]; then
+  echo "TestReadThreads: FAILED $FAILURES checks"
+  exit 1
+fi
+echo "TestReadThreads: OK"
@@ -0,0 +1,91 @@
+/*
+ * RingAllreduce: the processes of the ring get the sum of their matrices
+ * and vectors, the padding of the matrix rows is left alone.
+ */
+
+#include "Test.h"
+
+#include "RingAllreduce.h"
+#include "Matrix.h"
+#include "Vector.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace TNet;
+
+
+/// The value which process 'rank' contributes to the element
+static double Value(int rank, size_t r, size_t c)
+{
+  return (rank+1) * 1000.0 + static_cast<double>(r) + 0.5 * static_cast<double>(c);
+}
+
+
+/// One process of the ring, returns the number of the failed checks
+static int Worker(const std::string& rPrefix, int rank, int size)
+{
+  RingAllreduce ring(rPrefix, rank, size);
+
+  //fewer rows than processes, as many, more; the rows are padded
+  const size_t rows[] = { 1, 3, 7, 50 };
+  for(size_t i=0; i<sizeof(rows)/sizeof(rows[0]); i++) {
+    Matrix<double> m(rows[i], 5);
+    TEST_CHECK(m.Stride() > m.Cols());
+    for(size_t r=0; r<m.Rows(); r++) {
+      for(size_t c=0; c<m.Cols(); c++) m(r,c) = Value(rank, r, c);
+      //marks in the padding, the sum must not touch them
+      for(size_t c=m.Cols(); c<m.Stride(); c++) m.pRowData(r)[c] = -1.0 - rank;
+    }
+    ring.Sum(m);
+    for(size_t r=0; r<m.Rows(); r++) {
+      for(size_t c=0; c<m.Cols(); c++) {
+        double sum = 0.0;
+        for(int k=0; k<size; k++) sum += Value(k, r, c);
+        TEST_CHECK(m(r,c) == sum);
+      }
+      for(size_t c=m.Cols(); c<m.Stride(); c++) {
+        TEST_CHECK(m.pRowData(r)[c] == -1.0 - rank);
+      }
+    }
+  }
+
+  Vector<double> v(11);
+  for(size_t i=0; i<v.Dim(); i++) v[i] = Value(rank, i, 0);
+  ring.Sum(v);
+  for(size_t i=0; i<v.Dim(); i++) {
+    double sum = 0.0;
+    for(int k=0; k<size; k++) sum += Value(k, i, 0);
+    TEST_CHECK(v[i] == sum);
+  }
+  return gTestFailures;
+}
+
+
+int main()
+{
+  std::string dir = TestTmpDir();
+  const int size = 3;
+
+  //ranks 1.. in the child processes, rank 0 here
+  std::vector<pid_t> pids;
+  for(int rank=1; rank<size; rank++) {
+    pid_t pid = fork();
+    if(pid == 0) {
+      int failures = 1;
+      try { failures = Worker(dir + "/ring", rank, size); } catch(std::exception&) { }
+      _exit(failures ? 1 : 0);
+    }
+    pids.push_back(pid);
+  }
+  Worker(dir + "/ring", 0, size);
+  for(size_t i=0; i<pids.size(); i++) {
+    int status = 0;
+    waitpid(pids[i], &status, 0);
+    TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  TestRmDir(dir);
+  return TestResult("TestRingAllreduce");
+}
@@ -0,0 +1,144 @@
+/*
+ * VecExp/VecSigmoid/VecTanh at all the SIMD levels of the CPU,
+ * against libm in double precision, including the saturation of large |x|.
+ * SIMD_NONE must give the results of the original scalar code bit by bit.
+ */
+
+#include "Test.h"
+
+#include "SimdMath.h"
+
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+
+using namespace TNet;
+
+
+/// The inputs: a dense grid over [-100,100] and the special points
+static std::vector<float> TestInputs()
+{
+  std::vector<float> x;
+  for(int i=-100000; i<=100000; i++) {
+    x.push_back(static_cast<float>(i) * 0.001f);
+  }
+  const float special[] = { 0.0f, -0.0f, 1e-8f, -1e-8f, 1e-4f, -1e-4f,
+                            87.0f, -87.0f, 88.0f, -88.0f, 88.7f, -88.7f,
+                            89.0f, -89.0f, 1e4f, -1e4f, 1e30f, -1e30f };
+  x.insert(x.end(), special, special + sizeof(special)/sizeof(special[0]));
+  return x;
+}
+
+
+/// |out-ref| relative to the float rounding of ref, in units of FLT_EPSILON
+static double RelErr(float out, double ref)
+{
+  return std::fabs(out - ref) / std::fabs(ref) / FLT_EPSILON;
+}
+
+
+/// The original scalar code of Vector::ApplyExp, Sigmoid and Tanh
+static float OrigExp(float x) { return expf(x); }
+static float OrigSigmoid(float x) { return static_cast<float>(1.0f/(1.0f+exp(-x))); }
+static float OrigTanh(float x)
+{
+  float exp2x = static_cast<float>(exp(2.0*x));
+  return isinf(exp2x) ? 1.0f : static_cast<float>((exp2x-1.0)/(exp2x+1.0));
+}
+
+
+/// Run the kernel on the inputs, shifted by one element to test unaligned data and the tails
+static void Run(void (*pFnc)(const float*, float*, size_t),
+                const std::vector<float>& rIn, std::vector<float>& rOut)
+{
+  std::vector<float> in(rIn.size()+1), out(rIn.size()+1);
+  std::copy(rIn.begin(), rIn.end(), in.begin()+1);
+  pFnc(&in[1], &out[1], rIn.size());
+  rOut.assign(out.begin()+1, out.end());
+
+  //in place, in pieces of all the tail lengths
+  std::vector<float> inplace(rIn);
+  size_t i = 0;
+  for(size_t len = 1; i < inplace.size(); len = len%37 + 1) {
+    size_t l = std::min(len, inplace.size()-i);
+    pFnc(&inplace[i], &inplace[i], l);
+    i += l;
+  }
+  TEST_CHECK(std::equal(inplace.begin(), inplace.end(), rOut.begin()));
+}
+
+
+int main()
+{
+  std::vector<float> x = TestInputs();
+  std::vector<float> y_exp, y_sig, y_tanh;
+
+  SimdLevel best = SimdDetect();
+  for(int l = SIMD_NONE; l <= best; l++) {
+    SimdLevel level = static_cast<SimdLevel>(l);
+    SimdSetLevel(level);
+    TEST_CHECK(SimdGetLevel() == level);
+
+    Run(VecExp, x, y_exp);
+    Run(VecSigmoid, x, y_sig);
+    Run(VecTanh, x, y_tanh);
+    float hi = 88.0f, exp_hi;
+    VecExp(&hi, &exp_hi, 1);
+
+    double max_exp = 0.0, max_sig = 0.0, max_tanh = 0.0, max_tanh_abs = 0.0;
+    for(size_t i=0; i<x.size(); i++) {
+      double xd = x[i];
+      double e = exp(xd), s = 1.0/(1.0+exp(-xd)), t = tanh(xd);
+
+      TEST_CHECK(!isnan(y_exp[i]) && !isnan(y_sig[i]) && !isnan(y_tanh[i]));
+      //results in the valid ranges everywhere
+      TEST_CHECK(y_exp[i] >= 0.0f);
+      TEST_CHECK(y_sig[i] >= 0.0f && y_sig[i] <= 1.0f);
+      TEST_CHECK(y_tanh[i] >= -1.0f && y_tanh[i] <= 1.0f);
+
+      //exp, sigmoid: relative error in the normalized range of float
+      if(std::fabs(xd) <= 87.0) {
+        max_exp = std::max(max_exp, RelErr(y_exp[i], e));
+        max_sig = std::max(max_sig, RelErr(y_sig[i], s));
+      }
+      //tanh by (e^2x-1)/(e^2x+1) as the original code, it loses
+      //the relative precision close to 0, there the absolute error counts
+      if(std::fabs(xd) >= 0.5) {
+        max_tanh = std::max(max_tanh, RelErr(y_tanh[i], t));
+      }
+      max_tanh_abs = std::max(max_tanh_abs, std::fabs(y_tanh[i] - t));
+
+      //saturation
+      if(xd >= 20.0) {
+        TEST_CHECK(y_sig[i] == 1.0f);
+        TEST_CHECK(y_tanh[i] == 1.0f);
+      }
+      if(xd <= -20.0) {
+        TEST_CHECK(y_sig[i] < 3e-9f);
+        TEST_CHECK(y_tanh[i] == -1.0f);
+      }
+      if(level != SIMD_NONE) {
+        //the input of the polynomial exp is saturated to [-88,88],
+        //the denormal results are flushed to zero
+        if(xd >= 88.0) TEST_CHECK(y_exp[i] == exp_hi);
+        if(xd <= -88.0) TEST_CHECK(y_exp[i] >= 0.0f && y_exp[i] < FLT_MIN);
+      } else {
+        //libm: inf and denormals, bit-exact with the original code
+        TEST_CHECK(y_exp[i] == OrigExp(x[i]));
+        TEST_CHECK(y_sig[i] == OrigSigmoid(x[i]));
+        TEST_CHECK(y_tanh[i] == OrigTanh(x[i]));
+      }
+    }
+
+    std::cout << "SIMD " << SimdName(level) << ": max error [FLT_EPSILON] exp "
+              << max_exp << ", sigmoid " << max_sig << ", tanh " << max_tanh
+              << ", tanh absolute " << max_tanh_abs << std::endl;
+    TEST_CHECK(max_exp < 2.0);
+    TEST_CHECK(max_sig < 2.0);
+    TEST_CHECK(max_tanh < 2.0);
+    TEST_CHECK(max_tanh_abs < 1.5*FLT_EPSILON);
+  }
+  SimdSetLevel(best);
+
+  return TestResult("TestSimdMath");
+}
@@ -0,0 +1,158 @@
+/*
+ * Sparse targets: GenTargetIds gives the class ids of the one-hot rows
+ * of GenDesiredMatrix, the cross entropy of the ids gives the same
+ * gradient, error and accuracy as the one of the dense one-hot targets;
+ * the softmax fused with it (PropagateLogits, EvaluateLogits) gives
+ * the same as the network ending by <softmax>.
+ */
+
+#include "Test.h"
+
+#include "Labels.h"
+#include "ObjFun.h"
+#include "Nnet.h"
+#include "Matrix.h"
+
+using namespace TNet;
+
+
+/// The class ids of the MLF record agree with the dense desired matrix
+static void CheckLabels(const std::string& rDir)
+{
+  TestWriteFile(rDir + "/states", "s1\ns2\ns3\ns4\n");
+  TestWriteFile(rDir + "/ref.mlf",
+    "#!MLF!#\n"
+    "\"*/a.lab\"\n0 300000 s2\n300000 400000 s4\n400000 900000 s1\n.\n"
+    "\"*/b.lab\"\n0 500000 s3\n500000 700000 s2\n.\n");
+  LabelRepository label;
+  label.Init((rDir + "/ref.mlf").c_str(), (rDir + "/states").c_str(), NULL, "lab");
+
+  const char* utt[] = { "/data/b.fea", "/data/a.fea" };
+  const size_t frames[] = { 7, 9 };
+  for(int u=0; u<2; u++) {
+    Matrix<BaseFloat> ids, dense;
+    TEST_CHECK(label.GenTargetIds(ids, frames[u], 100000, utt[u]));
+    TEST_CHECK(label.GenDesiredMatrix(dense, frames[u], 100000, utt[u]));
+    TEST_CHECK(ids.Rows() == frames[u] && ids.Cols() == 1);
+    TEST_CHECK(dense.Rows() == frames[u] && dense.Cols() == 4);
+    for(size_t r=0; r<ids.Rows(); r++) {
+      size_t id = static_cast<size_t>(ids(r,0));
+      TEST_CHECK(ids(r,0) == static_cast<BaseFloat>(id) && id < 4);
+      for(size_t c=0; c<dense.Cols(); c++) {
+        TEST_CHECK(dense(r,c) == (c == id ? 1.0f : 0.0f));
+      }
+    }
+  }
+  //frames 5-8 of 'a' are s1, the first state of the list
+  Matrix<BaseFloat> ids;
+  TEST_CHECK(label.GenTargetIds(ids, 9, 100000, "/data/a.fea"));
+  TEST_CHECK(ids(0,0) == 1.0f && ids(3,0) == 3.0f && ids(8,0) == 0.0f);
+}
+
+
+/// Random posteriors of 'rows' frames and 'cols' classes, the targets
+/// as class ids and as the one-hot matrix
+static void RandomTask(size_t rows, size_t cols, Matrix<BaseFloat>& rOut,
+                       Matrix<BaseFloat>& rIds, Matrix<BaseFloat>& rDense)
+{
+  rOut.Init(rows, cols);
+  rIds.Init(rows, 1);
+  rDense.Init(rows, cols);
+  for(size_t r=0; r<rows; r++) {
+    BaseFloat sum = 0.0f;
+    for(size_t c=0; c<cols; c++) {
+      rOut(r,c) = std::exp(3.0f*TestRand());
+      sum += rOut(r,c);
+    }
+    for(size_t c=0; c<cols; c++) rOut(r,c) /= sum;
+    size_t id = std::min(cols-1, static_cast<size_t>(0.5f*(TestRand()+1.0f)*static_cast<float>(cols)));
+    rIds(r,0) = static_cast<BaseFloat>(id);
+    rDense(r,id) = 1.0f;
+  }
+}
+
+
+/// The sparse cross entropy equals the dense one
+static void CheckCrossEntropy()
+{
+  Matrix<BaseFloat> out, ids, dense, err_dense, err_sparse;
+  RandomTask(37, 11, out, ids, dense);
+  CrossEntropy xent_dense, xent_sparse;
+  xent_sparse.SetSparseTargets(true);
+  xent_dense.Evaluate(out, dense, &err_dense);
+  xent_sparse.Evaluate(out, ids, &err_sparse);
+
+  bool same = err_dense.Rows() == err_sparse.Rows() && err_dense.Cols() == err_sparse.Cols();
+  for(size_t r=0; same && r<err_dense.Rows(); r++) {
+    for(size_t c=0; c<err_dense.Cols(); c++) {
+      if(err_dense(r,c) != err_sparse(r,c)) same = false;
+    }
+  }
+  TEST_CHECK(same);
+  TEST_CHECK_CLOSE(xent_sparse.GetError(), xent_dense.GetError(), 1e-9);
+  TEST_CHECK(xent_sparse.GetFrames() == 37);
+  TEST_CHECK(xent_sparse.Report() == xent_dense.Report());
+
+  //the ids out of the range of the outputs, the dense targets
+  Matrix<BaseFloat> bad(ids);
+  bad(5,0) = 11.0f;
+  TEST_CHECK_THROW(xent_sparse.Evaluate(out, bad, &err_sparse));
+  TEST_CHECK_THROW(xent_sparse.Evaluate(out, dense, &err_sparse));
+}
+
+
+/// The fused softmax and cross entropy against Propagate and the dense targets
+static void CheckFused()
+{
+  std::ostringstream model;
+  model << "<biasedlinearity> 9 6\n" << TestRandomText(9, 6) << TestRandomText(0, 9)
+        << "<sigmoid> 9 9\n"
+        << "<biasedlinearity> 7 9\n" << TestRandomText(7, 9) << TestRandomText(0, 7)
+        << "<softmax> 7 7\n";
+  std::istringstream is(model.str());
+  Network net;
+  net.ReadNetwork(is);
+
+  Matrix<BaseFloat> in(29, 6), post, ids(29, 1), dense(29, 7);
+  for(size_t r=0; r<in.Rows(); r++) {
+    for(size_t c=0; c<in.Cols(); c++) in(r,c) = 2.0f*TestRand();
+    size_t id = std::min<size_t>(6, static_cast<size_t>(3.5f*(TestRand()+1.0f)));
+    ids(r,0) = static_cast<BaseFloat>(id);
+    dense(r,id) = 1.0f;
+  }
+  net.Propagate(in, post);
+
+  CrossEntropy xent_dense, xent_fused;
+  xent_fused.SetSparseTargets(true);
+  Matrix<BaseFloat> err_dense, err_fused;
+  xent_dense.Evaluate(post, dense, &err_dense);
+  Matrix<BaseFloat> logits(net.PropagateLogits(in));
+  TEST_CHECK(logits.Rows() == 29 && logits.Cols() == 7);
+  xent_fused.EvaluateLogits(logits, ids, &err_fused);
+
+  double max_diff = 0.0;
+  TEST_CHECK(err_fused.Rows() == 29 && err_fused.Cols() == 7);
+  for(size_t r=0; r<err_fused.Rows(); r++) {
+    for(size_t c=0; c<err_fused.Cols(); c++) {
+      max_diff = std::max(max_diff, std::fabs(static_cast<double>(err_fused(r,c)) - err_dense(r,c)));
+    }
+  }
+  TEST_CHECK(max_diff < 1e-6);
+  TEST_CHECK_CLOSE(xent_fused.GetError(), xent_dense.GetError(), 1e-4);
+  TEST_CHECK(xent_fused.GetFrames() == xent_dense.GetFrames());
+
+  //the fusion needs the sparse targets
+  CrossEntropy xent;
+  TEST_CHECK_THROW(xent.EvaluateLogits(logits, ids, &err_fused));
+}
+
+
+int main()
+{
+  std::string dir = TestTmpDir();
+  CheckLabels(dir);
+  CheckCrossEntropy();
+  CheckFused();
+  TestRmDir(dir);
+  return TestResult("TestSparseTargets");
+}
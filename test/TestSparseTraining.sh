@@ -0,0 +1,41 @@
+#!/bin/sh
+# SPARSETARGETS: the training by the class ids, with the softmax fused
+# to the cross entropy, gives the network and the objective of the
+# training by the dense one-hot targets, so does the cross-validation.
+#
+# sh TestSparseTraining.sh <dir of TNet>
+
+BIN=${1:-..}
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/tnet_test.XXXXXX") || exit 1
+trap 'rm -rf "$DIR"' EXIT
+FAILURES=0
+
+check() {
+  if ! eval "$1"; then
+    echo "TestSparseTraining.sh: check failed: $1" >&2
+    FAILURES=$((FAILURES+1))
+  fi
+}
+
+./GenData "$DIR" 30 || exit 1
+COMMON="-I $DIR/ref.mlf -m $DIR/states --BUNCHSIZE=64 --CACHESIZE=1024 --LEARNINGRATE=0.001 --SEED=7 --THREADS=2 --SAVEBINARY=T"
+
+for SPARSE in F T; do
+  "$BIN"/TNet -S "$DIR"/train.scp -H "$DIR"/nnet.init --TARGETMMF="$DIR"/nnet.$SPARSE $COMMON \
+    --SPARSETARGETS=$SPARSE > "$DIR"/train.$SPARSE.log 2>&1
+  check "[ $? -eq 0 ]"
+  "$BIN"/TNet -c -S "$DIR"/cv.scp -H "$DIR"/nnet.F $COMMON \
+    --SPARSETARGETS=$SPARSE > "$DIR"/cv.$SPARSE.log 2>&1
+  check "[ $? -eq 0 ]"
+done
+check "cmp -s $DIR/nnet.F $DIR/nnet.T"
+check "grep -q '^-- TR' $DIR/train.T.log"
+check "[ \"\$(grep '^-- TR' $DIR/train.F.log)\" = \"\$(grep '^-- TR' $DIR/train.T.log)\" ]"
+check "grep -q '^-- CV' $DIR/cv.T.log"
+check "[ \"\$(grep '^-- CV' $DIR/cv.F.log)\" = \"\$(grep '^-- CV' $DIR/cv.T.log)\" ]"
+
+if [ $FAILURES -ne 0 ]; then
+  echo "TestSparseTraining: FAILED $FAILURES checks"
+  exit 1
+fi
+echo "TestSparseTraining: OK"
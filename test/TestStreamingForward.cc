@@ -0,0 +1,146 @@
+/*
+ * StreamingForward: an utterance streamed chunk by chunk gives the outputs
+ * of Network::Forward on the whole utterance, for the context of <expand>
+ * and of <expand> inside the blocks of <blockarray>.
+ */
+
+#include "Test.h"
+
+#include "StreamingForward.h"
+#include "Nnet.h"
+#include "Matrix.h"
+
+using namespace TNet;
+
+
+/// Single <expand> of context 2+3 at the input
+static std::string ExpandModel()
+{
+  std::ostringstream os;
+  os << "<expand> 24 4\nv 6\n-2 -1 0 1 2 3\n"
+     << "<biasedlinearity> 8 24\n" << TestRandomText(8, 24) << TestRandomText(0, 8)
+     << "<sigmoid> 8 8\n"
+     << "<biasedlinearity> 3 8\n" << TestRandomText(3, 8) << TestRandomText(0, 3)
+     << "<softmax> 3 3\n";
+  return os.str();
+}
+
+
+/// Blocks of different context, 3+2 and 1+1
+static std::string BlockArrayModel()
+{
+  std::ostringstream os;
+  os << "<blockarray> 6 4\n2\n"
+     << "<block> 1\n<expand> 12 2\nv 6\n-3 -2 -1 0 1 2\n"
+     << "<biasedlinearity> 3 12\n" << TestRandomText(3, 12) << TestRandomText(0, 3)
+     << "<endblock>\n"
+     << "<block> 2\n<expand> 6 2\nv 3\n-1 0 1\n"
+     << "<biasedlinearity> 3 6\n" << TestRandomText(3, 6) << TestRandomText(0, 3)
+     << "<endblock>\n"
+     << "<sigmoid> 6 6\n"
+     << "<biasedlinearity> 3 6\n" << TestRandomText(3, 6) << TestRandomText(0, 3)
+     << "<softmax> 3 3\n";
+  return os.str();
+}
+
+
+/// Stream the frames by pieces of 'push' frames, collect all the outputs
+static void Stream(StreamingForward& rStream, const Matrix<BaseFloat>& rIn,
+                   size_t push, Matrix<BaseFloat>& rOut)
+{
+  std::vector<BaseFloat> out;
+  size_t cols = 0;
+  Matrix<BaseFloat> piece;
+  for(size_t r=0; r<rIn.Rows()+push; r+=push) {
+    if(r < rIn.Rows()) {
+      size_t rows = std::min(push, rIn.Rows()-r);
+      rStream.Push(rIn.Range(r, rows, 0, rIn.Cols()));
+    } else {
+      rStream.Finish();
+    }
+    if(rStream.Pull(piece)) {
+      cols = piece.Cols();
+      for(size_t i=0; i<piece.Rows(); i++) {
+        out.insert(out.end(), piece.pRowData(i), piece.pRowData(i)+cols);
+      }
+    }
+  }
+  TEST_CHECK(rStream.Pending() == 0);
+  rOut.Init(cols ? out.size()/cols : 0, cols);
+  for(size_t r=0; r<rOut.Rows(); r++) {
+    for(size_t c=0; c<cols; c++) rOut(r,c) = out[r*cols+c];
+  }
+}
+
+
+/// Max difference of the outputs, a large value if the sizes differ
+static double MaxDiff(const Matrix<BaseFloat>& rA, const Matrix<BaseFloat>& rB)
+{
+  if(rA.Rows() != rB.Rows() || rA.Cols() != rB.Cols()) return 1e30;
+  double max_diff = 0.0;
+  for(size_t r=0; r<rA.Rows(); r++) {
+    for(size_t c=0; c<rA.Cols(); c++) {
+      max_diff = std::max(max_diff, std::fabs(static_cast<double>(rA(r,c)) - rB(r,c)));
+    }
+  }
+  return max_diff;
+}
+
+
+/// Compare the streamed outputs to Network::Forward for several chunk and push sizes
+static void CheckModel(const std::string& rFile, size_t left, size_t right)
+{
+  Network net;
+  net.ReadNetwork(rFile.c_str());
+  size_t l, r;
+  net.GetContext(l, r);
+  TEST_CHECK(l == left && r == right);
+
+  //the utterances shorter than the context, as long as a chunk, long ones
+  const size_t lengths[] = { 1, 2, 5, 8, 37, 200 };
+  const size_t chunks[] = { 1, 3, 8, 64 };
+  const size_t pushes[] = { 1, 4, 1000 };
+  for(size_t u=0; u<sizeof(lengths)/sizeof(lengths[0]); u++) {
+    Matrix<BaseFloat> in(lengths[u], 4), ref, out;
+    for(size_t i=0; i<in.Rows(); i++) {
+      for(size_t c=0; c<in.Cols(); c++) in(i,c) = 2.0f*TestRand();
+    }
+    net.Forward(in, ref);
+
+    for(size_t ch=0; ch<sizeof(chunks)/sizeof(chunks[0]); ch++) {
+      StreamingForward stream(net, chunks[ch]);
+      TEST_CHECK(stream.LeftContext() == left && stream.RightContext() == right);
+      for(size_t p=0; p<sizeof(pushes)/sizeof(pushes[0]); p++) {
+        //the stream is reused for the next utterance after Finish()
+        Stream(stream, in, pushes[p], out);
+        TEST_CHECK(out.Rows() == in.Rows());
+        //the same up to the rounding of the GEMMs of other sizes
+        TEST_CHECK(MaxDiff(out, ref) < 1e-6);
+      }
+      //Reset() drops a half-streamed utterance
+      stream.Push(in.Range(0, (in.Rows()+1)/2, 0, in.Cols()));
+      stream.Reset();
+      Stream(stream, in, 3, out);
+      TEST_CHECK(MaxDiff(out, ref) < 1e-6);
+    }
+  }
+}
+
+
+int main()
+{
+  std::string dir = TestTmpDir();
+  TestWriteFile(dir + "/expand.txt", ExpandModel());
+  TestWriteFile(dir + "/blockarray.txt", BlockArrayModel());
+
+  CheckModel(dir + "/expand.txt", 2, 3);
+  CheckModel(dir + "/blockarray.txt", 3, 2);
+
+  //a chunk needs at least one frame
+  Network net;
+  net.ReadNetwork((dir + "/expand.txt").c_str());
+  TEST_CHECK_THROW(StreamingForward(net, 0));
+
+  TestRmDir(dir);
+  return TestResult("TestStreamingForward");
+}
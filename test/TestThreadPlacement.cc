@@ -0,0 +1,107 @@
+/*
+ * ThreadPlacement: the CPU lists of THREADPLACEMENT and of the NUMA nodes
+ * are parsed or refused, an explicit list may only name the CPUs the
+ * process may run on, compact and scatter use exactly those CPUs.
+ */
+
+#include "Test.h"
+
+#include "ThreadPlacement.h"
+
+#include <sched.h>
+#include <set>
+#include <vector>
+
+using namespace TNet;
+
+
+/// The parsed list as text "0 2 4", "-" if refused
+static std::string Parse(const std::string& rList)
+{
+  std::vector<int> cpus;
+  if(!ThreadPlacement::ParseCpuList(rList, cpus)) return "-";
+  std::ostringstream os;
+  for(size_t i=0; i<cpus.size(); i++) os << (i ? " " : "") << cpus[i];
+  return os.str();
+}
+
+
+/// The CPUs of the threads 0..n-1
+static std::set<int> Cpus(const ThreadPlacement& rPlacement, int n)
+{
+  std::set<int> cpus;
+  for(int thr=0; thr<n; thr++) cpus.insert(rPlacement.Cpu(thr));
+  return cpus;
+}
+
+
+int main()
+{
+  TEST_CHECK(Parse("0,2,4-7") == "0 2 4 5 6 7");
+  TEST_CHECK(Parse("3") == "3");
+  TEST_CHECK(Parse("5-5") == "5");
+  //the cpulist of /sys ends by the newline
+  TEST_CHECK(Parse("0-3,8-9\n") == "0 1 2 3 8 9");
+  TEST_CHECK(Parse("1,,2") == "1 2");
+  TEST_CHECK(Parse("") == "-");
+  TEST_CHECK(Parse("\n") == "-");
+  TEST_CHECK(Parse("a") == "-");
+  TEST_CHECK(Parse("1x") == "-");
+  TEST_CHECK(Parse("1-2x") == "-");
+  TEST_CHECK(Parse("3-1") == "-");
+  TEST_CHECK(Parse("-1") == "-");
+  TEST_CHECK(Parse("0-") == "-");
+  TEST_CHECK(Parse("compact") == "-");
+  {
+    std::ostringstream os;
+    os << CPU_SETSIZE - 1;
+    TEST_CHECK(Parse(os.str()) == os.str());
+    os.str("");
+    os << "0," << CPU_SETSIZE;
+    TEST_CHECK(Parse(os.str()) == "-");
+  }
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  TEST_CHECK(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+  std::set<int> usable;
+  int outside = -1;
+  for(int cpu=0; cpu<CPU_SETSIZE; cpu++) {
+    if(CPU_ISSET(cpu, &allowed)) usable.insert(cpu);
+    else if(outside < 0) outside = cpu;
+  }
+  TEST_CHECK(!usable.empty());
+  const int n = static_cast<int>(usable.size());
+
+  ThreadPlacement placement;
+  placement.Init("none");
+  TEST_CHECK(placement.Cpu(0) == -1);
+
+  //the threads cycle through the list
+  {
+    std::ostringstream os;
+    os << *usable.begin();
+    placement.Init(os.str());
+    TEST_CHECK(placement.Cpu(0) == *usable.begin() && placement.Cpu(3) == *usable.begin());
+  }
+
+  //a CPU outside the affinity mask of the process, alone or within a range
+  TEST_CHECK(outside >= 0);
+  if(outside >= 0) {
+    std::ostringstream os;
+    os << outside;
+    TEST_CHECK_THROW(placement.Init(os.str()));
+    os.str("");
+    os << *usable.begin() << "," << (outside > 0 ? outside-1 : 0) << "-" << outside;
+    TEST_CHECK_THROW(placement.Init(os.str()));
+  }
+  TEST_CHECK_THROW(placement.Init("fast"));
+
+  placement.Init("compact");
+  TEST_CHECK(Cpus(placement, n) == usable);
+  TEST_CHECK(placement.Nodes() >= 1);
+  placement.Init("scatter");
+  TEST_CHECK(Cpus(placement, n) == usable);
+
+  return TestResult("TestThreadPlacement");
+}